@@ -1,6 +1,7 @@
 #include "analyser.h"
 
 #include <climits>
+#include <map>
 #define makeCE(ErrCode) std::make_optional<CompilationError>(_current_pos, ErrCode)
 #define debugOut(s) std::cout << s << std::endl
 
@@ -38,6 +39,8 @@ namespace c0 {
             return false;
         TokenType type = tk.value().GetType();
         return   type == TokenType::LEFT_BRACE || type == TokenType::IF  || type == TokenType::WHILE
+              || type == TokenType::FOR  || type == TokenType::DO
+              || type == TokenType::SWITCH  || type == TokenType::BREAK  || type == TokenType::CONTINUE
               || type == TokenType::RETURN  || type == TokenType::PRINT  || type == TokenType::SCAN
               || type == TokenType::IDENTIFIER  || type == TokenType::SEMICOLON;
     }
@@ -57,7 +60,7 @@ namespace c0 {
 		if (err.has_value())
 			return std::make_pair(std::vector<Quadruple>(), err);
 		else
-			return std::make_pair(_instructions, std::optional<CompilationError>());
+			return std::make_pair(std::move(_instructions), std::optional<CompilationError>());
 	}
 
 	// <C0-program> ::=
@@ -267,9 +270,9 @@ namespace c0 {
 
     // <statement> ::=
     //     <compound-statement>   // {
-    //    |<condition-statement>  // if
-    //    |<loop-statement>       // while
-    //    |<jump-statement>       // return
+    //    |<condition-statement>  // if, switch
+    //    |<loop-statement>       // while, for, do
+    //    |<jump-statement>       // break, continue, return
     //    |<print-statement>      // print
     //    |<scan-statement>       // scan
     //    |<assignment-expression>';' // <id> '='
@@ -294,15 +297,32 @@ namespace c0 {
                 err = analyseConditionStatement(returned);
                 break;
 
+            case TokenType::SWITCH:
+                err = analyseSwitchStatement(returned);
+                break;
+
             case TokenType::WHILE:
                 err = analyseLoopStatement();
                 break;
 
+            case TokenType::FOR:
+                err = analyseForStatement();
+                break;
+
+            case TokenType::DO:
+                err = analyseDoWhileStatement(returned);
+                break;
+
             case TokenType::RETURN:
                 err = analyseJumpStatement();
                 returned = true;
                 break;
 
+            case TokenType::BREAK:
+            case TokenType::CONTINUE:
+                err = analyseJumpStatement();
+                break;
+
             case TokenType::PRINT:
                 err = analysePrintStatement();
                 break;
@@ -490,15 +510,140 @@ namespace c0 {
         return std::optional<CompilationError>();
     }
 
+    // 'switch' '(' <expression> ')' '{' {<labeled-statement>} '}'
+    // <labeled-statement> ::= ('case' <case-value> | 'default') ':' {<statement>}
+    std::optional<CompilationError> Analyser::analyseSwitchStatement(bool& returned) {
+        /*
+         *  expression
+         *  {dispatch}          分析完所有 case 后按它们的值生成，插入到这里
+         *  #label-case1
+         *  {statement1}
+         *  ...
+         *  #label-end
+         * */
+        returned = false;
+
+        if (mismatchType(peek, TokenType::SWITCH))
+            return makeCE(ErrorCode::ErrSyntaxError);
+        peek = nextToken();
+
+        if (mismatchType(peek, TokenType::LEFT_PAREN))
+            return makeCE(ErrorCode::ErrIncompleteExpression);
+        peek = nextToken();
+
+        std::string value;
+        auto err = analyseExpression(value);
+        if (err.has_value())
+            return err;
+
+        if (mismatchType(peek, TokenType::RIGHT_PAREN))
+            return makeCE(ErrorCode::ErrIncompleteExpression);
+        peek = nextToken();
+
+        std::string selector = getOpr(value);
+        std::uint32_t line = currentLine();
+        std::size_t dispatchAt = _instructions.size();
+
+        if (mismatchType(peek, TokenType::LEFT_BRACE))
+            return makeCE(ErrorCode::ErrMissingBrace);
+        peek = nextToken();
+
+        std::string labelEnd = getLabel(), labelDefault;
+        // case 的值 -> 标号
+        std::map<int32_t, std::string> cases;
+        bool lastReturned = false;
+        _jumpTargets.push_back({ labelEnd, _nextStackIndex, "", 0, false });
+        while (!mismatchType(peek, TokenType::CASE) || !mismatchType(peek, TokenType::DEFAULT)) {
+            std::string labelCase = getLabel();
+            if (peek.value().GetType() == TokenType::CASE) {
+                peek = nextToken();
+                int32_t caseValue;
+                err = analyseCaseValue(caseValue);
+                if (err.has_value())
+                    return err;
+                if (!cases.emplace(caseValue, labelCase).second)
+                    return makeCE(ErrorCode::ErrDuplicateCase);
+            } else {
+                peek = nextToken();
+                if (!labelDefault.empty())
+                    return makeCE(ErrorCode::ErrDuplicateCase);
+                labelDefault = labelCase;
+            }
+
+            if (mismatchType(peek, TokenType::COLON))
+                return makeCE(ErrorCode::ErrSyntaxError);
+            peek = nextToken();
+
+            // 各段的栈深度相同，前一段可以直接执行到下一段
+            addInstruction(QuadOpr::LAB, labelCase);
+            lastReturned = false;
+            setSymbolTable();
+            while (isStatementFirst(peek)) {
+                bool stateReturned;
+                err = analyseStatement(stateReturned);
+                if (err.has_value())
+                    return err;
+                lastReturned |= stateReturned;
+            }
+            resetSymbolTable();
+        }
+
+        if (mismatchType(peek, TokenType::RIGHT_BRACE))
+            return makeCE(ErrorCode::ErrMissingBrace);
+        peek = nextToken();
+
+        addInstruction(QuadOpr::LAB, labelEnd);
+        // 有 default 时一定会进入某一段，之后顺序执行到最后一段
+        returned = !labelDefault.empty() && !_jumpTargets.back().broken && lastReturned;
+        _jumpTargets.pop_back();
+
+        std::vector<Quadruple> dispatch;
+        lowerSwitch(dispatch, selector, std::vector<std::pair<int32_t, std::string>>(cases.begin(), cases.end()),
+                    0, cases.size(), labelDefault.empty() ? labelEnd : labelDefault);
+        for (auto& quad : dispatch)
+            quad.setLine(line);
+        _instructions.insert(_instructions.begin() + dispatchAt, dispatch.begin(), dispatch.end());
+
+        return {};
+    }
+
+    // <case-value> ::= [<unary-operator>](<integer-literal>|<char-literal>)
+    std::optional<CompilationError> Analyser::analyseCaseValue(int32_t& value) {
+        int64_t sign = 1;
+        if (!mismatchType(peek, TokenType::PLUS_SIGN))
+            peek = nextToken();
+        else if (!mismatchType(peek, TokenType::MINUS_SIGN)) {
+            sign = -1;
+            peek = nextToken();
+        }
+
+        int64_t l;
+        if (!mismatchType(peek, TokenType::UNSIGNED_INTEGER)) {
+            auto u = std::any_cast<unsigned long>(peek.value().GetValue());
+            if (u > (unsigned long)INT32_MAX + (sign == -1 ? 1 : 0))
+                return makeCE(ErrorCode::ErrIntegerOverflow);
+            l = (int64_t)u;
+        } else if (!mismatchType(peek, TokenType::UNSIGNED_CHAR))
+            l = std::any_cast<char>(peek.value().GetValue());
+        else
+            return makeCE(ErrorCode::ErrNeedCaseValue);
+        peek = nextToken();
+
+        value = (int32_t)(sign * l);
+        return {};
+    }
+
     // 'while' '(' <condition> ')' <statement>
     std::optional<CompilationError> Analyser::analyseLoopStatement() {
 //        debugOut("analyse loop statement");
-        /*  #label-begin
+        /*  #label-begin        LAB 的 y、r 为 continue 和 break 的标号，下同
          *  condition
          *  BZ #label-end
          *  {while-statement}
+         *  POP {condition-temps}
          *  GOTO #label-begin
          *  #label-end
+         *  POP {condition-temps}
          * */
         std::string labelBegin = getLabel(), labelEnd = getLabel();
 
@@ -506,7 +651,9 @@ namespace c0 {
             return makeCE(ErrorCode::ErrSyntaxError);
         peek = nextToken();
 
-        addInstruction(QuadOpr::LAB, labelBegin);
+        int32_t loopDepth = _nextStackIndex;
+        std::size_t loopSymbols = _symbols.size();
+        addInstruction(QuadOpr::LAB, labelBegin, labelBegin, labelEnd);
 
         if (mismatchType(peek, TokenType::LEFT_PAREN))
             return makeCE(ErrorCode::ErrIncompleteExpression);
@@ -520,27 +667,227 @@ namespace c0 {
             return makeCE(ErrorCode::ErrIncompleteExpression);
         peek = nextToken();
 
+        // 条件中的临时变量每次回到开头之前都要弹出，和 #label-begin 处的栈深度一致
         addInstruction(QuadOpr::BZ, labelEnd);
 
         // while-statement
         // not used, for while-statement may not be executed
         bool returned;
+        _jumpTargets.push_back({ labelEnd, _nextStackIndex, labelBegin, loopDepth, false });
         setSymbolTable();
         err = analyseStatement(returned);
         resetSymbolTable();
         if (err.has_value())
             return err;
+        _jumpTargets.pop_back();
 
-        addInstruction(QuadOpr::GOTO, labelBegin);
+        addJump(labelBegin, loopDepth);
         addInstruction(QuadOpr::LAB, labelEnd);
+        popTemps(loopDepth, loopSymbols);
 
         return std::optional<CompilationError>();
     }
 
-    // 'return' [<expression>] ';'
+    // 'for' '(' <for-init-statement> [<condition>] ';' [<for-update-expression>] ')' <statement>
+    // <for-init-statement> ::= [<assignment-expression>{',' <assignment-expression>}] ';'
+    // <for-update-expression> ::= (<assignment-expression>|<function-call>){',' (<assignment-expression>|<function-call>)}
+    std::optional<CompilationError> Analyser::analyseForStatement() {
+        /*  {for-init}
+         *  POP {init-temps}
+         *  #label-begin
+         *  condition
+         *  BZ #label-end
+         *  {for-statement}
+         *  #label-continue
+         *  {for-update}        分析完循环体后移到这里
+         *  POP {update-temps}
+         *  POP {condition-temps}
+         *  GOTO #label-begin
+         *  #label-end
+         *  POP {condition-temps}
+         * */
+        std::string labelBegin = getLabel(), labelContinue = getLabel(), labelEnd = getLabel();
+
+        if (mismatchType(peek, TokenType::FOR))
+            return makeCE(ErrorCode::ErrSyntaxError);
+        peek = nextToken();
+
+        if (mismatchType(peek, TokenType::LEFT_PAREN))
+            return makeCE(ErrorCode::ErrIncompleteExpression);
+        peek = nextToken();
+
+        int32_t loopDepth = _nextStackIndex;
+        std::size_t loopSymbols = _symbols.size();
+        std::optional<CompilationError> err;
+
+        // for-init
+        while (!mismatchType(peek, TokenType::IDENTIFIER)) {
+            err = analyseAssignmentStatement();
+            if (err.has_value())
+                return err;
+            if (mismatchType(peek, TokenType::COMMA))
+                break;
+            peek = nextToken();
+        }
+        if (mismatchType(peek, TokenType::SEMICOLON))
+            return makeCE(ErrorCode::ErrNoSemicolon);
+        peek = nextToken();
+        popTemps(loopDepth, loopSymbols);
+
+        addInstruction(QuadOpr::LAB, labelBegin, labelContinue, labelEnd);
+
+        // 没有条件时是死循环
+        if (mismatchType(peek, TokenType::SEMICOLON)) {
+            err = analyseCondition();
+            if (err.has_value())
+                return err;
+            addInstruction(QuadOpr::BZ, labelEnd);
+        }
+        if (mismatchType(peek, TokenType::SEMICOLON))
+            return makeCE(ErrorCode::ErrNoSemicolon);
+        peek = nextToken();
+
+        // for-update
+        int32_t updateDepth = _nextStackIndex;
+        std::size_t updateSymbols = _symbols.size(), updateAt = _instructions.size();
+        while (!mismatchType(peek, TokenType::IDENTIFIER)) {
+            auto next = nextToken();
+            unreadToken();
+            std::string ret;
+            if (next.has_value() && next.value().GetType() == TokenType::LEFT_PAREN)
+                err = analyseFunctionCall(ret);
+            else
+                err = analyseAssignmentStatement();
+            if (err.has_value())
+                return err;
+            if (mismatchType(peek, TokenType::COMMA))
+                break;
+            peek = nextToken();
+        }
+        if (mismatchType(peek, TokenType::RIGHT_PAREN))
+            return makeCE(ErrorCode::ErrIncompleteExpression);
+        peek = nextToken();
+        popTemps(updateDepth, updateSymbols);
+        std::vector<Quadruple> update(_instructions.begin() + updateAt, _instructions.end());
+        _instructions.erase(_instructions.begin() + updateAt, _instructions.end());
+
+        // for-statement
+        bool returned;
+        _jumpTargets.push_back({ labelEnd, _nextStackIndex, labelContinue, _nextStackIndex, false });
+        setSymbolTable();
+        err = analyseStatement(returned);
+        resetSymbolTable();
+        if (err.has_value())
+            return err;
+        _jumpTargets.pop_back();
+
+        addInstruction(QuadOpr::LAB, labelContinue);
+        _instructions.insert(_instructions.end(), update.begin(), update.end());
+        addJump(labelBegin, loopDepth);
+        addInstruction(QuadOpr::LAB, labelEnd);
+        popTemps(loopDepth, loopSymbols);
+
+        return {};
+    }
+
+    // 'do' <statement> 'while' '(' <condition> ')' ';'
+    std::optional<CompilationError> Analyser::analyseDoWhileStatement(bool& returned) {
+        /*  #label-begin
+         *  {do-statement}
+         *  #label-continue
+         *  condition
+         *  BNZ #label-begin
+         *  #label-end
+         *
+         *  条件中有临时变量时：
+         *  condition
+         *  BZ #label-exit
+         *  POP {condition-temps}
+         *  GOTO #label-begin
+         *  #label-exit
+         *  POP {condition-temps}
+         *  #label-end
+         * */
+        std::string labelBegin = getLabel(), labelContinue = getLabel(), labelEnd = getLabel();
+
+        if (mismatchType(peek, TokenType::DO))
+            return makeCE(ErrorCode::ErrSyntaxError);
+        peek = nextToken();
+
+        int32_t loopDepth = _nextStackIndex;
+        std::size_t loopSymbols = _symbols.size();
+        addInstruction(QuadOpr::LAB, labelBegin, labelContinue, labelEnd);
+
+        // do-statement
+        _jumpTargets.push_back({ labelEnd, loopDepth, labelContinue, loopDepth, false });
+        setSymbolTable();
+        auto err = analyseStatement(returned);
+        resetSymbolTable();
+        if (err.has_value())
+            return err;
+        // 循环体至少执行一次
+        returned &= !_jumpTargets.back().broken;
+        _jumpTargets.pop_back();
+
+        if (mismatchType(peek, TokenType::WHILE))
+            return makeCE(ErrorCode::ErrSyntaxError);
+        peek = nextToken();
+
+        if (mismatchType(peek, TokenType::LEFT_PAREN))
+            return makeCE(ErrorCode::ErrIncompleteExpression);
+        peek = nextToken();
+
+        addInstruction(QuadOpr::LAB, labelContinue);
+        err = analyseCondition();
+        if (err.has_value())
+            return err;
+
+        if (mismatchType(peek, TokenType::RIGHT_PAREN))
+            return makeCE(ErrorCode::ErrIncompleteExpression);
+        peek = nextToken();
+        if (mismatchType(peek, TokenType::SEMICOLON))
+            return makeCE(ErrorCode::ErrNoSemicolon);
+        peek = nextToken();
+
+        if (_nextStackIndex == loopDepth)
+            addInstruction(QuadOpr::BNZ, labelBegin);
+        else {
+            std::string labelExit = getLabel();
+            addInstruction(QuadOpr::BZ, labelExit);
+            addJump(labelBegin, loopDepth);
+            addInstruction(QuadOpr::LAB, labelExit);
+            popTemps(loopDepth, loopSymbols);
+        }
+        addInstruction(QuadOpr::LAB, labelEnd);
+
+        return {};
+    }
+
+    // 'break' ';' | 'continue' ';' | 'return' [<expression>] ';'
     std::optional<CompilationError> Analyser::analyseJumpStatement() {
 //        debugOut("analyse jump statement");
 
+        if (!mismatchType(peek, TokenType::BREAK) || !mismatchType(peek, TokenType::CONTINUE)) {
+            bool isBreak = peek.value().GetType() == TokenType::BREAK;
+            peek = nextToken();
+            if (mismatchType(peek, TokenType::SEMICOLON))
+                return makeCE(ErrorCode::ErrNoSemicolon);
+            peek = nextToken();
+
+            // break 跳出最内层的循环或 switch，continue 回到最内层的循环
+            auto target = _jumpTargets.rbegin();
+            for (; !isBreak && target != _jumpTargets.rend() && target->continueLabel.empty(); target++)
+                ;
+            if (target == _jumpTargets.rend())
+                return makeCE(ErrorCode::ErrInvalidJump);
+            if (isBreak) {
+                target->broken = true;
+                addJump(target->breakLabel, target->breakDepth);
+            } else
+                addJump(target->continueLabel, target->continueDepth);
+            return {};
+        }
+
         if (mismatchType(peek, TokenType::RETURN))
             return makeCE(ErrorCode::ErrSyntaxError);
         peek = nextToken();
@@ -582,33 +929,57 @@ namespace c0 {
             return makeCE(ErrorCode::ErrIncompleteExpression);
         peek = nextToken();
 
+        // 相邻的字面量（字符串、字符、整数常量和之间的空格）拼成一个字符串常量
+        std::string text;
+        // 表达式的求值可能调用函数输出，之前的字面量要在求值之前输出
+        auto flush = [&](std::size_t at) {
+            if (text.empty())
+                return;
+            Quadruple prt(QuadOpr::PRT, "@" + text, "@s");
+            prt.setLine(currentLine());
+            _instructions.insert(_instructions.begin() + at, std::move(prt));
+            text.clear();
+        };
+
         if (mismatchType(peek, TokenType::RIGHT_PAREN)) {
             // <printable> {',' <printable>}
             // <printable> ::= <expression> | <string-literal> | <char-literal>
             while (true) {
                 if (!mismatchType(peek, TokenType::STRING)) {
-                    addInstruction(QuadOpr::PRT, "@" + peek.value().GetValueString(), "@s");
+                    text += peek.value().GetValueString();
                     peek = nextToken();
                 } else if (!mismatchType(peek, TokenType::UNSIGNED_CHAR)) {
                     char c = std::any_cast<char>(peek.value().GetValue());
-                    addInstruction(QuadOpr::PRT, "$" + std::to_string(c), "@c");
+                    // '\0' 会截断本地代码中的字符串
+                    if (c == 0) {
+                        flush(_instructions.size());
+                        addInstruction(QuadOpr::PRT, "$0", "@c");
+                    } else
+                        text += c;
                     peek = nextToken();
                 } else {
                     std::string value;
+                    std::size_t mark = _instructions.size();
                     auto err = analyseExpression(value);
                     if (err.has_value())
                         return err;
-                    addInstruction(QuadOpr::PRT, value, "@i");
+                    if (value[0] == '$' && _instructions.size() == mark)
+                        text += value.substr(1);
+                    else {
+                        flush(mark);
+                        addInstruction(QuadOpr::PRT, value, "@i");
+                    }
                 }
 
                 if (mismatchType(peek, TokenType::COMMA))
                     break;
                 else {
                     peek = nextToken();
-                    addInstruction(QuadOpr::PRT, "$" + std::to_string(' '), "@c");
+                    text += ' ';
                 }
             }
         }
+        flush(_instructions.size());
         addInstruction(QuadOpr::PRT, "", "@ln");
 
 
@@ -1004,6 +1375,61 @@ namespace c0 {
         _lastIndex.pop_back();
     }
 
+    void Analyser::popTemps(int32_t depth, std::size_t symbols) {
+        if (_nextStackIndex > depth)
+            addInstruction(QuadOpr::POP, "$" + std::to_string(_nextStackIndex - depth));
+        _symbols.erase(_symbols.begin() + symbols, _symbols.end());
+        _nextStackIndex = depth;
+    }
+
+    void Analyser::addJump(const std::string& label, int32_t depth) {
+        int diff = _nextStackIndex - depth;
+        if (diff > 0)
+            addInstruction(QuadOpr::POP, "$" + std::to_string(diff));
+        addInstruction(QuadOpr::GOTO, label);
+        for (int k = 0; k < diff; k++)
+            addInstruction(QuadOpr::PUSH, "$0");
+    }
+
+    namespace {
+        // 至少有这么多个 case 才用跳转表
+        constexpr std::size_t minTableCases = 4;
+        // 跳转表的项数不超过 case 数的这么多倍，空位跳到 default
+        constexpr int64_t maxTableRatio = 2;
+        // tableswitch 的项数是 2 字节的操作数
+        constexpr int64_t maxTableSize = 0xffff;
+        // 不超过这么多个 case 时顺序比较
+        constexpr std::size_t maxLinearCases = 3;
+    }
+
+    // 稠密的一段用跳转表，很少的几个 case 顺序比较，否则按中间的值二分成比较树
+    void Analyser::lowerSwitch(std::vector<Quadruple>& out, const std::string& selector,
+                               const std::vector<std::pair<int32_t, std::string>>& cases,
+                               std::size_t begin, std::size_t end, const std::string& labelDefault) {
+        std::size_t count = end - begin;
+        int64_t span = count == 0 ? 0 : (int64_t)cases[end - 1].first - cases[begin].first + 1;
+        if (count >= minTableCases && span <= maxTableRatio * (int64_t)count && span <= maxTableSize) {
+            std::vector<std::string> targets(span + 1, labelDefault);
+            for (std::size_t k = begin; k < end; k++)
+                targets[cases[k].first - cases[begin].first] = cases[k].second;
+            out.emplace_back(QuadOpr::SWT, selector, "$" + std::to_string(cases[begin].first), joinLabels(targets));
+        } else if (count <= maxLinearCases) {
+            for (std::size_t k = begin; k < end; k++) {
+                out.emplace_back(QuadOpr::EQU, selector, "$" + std::to_string(cases[k].first));
+                out.emplace_back(QuadOpr::BNZ, cases[k].second);
+            }
+            out.emplace_back(QuadOpr::GOTO, labelDefault);
+        } else {
+            std::size_t mid = begin + count / 2;
+            std::string labelUpper = getLabel();
+            out.emplace_back(QuadOpr::GE, selector, "$" + std::to_string(cases[mid].first));
+            out.emplace_back(QuadOpr::BNZ, labelUpper);
+            lowerSwitch(out, selector, cases, begin, mid, labelDefault);
+            out.emplace_back(QuadOpr::LAB, labelUpper);
+            lowerSwitch(out, selector, cases, mid, end, labelDefault);
+        }
+    }
+
     void Analyser::initVariable(const std::string & id) {
         if (isDeclared(id))
             _symbols[_findSymbol(id)].setInited(true);
@@ -1072,26 +1498,38 @@ namespace c0 {
         if (str.empty() || str[0] == '$' || str[0] == '@' )
             return str;
         int index = getStackIndex(str);
+        // 临时变量总是局部的，加上 # 前缀以便后端识别
+        std::string prefix = str[0] == '#' ? "#" : "";
         if (_lastIndex.size() > 1 && index < _lastIndex[1]) {
             // global variable
             return "c" + std::to_string(index);
         } else if (_lastIndex.size() == 1){
-            return std::to_string(index);
+            return prefix + std::to_string(index);
         } else {
-            return std::to_string(index - _lastIndex[1]);
+            return prefix + std::to_string(index - _lastIndex[1]);
         }
     }
 
+    // 四元式的行号取已经分析完的最后一个记号所在的行，记号的行从 0 开始
+    // 分析时总是多读入一个记号放在 peek 中，它是 _tokens[_offset - 1]
+    std::uint32_t Analyser::currentLine() const {
+        std::size_t last = peek.has_value() && _offset >= 2 ? _offset - 2 : _offset - 1;
+        return _offset == 0 ? 1 : (std::uint32_t)_tokens[last].GetStartPos().first + 1;
+    }
+
     void Analyser::addInstruction(QuadOpr opr, const std::string& x) {
         _instructions.emplace_back(opr, getOpr(x));
+        _instructions.back().setLine(currentLine());
     }
 
     void Analyser::addInstruction(QuadOpr opr, const std::string& x, const std::string& y) {
         _instructions.emplace_back(opr, getOpr(x), getOpr(y));
+        _instructions.back().setLine(currentLine());
     }
 
     void Analyser::addInstruction(QuadOpr opr, const std::string& x, const std::string& y, const std::string& r) {
         _instructions.emplace_back(opr, getOpr(x), getOpr(y), getOpr(r));
+        _instructions.back().setLine(currentLine());
     }
 
     SymbolType Analyser::currentFuncType() {
@@ -27,7 +27,7 @@ namespace c0 {
 		Analyser(const Analyser&) = delete;
 		Analyser& operator=(Analyser) = delete;
 
-		// 唯一接口
+		// 唯一接口，只能调用一次，结果从 Analyser 中移出
 		std::pair<std::vector<Quadruple>, std::optional<CompilationError>> Analyse();
 
 	private:
@@ -41,7 +41,11 @@ namespace c0 {
 		std::optional<CompilationError> analyseCompoundStatement(bool funcBody, bool& returned);
         std::optional<CompilationError> analyseCondition();
         std::optional<CompilationError> analyseConditionStatement(bool& returned);
+        std::optional<CompilationError> analyseSwitchStatement(bool& returned);
+        std::optional<CompilationError> analyseCaseValue(int32_t&);
         std::optional<CompilationError> analyseLoopStatement();
+        std::optional<CompilationError> analyseForStatement();
+        std::optional<CompilationError> analyseDoWhileStatement(bool& returned);
         std::optional<CompilationError> analyseJumpStatement();
         std::optional<CompilationError> analysePrintStatement();
         std::optional<CompilationError> analyseScanStatement();
@@ -89,6 +93,25 @@ namespace c0 {
         void setSymbolTable();
 		void resetSymbolTable();
 
+        // break 和 continue 跳到的标号及跳转时应有的栈深度，switch 没有 continue 的标号
+        struct JumpTarget {
+            std::string breakLabel;
+            int32_t breakDepth;
+            std::string continueLabel;
+            int32_t continueDepth;
+            // 有 break 跳到这里
+            bool broken;
+        };
+        std::vector<JumpTarget> _jumpTargets;
+        // 弹出超过 depth 的栈，删除其中的临时变量
+        void popTemps(int32_t depth, std::size_t symbols);
+        // 弹出超过 depth 的栈后跳到 label，之后补上 PUSH 使栈深度仍然可以顺序求出
+        void addJump(const std::string& label, int32_t depth);
+        // 按排好序的 cases[begin, end) 生成 switch 的分派，见 analyseSwitchStatement
+        void lowerSwitch(std::vector<Quadruple>&, const std::string& selector,
+                         const std::vector<std::pair<int32_t, std::string>>& cases,
+                         std::size_t begin, std::size_t end, const std::string& labelDefault);
+
         void initVariable(const std::string&);
         bool isDeclared(const std::string&);
         bool isConstant(const std::string&);
@@ -107,6 +130,8 @@ namespace c0 {
         void addInstruction(QuadOpr opr, const std::string& x);
         void addInstruction(QuadOpr opr, const std::string& x, const std::string& y);
         void addInstruction(QuadOpr opr, const std::string& x, const std::string& y, const std::string& r);
+        // 生成的四元式所属的源代码行
+        std::uint32_t currentLine() const;
         std::string getOpr(std::string);
 	};
 }
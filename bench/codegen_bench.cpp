@@ -0,0 +1,106 @@
+#include "generater/generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+ * Generator 的规模测试
+ * 生成 n 个函数的四元式，每个函数打印一个不同的字符串常量、调用前一个函数并包含一个循环，
+ * 输出代码生成的耗时。耗时应随 n 线性增长，即每个函数的耗时基本不变。
+ *
+ * 给出 jobs 时同时比较并行生成的耗时，输出应和串行时完全一致。
+ *
+ * usage: codegen_bench [max_functions] [jobs]
+ */
+
+std::vector<c0::Quadruple> makeProgram(int n) {
+    using namespace c0;
+    std::vector<Quadruple> quads;
+    quads.reserve((std::size_t)n * 12);
+    int label = 0;
+
+    for (int i = 0; i < n; i++) {
+        std::string name = "@f" + std::to_string(i);
+        quads.emplace_back(QuadOpr::FUNC, name, "$1", "$1");
+        quads.emplace_back(QuadOpr::PRT, "@string literal " + std::to_string(i), "@s");
+        quads.emplace_back(QuadOpr::PRT, "", "@ln");
+
+        // while (a > 0) a = a - 1;
+        std::string begin = "@" + std::to_string(label++);
+        std::string end = "@" + std::to_string(label++);
+        quads.emplace_back(QuadOpr::LAB, begin);
+        quads.emplace_back(QuadOpr::GT, "0", "$0");
+        quads.emplace_back(QuadOpr::BZ, end);
+        quads.emplace_back(QuadOpr::SUB, "0", "$1", "0");
+        quads.emplace_back(QuadOpr::GOTO, begin);
+        quads.emplace_back(QuadOpr::LAB, end);
+
+        if (i > 0) {
+            quads.emplace_back(QuadOpr::PUSH, "0");
+            quads.emplace_back(QuadOpr::CAL, "@f" + std::to_string(i - 1));
+        }
+        quads.emplace_back(QuadOpr::RET, "");
+    }
+    return quads;
+}
+
+// Instruction::operator== 只比较操作码和 x，这里逐个比较操作码和两个操作数
+bool sameCode(const std::vector<c0::Instruction>& a, const std::vector<c0::Instruction>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const c0::Instruction& x, const c0::Instruction& y) {
+        return x.getOpr() == y.getOpr() && x.getX() == y.getX() && x.getY() == y.getY();
+    });
+}
+
+// 常量表、函数表、.start 和所有函数体都相同
+bool sameByteCode(const c0::byteCode& a, const c0::byteCode& b) {
+    if (a.constants != b.constants || a.functions.size() != b.functions.size()
+        || a.instructions.size() != b.instructions.size() || !sameCode(a.start, b.start))
+        return false;
+    for (std::size_t i = 0; i < a.functions.size(); i++) {
+        const auto& f = a.functions[i];
+        const auto& g = b.functions[i];
+        if (f.name_index != g.name_index || f.params_size != g.params_size || f.level != g.level)
+            return false;
+    }
+    for (std::size_t i = 0; i < a.instructions.size(); i++) {
+        if (!sameCode(a.instructions[i], b.instructions[i]))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int max = argc > 1 ? std::stoi(argv[1]) : 100000;
+    unsigned jobs = argc > 2 ? (unsigned)std::stoi(argv[2]) : 1;
+
+    std::printf("%10s %6s %12s %14s\n", "functions", "jobs", "time(ms)", "ns/function");
+    for (int n = std::max(max / 8, 1); n <= max; n *= 2) {
+        auto quads = makeProgram(n);
+        std::optional<c0::byteCode> serial;
+
+        for (unsigned j : { 1u, jobs }) {
+            c0::Generator generator(quads, false, j);
+
+            auto begin = std::chrono::steady_clock::now();
+            auto code = generator.Generate();
+            auto millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+            std::printf("%10d %6u %12.1f %14.1f\n", n, j, millis, millis * 1e6 / n);
+            if ((int)code.functions.size() != n)
+                return 1;
+            if (j == 1)
+                serial = std::move(code);
+            else if (!sameByteCode(code, *serial)) {
+                std::fprintf(stderr, "%d functions: output of %u jobs differs from the serial output\n", n, j);
+                return 1;
+            }
+            if (jobs == 1)
+                break;
+        }
+    }
+    return 0;
+}
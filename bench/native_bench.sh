@@ -0,0 +1,73 @@
+#!/usr/bin/env bash
+#
+# 比较 -S native 生成的可执行文件、-S c 生成的 C 经 $CC -O2 编译的可执行文件和 cc0 run 解释执行的耗时
+# 每个程序先确认三者的输出和退出码相同，再各执行 runs 次，输出总耗时和相对 cc0 run 的加速比。
+# 程序从标准输入读入 input；编译失败的程序跳过。
+#
+# usage: bench/native_bench.sh [cc0] [runs] [input] [program.c0...]
+# 默认使用 build/cc0（见 readme 中的编译步骤），执行 20 次，输入为 25，程序为 testFile/*.c0
+# 汇编和链接使用 $CC（默认 cc），运行时为 runtime/c0rt.c
+
+set -u
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+cc0=${1:-$root/build/cc0}
+runs=${2:-20}
+input=${3:-25}
+shift $(( $# < 3 ? $# : 3 ))
+programs=("$@")
+if [ ${#programs[@]} -eq 0 ]; then
+    programs=("$root"/testFile/*.c0)
+fi
+CC=${CC:-cc}
+if [ ! -x "$cc0" ]; then
+    echo "$cc0 not found, build cc0 first or pass its path as the first argument" >&2
+    exit 2
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+now() { date +%s%N; }
+
+# 执行 runs 次，输出总毫秒数
+measure() {
+    local start end i
+    start=$(now)
+    for (( i = 0; i < runs; i++ )); do
+        echo "$input" | "$@" > /dev/null 2>&1
+    done
+    end=$(now)
+    echo $(( (end - start) / 1000000 ))
+}
+
+# 在子 shell 中编译，cc0 崩溃时 bash 的提示也被丢弃
+translate() {
+    bash -c '"$0" -S "$1" -O2 "$2" -o "$3"; exit $?' "$cc0" "$@" > /dev/null 2>&1
+}
+
+printf "%-20s %10s %12s %10s %9s %9s\n" program "run (ms)" "native (ms)" "c (ms)" native c
+for program in "${programs[@]}"; do
+    name=$(basename "$program" .c0)
+    if ! translate native "$program" "$work/$name.s" \
+        || ! $CC "$work/$name.s" "$root/runtime/c0rt.c" -o "$work/$name" > /dev/null 2>&1 \
+        || ! translate c "$program" "$work/$name.c" \
+        || ! $CC -O2 -I"$root/runtime" "$work/$name.c" "$root/runtime/c0rt.c" -o "$work/$name-c" > /dev/null 2>&1; then
+        printf "%-20s %s\n" "$name" "skipped: does not compile"
+        continue
+    fi
+
+    expected=$(echo "$input" | "$cc0" run -O2 "$program" 2>&1; echo "exit $?")
+    actual=$(echo "$input" | "$work/$name" 2>&1; echo "exit $?")
+    translated=$(echo "$input" | "$work/$name-c" 2>&1; echo "exit $?")
+    if [ "$expected" != "$actual" ] || [ "$expected" != "$translated" ]; then
+        printf "%-20s %s\n" "$name" "FAILED: output differs from cc0 run"
+        continue
+    fi
+
+    interpreted=$(measure "$cc0" run -O2 "$program")
+    native=$(measure "$work/$name")
+    c=$(measure "$work/$name-c")
+    awk -v name="$name" -v a="$interpreted" -v b="$native" -v c="$c" \
+        'BEGIN { printf "%-20s %10d %12d %10d %8.1fx %8.1fx\n", name, a, b, c, a / (b > 0 ? b : 1), a / (c > 0 ? c : 1) }'
+done
@@ -18,89 +18,133 @@
 };*/
 
 namespace c0 {
-    void Binary::writeNBytes (std::ostream &out, void *addr, int count) {
-        char bytes[8] = {0};
-        char *p = (char*)addr + (count - 1);
-        for (int i = 0; i < count; ++i) {
-            bytes[i] = *p--;
+    // 按大端序写入 value 的低 N 个字节，返回写入后的位置
+    template<int N>
+    inline char* storeBE(char *p, vm::u4 value) {
+        static_assert(N == 1 || N == 2 || N == 4, "operand width must be 1, 2 or 4");
+        if constexpr (N == 4) {
+            p[0] = (char)(value >> 24);
+            p[1] = (char)(value >> 16);
+            p = p + 2;
         }
-        out.write(bytes, count);
+        if constexpr (N >= 2)
+            *p++ = (char)(value >> 8);
+        *p++ = (char)value;
+        return p;
     }
 
-    void Binary::to_binary (std::ostream &out, const std::vector<c0::Instruction> &v) {
-        vm::u2 instructions_count = v.size();
-        writeNBytes(out, &instructions_count, sizeof instructions_count);
-
-        for (auto &ins : v) {
-            vm::u1 op = static_cast<vm::u1>(ins.getOpr());
-            writeNBytes(out, &op, sizeof(vm::u1));
-
-            auto it = oprPara.find(ins.getOpr());
-            if ( it != oprPara.end()) {
-                auto paras = it->second;
+    inline char* storeOperand(char *p, int width, vm::u4 value) {
+        switch (width) {
+            case 1:
+                return storeBE<1>(p, value);
+            case 2:
+                return storeBE<2>(p, value);
+            case 4:
+                return storeBE<4>(p, value);
+            default:
+                return p;
+        }
+    }
 
-                if (paras[0] == 1) {
-                    vm::u1 x = ins.getX();
-                    writeNBytes(out, &x, 1);
-                } else if (paras[0] == 2) {
-                    vm::u2 x = ins.getX();
-                    writeNBytes(out, &x, 2);
-                } else if (paras[0] == 4) {
-                    vm::u4 x = ins.getX();
-                    writeNBytes(out, &x, 4);
-                }
+    std::size_t Binary::codeSize(const std::vector<Instruction> &v) {
+        // instructions_count + opcode
+        std::size_t size = 2 + v.size();
+        for (auto &ins : v)
+            size += operandWidths[ins.getOpr()].size();
+        return size;
+    }
 
-                if (paras.size() == 2) {
-                    if (paras[1] == 1) {
-                        vm::u1 y = ins.getY();
-                        writeNBytes(out, &y, 1);
-                    } else if (paras[1] == 2) {
-                        vm::u2 y = ins.getY();
-                        writeNBytes(out, &y, 2);
-                    } else if (paras[1] == 4) {
-                        vm::u4 y = ins.getY();
-                        writeNBytes(out, &y, 4);
-                    }
-                }
-            }
+    char* Binary::encodeCode(char *p, const std::vector<Instruction> &v) {
+        p = storeBE<2>(p, v.size());
+        for (auto &ins : v) {
+            *p++ = (char)ins.getOpr();
+            auto width = operandWidths[ins.getOpr()];
+            p = storeOperand(p, width.x, ins.getX());
+            p = storeOperand(p, width.y, ins.getY());
         }
+        return p;
+    }
+
+    std::size_t Binary::objectSize() const {
+        // magic + version + constants_count
+        std::size_t size = 4 + 4 + 2;
+        for (auto &pair : _constants)
+            size += 1 + 2 + pair.second.length();
+        size += codeSize(_start);
+        size += 2;
+        for (int i = 0; i < (int)_functions.size(); i++)
+            size += 2 * 3 + codeSize(_instructions[i]);
+        return size;
     }
 
-    void Binary::output_binary(std::ofstream &out) {
+    std::vector<char> Binary::encode() const {
+        std::vector<char> buffer(objectSize());
+        char *p = buffer.data();
+
         // magic
-        out.write("\x43\x30\x3A\x29", 4);
+        p = storeBE<4>(p, 0x43303A29);
         // version
-        out.write("\x00\x00\x00\x01", 4);
-        // constants_count
-        vm::u2 constants_count = _constants.size();
-        writeNBytes(out, &constants_count, sizeof(vm::u2));
+        p = storeBE<4>(p, 0x00000001);
         // constants
+        p = storeBE<2>(p, _constants.size());
         for (auto &pair : _constants) {
-            out.write("\x00", 1);
-            std::string s = pair.second;
-            vm::u2 len = s.length();
-            writeNBytes(out, &len, sizeof len);
-            out.write(s.c_str(), len);
+            *p++ = 0x00;
+            vm::u2 len = pair.second.length();
+            p = storeBE<2>(p, len);
+            std::copy(pair.second.data(), pair.second.data() + len, p);
+            p += len;
         }
 
         // start
-        to_binary(out, _start);
+        p = encodeCode(p, _start);
 
-        // functions_count
-        vm::u2 functions_count = _functions.size();
-        writeNBytes(out, &functions_count, sizeof(vm::u2));
         // functions
+        p = storeBE<2>(p, _functions.size());
         for (int i = 0; i < (int)_functions.size(); i++) {
-            auto fun = _functions[i];
-            vm::u2 n;
-            n = fun.name_index;
-            writeNBytes(out, &n, sizeof(vm::u2));
-            n = fun.params_size;
-            writeNBytes(out, &n, sizeof(vm::u2));
-            n = fun.level;
-            writeNBytes(out, &n, sizeof(vm::u2));
+            auto &fun = _functions[i];
+            p = storeBE<2>(p, (vm::u2)fun.name_index);
+            p = storeBE<2>(p, (vm::u2)fun.params_size);
+            p = storeBE<2>(p, (vm::u2)fun.level);
+            p = encodeCode(p, _instructions[i]);
+        }
+        return buffer;
+    }
+
+    std::optional<std::string> Binary::checkVersion1() const {
+        const std::size_t limit = 0xffff;
+        if (_constants.size() > limit)
+            return std::to_string(_constants.size()) + " constants";
+        for (auto &pair : _constants) {
+            if (pair.second.length() > limit)
+                return "a string constant of " + std::to_string(pair.second.length()) + " bytes";
+        }
+        if (_functions.size() > limit)
+            return std::to_string(_functions.size()) + " functions";
+
+        if (auto err = checkCodeVersion1(_start, ".start"))
+            return err;
+        for (int i = 0; i < (int)_instructions.size(); i++) {
+            if (auto err = checkCodeVersion1(_instructions[i], ".F" + std::to_string(i)))
+                return err;
+        }
+        return {};
+    }
 
-            to_binary(out, _instructions[i]);
+    std::optional<std::string> Binary::checkCodeVersion1(const std::vector<Instruction> &v, const std::string &name) {
+        const std::size_t limit = 0xffff;
+        if (v.size() > limit)
+            return name + " has " + std::to_string(v.size()) + " instructions";
+        for (auto &ins : v) {
+            if (operandWidths[ins.getOpr()].x == 2 && (ins.getX() < 0 || ins.getX() > (int)limit))
+                return name + " has operand " + std::to_string(ins.getX()) + " out of 16 bits";
+            if (operandWidths[ins.getOpr()].y == 2 && (ins.getY() < 0 || ins.getY() > (int)limit))
+                return name + " has operand " + std::to_string(ins.getY()) + " out of 16 bits";
         }
+        return {};
+    }
+
+    void Binary::output_binary(std::ofstream &out, const ObjectFormat &format) {
+        auto buffer = format.version == 2 ? encodeV2(format.varintOperands, format.debugLines) : encode();
+        out.write(buffer.data(), buffer.size());
     }
-}
\ No newline at end of file
+}
@@ -1,10 +1,13 @@
+#pragma once
+
 #include "../generater/generator.h"
 
 #include <iostream>
 #include <fstream>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
-#include <unordered_map>
 
 namespace vm {
 
@@ -27,38 +30,57 @@ namespace vm {
 }
 
 namespace c0 {
+    // 目标文件的版本和编码方式
+    class ObjectFormat {
+    public:
+        // 1 或 2
+        int version = 1;
+        // 只用于版本 2，操作数使用变长编码
+        bool varintOperands = false;
+        // 只用于版本 2，输出行号表（调试信息段）
+        bool debugLines = false;
+    };
+
     class Binary {
     public:
         Binary(std::vector<std::pair<char, std::string>> constants, std::vector<Instruction> start,
                std::vector<funcInfo> functions, std::vector<std::vector<Instruction>> instructions)
                 : _constants(std::move(constants)), _start(std::move(start)),
                   _functions(std::move(functions)), _instructions(std::move(instructions)) {}
+        explicit Binary(byteCode code)
+                : Binary(std::move(code.constants), std::move(code.start),
+                         std::move(code.functions), std::move(code.instructions)) {}
+
+        void output_binary(std::ofstream &out, const ObjectFormat &format = ObjectFormat());
 
-        void output_binary(std::ofstream &out);
+        // 版本 1 的计数和操作数只有 16 位，超出时返回错误信息
+        std::optional<std::string> checkVersion1() const;
+
+        // 版本 1 目标文件的字节数
+        std::size_t objectSize() const;
+        // 整个目标文件编码到一块连续的内存中
+        std::vector<char> encode() const;
+        // 版本 2，见 object_v2.cpp
+        std::vector<char> encodeV2(bool varintOperands, bool debugLines = false) const;
+        // 版本 2 中可选的栈帧段，frames[0] 为 .start，frames[i + 1] 为函数 i，为空时不输出
+        void setFrames(std::vector<frameInfo> frames) { _frames = std::move(frames); }
+
+        // 以下用于逐个函数编码，见 stream_writer.h
+        // 版本 1 中一段指令序列的字节数，包括 instructions_count
+        static std::size_t codeSize(const std::vector<Instruction> &v);
+        // 版本 1 编码 instructions_count 和指令，返回写入后的位置
+        static char* encodeCode(char *p, const std::vector<Instruction> &v);
+        static std::optional<std::string> checkCodeVersion1(const std::vector<Instruction> &v, const std::string &name);
+        // 版本 2 编码指令，不包括 instructions_count
+        static void appendCodeV2(std::vector<char> &out, const std::vector<Instruction> &v, bool varintOperands);
+        // 版本 2 调试信息段中一段指令序列的行号表
+        static void appendLinesV2(std::vector<char> &out, const std::vector<Instruction> &v);
 
     private:
         std::vector<std::pair<char, std::string>> _constants;
         std::vector<Instruction> _start;
         std::vector<funcInfo> _functions;
         std::vector<std::vector<Instruction>> _instructions;
-
-        static void writeNBytes (std::ostream &out, void *addrstatic , int count);
-        void to_binary (std::ostream &out, const std::vector<c0::Instruction> &v);
-
-        const std::unordered_map<opCode, std::vector<int>> oprPara = {
-            { opCode::biPush, {1} },
-            { opCode::iPush, {4} },
-            { opCode::popN, {4} },
-            { opCode::loadC, {2} },
-            { opCode::loadA, {2, 4} },
-            { opCode::jmp, {2} },
-            { opCode::je, {2} },
-            { opCode::jne, {2} },
-            { opCode::jl, {2} },
-            { opCode::jge, {2} },
-            { opCode::jg, {2} },
-            { opCode::jle, {2} },
-            { opCode::call, {2} },
-        };
+        std::vector<frameInfo> _frames;
     };
 }
\ No newline at end of file
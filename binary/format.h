@@ -0,0 +1,122 @@
+#pragma once
+
+#include "instruction/instruction.h"
+#include "instruction/line_table.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * 目标文件格式中写入和读取共用的部分，格式说明见 refer/object_format.txt
+ */
+
+namespace c0 {
+    constexpr std::uint32_t objectMagic = 0x43303A29;
+
+    // 指令的编码方式
+    enum class CodeEncoding {
+        // 版本 1，操作数宽度见 operandWidths
+        Version1,
+        // 版本 2，每个操作数 4 字节
+        Fixed32,
+        // 版本 2，操作数为 LEB128 变长整数
+        Varint,
+    };
+
+    // 版本 2 文件头中的 flags
+    constexpr std::uint32_t objectFlagVarint = 0x1;
+
+    // 版本 2 的段
+    enum SectionKind : std::uint32_t {
+        ConstantsSection = 1,
+        StartSection = 2,
+        FunctionsSection = 3,
+        CodeSection = 4,
+        // 可选的调试信息，见 -g
+        DebugLinesSection = 5,
+        // 可选的每个指令序列的栈帧大小，见 frameInfo
+        FramesSection = 6,
+    };
+
+    // magic + version + flags + section_count
+    constexpr std::size_t objectV2HeaderSize = 16;
+    // kind + offset + size
+    constexpr std::size_t sectionEntrySize = 12;
+    // name_index + params_size + level + code_offset + code_size + instructions_count
+    constexpr std::size_t functionEntrySize = 4 + 2 + 2 + 4 + 4 + 4;
+    // max_stack + locals
+    constexpr std::size_t frameEntrySize = 4 + 4;
+
+    // 变长编码时按有符号数（zigzag）编码的操作数
+    inline bool signedOperand(opCode op) {
+        return op == opCode::iPush || op == opCode::biPush || op == opCode::tableSwitch;
+    }
+
+    inline std::uint32_t zigzag(std::int32_t value) {
+        return ((std::uint32_t)value << 1) ^ (std::uint32_t)(value >> 31);
+    }
+
+    inline std::int32_t unzigzag(std::uint32_t value) {
+        return (std::int32_t)(value >> 1) ^ -(std::int32_t)(value & 1);
+    }
+
+    // 读取 LEB128，越界或超过 5 字节时返回 nullptr
+    inline const char* readVarint(const char* p, const char* end, std::uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 35 && p < end; shift += 7) {
+            auto byte = (unsigned char)*p++;
+            value |= (std::uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return p;
+        }
+        return nullptr;
+    }
+
+    // 按大端序追加 value 的低 count 个字节
+    inline void appendBE(std::vector<char>& out, std::uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--)
+            out.push_back((char)(value >> (8 * i)));
+    }
+
+    // 按大端序改写 pos 处的 4 个字节
+    inline void patchBE(std::vector<char>& out, std::size_t pos, std::uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            out[pos + i] = (char)(value >> (8 * (3 - i)));
+    }
+
+    inline void appendVarint(std::vector<char>& out, std::uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back((char)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((char)value);
+    }
+
+    // 调试信息段中一段指令序列的行号表：entries_count，{ offset 的增量, line 的增量（zigzag） }，都是 LEB128
+    inline void appendLineTable(std::vector<char>& out, const std::vector<LineEntry>& table) {
+        appendVarint(out, table.size());
+        LineEntry last = { 0, 0 };
+        for (const auto& entry : table) {
+            appendVarint(out, entry.offset - last.offset);
+            appendVarint(out, zigzag((std::int32_t)(entry.line - last.line)));
+            last = entry;
+        }
+    }
+
+    // 越界或数据不正确时返回 nullptr
+    inline const char* readLineTable(const char* p, const char* end, std::vector<LineEntry>& table) {
+        std::uint32_t count;
+        if ((p = readVarint(p, end, count)) == nullptr || count > (std::size_t)(end - p))
+            return nullptr;
+        table.reserve(count);
+        LineEntry last = { 0, 0 };
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t offset, line;
+            if ((p = readVarint(p, end, offset)) == nullptr || (p = readVarint(p, end, line)) == nullptr)
+                return nullptr;
+            last = { last.offset + offset, last.line + (std::uint32_t)unzigzag(line) };
+            table.push_back(last);
+        }
+        return p;
+    }
+}
@@ -0,0 +1,436 @@
+#include "loader.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define C0_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace c0 {
+    MappedFile::MappedFile(MappedFile&& f) noexcept
+        : _data(f._data), _size(f._size), _mapped(f._mapped), _buffer(std::move(f._buffer)) {
+        f._data = nullptr;
+        f._size = 0;
+        f._mapped = false;
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& f) noexcept {
+        if (this != &f) {
+            close();
+            _data = f._data;
+            _size = f._size;
+            _mapped = f._mapped;
+            _buffer = std::move(f._buffer);
+            f._data = nullptr;
+            f._size = 0;
+            f._mapped = false;
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    void MappedFile::close() {
+#ifdef C0_HAVE_MMAP
+        if (_mapped)
+            munmap(const_cast<char*>(_data), _size);
+#endif
+        _data = nullptr;
+        _size = 0;
+        _mapped = false;
+        _buffer.clear();
+    }
+
+    std::optional<std::string> MappedFile::open(const std::string& path) {
+        close();
+#ifdef C0_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return "Fail to open " + path + " for reading.";
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return "Fail to stat " + path + ".";
+        }
+        _size = (std::size_t)st.st_size;
+        if (_size > 0) {
+            void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                _size = 0;
+                return "Fail to map " + path + ".";
+            }
+            _data = static_cast<const char*>(p);
+            _mapped = true;
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            return "Fail to open " + path + " for reading.";
+        _buffer.resize((std::size_t)in.tellg());
+        in.seekg(0);
+        in.read(_buffer.data(), _buffer.size());
+        _data = _buffer.data();
+        _size = _buffer.size();
+#endif
+        return {};
+    }
+
+    // 按大端序读取 N 个字节
+    template<int N>
+    inline std::uint32_t loadBE(const char* p) {
+        std::uint32_t value = 0;
+        for (int i = 0; i < N; i++)
+            value = (value << 8) | (unsigned char)p[i];
+        return value;
+    }
+
+    inline int loadOperand(const char* p, int width) {
+        switch (width) {
+            case 1:
+                return (int)loadBE<1>(p);
+            case 2:
+                return (int)loadBE<2>(p);
+            case 4:
+                return (int)(std::int32_t)loadBE<4>(p);
+            default:
+                return 0;
+        }
+    }
+
+    // 解码 p 处的一条指令，返回下一条指令的位置
+    const char* decode(const char* p, CodeEncoding encoding, Instruction& ins) {
+        auto op = (opCode)(unsigned char)*p++;
+        auto width = operandWidths[op];
+        int operands[2] = { 0, 0 };
+        for (int k = 0; k < 2; k++) {
+            int w = k == 0 ? width.x : width.y;
+            if (w == 0)
+                continue;
+            switch (encoding) {
+                case CodeEncoding::Version1:
+                    operands[k] = loadOperand(p, w);
+                    p += w;
+                    break;
+                case CodeEncoding::Fixed32:
+                    operands[k] = (int)(std::int32_t)loadBE<4>(p);
+                    p += 4;
+                    break;
+                case CodeEncoding::Varint: {
+                    std::uint32_t value;
+                    // 已经校验过，不会越界
+                    p = readVarint(p, p + 5, value);
+                    operands[k] = signedOperand(op) ? unzigzag(value) : (int)value;
+                    break;
+                }
+            }
+        }
+        ins = Instruction(op, operands[0], operands[1]);
+        return p;
+    }
+
+    Instruction CodeView::iterator::operator*() const {
+        Instruction ins;
+        decode(_p, _encoding, ins);
+        return ins;
+    }
+
+    CodeView::iterator& CodeView::iterator::operator++() {
+        if (_encoding == CodeEncoding::Version1)
+            _p += 1 + operandWidths[(unsigned char)_p[0]].size();
+        else {
+            Instruction ins;
+            _p = decode(_p, _encoding, ins);
+        }
+        return *this;
+    }
+
+    bool isOpCode(unsigned char op) {
+        switch (op) {
+            case nop: case biPush: case iPush: case pop1: case popN:
+            case loadC: case loadA: case iLoad: case iStore:
+            case iAdd: case iSub: case iMul: case iDiv: case iNeg: case iCmp: case i2c:
+            case jmp: case je: case jne: case jl: case jge: case jg: case jle: case tableSwitch:
+            case call: case ret: case iRet:
+            case iPrint: case cPrint: case sPrint: case fPrint: case printL: case iScan: case cScan:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // 顺序读取目标文件，越界时记录错误
+    class Reader {
+    public:
+        Reader(const char* p, const char* end) : p(p), end(end) {}
+
+        const char* p;
+        const char* end;
+
+        bool has(std::size_t n) const { return (std::size_t)(end - p) >= n; }
+
+        template<int N>
+        bool read(std::uint32_t& value) {
+            if (!has(N))
+                return false;
+            value = loadBE<N>(p);
+            p += N;
+            return true;
+        }
+
+        // 校验一段指令序列并返回它的视图
+        std::optional<std::string> code(CodeView& view) {
+            std::uint32_t count;
+            if (!read<2>(count))
+                return std::string("truncated instruction count");
+            const char* begin = p;
+            for (std::uint32_t i = 0; i < count; i++) {
+                if (!has(1))
+                    return "truncated instruction " + std::to_string(i);
+                auto op = (unsigned char)*p;
+                if (!isOpCode(op))
+                    return "unknown opcode " + std::to_string(op) + " at instruction " + std::to_string(i);
+                std::size_t size = 1 + operandWidths[op].size();
+                if (!has(size))
+                    return "truncated instruction " + std::to_string(i);
+                p += size;
+            }
+            view = CodeView(begin, p, count, CodeEncoding::Version1);
+            return {};
+        }
+    };
+
+    std::optional<std::string> ObjectFile::parse() {
+        Reader r(_file.data(), _file.data() + _file.size());
+        std::uint32_t value;
+
+        if (!r.read<4>(value) || value != 0x43303A29)
+            return std::string("bad magic");
+        if (!r.read<4>(_version) || (_version != 1 && _version != 2))
+            return "unsupported version " + std::to_string(_version);
+        if (_version == 2)
+            return parseV2();
+
+        std::uint32_t count;
+        if (!r.read<2>(count))
+            return std::string("truncated constants count");
+        _constants.reserve(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t type, len;
+            if (!r.read<1>(type) || !r.read<2>(len) || !r.has(len))
+                return "truncated constant " + std::to_string(i);
+            // 目前只会写出字符串常量
+            if (type != 0)
+                return "unsupported type " + std::to_string(type) + " of constant " + std::to_string(i);
+            _constants.emplace_back('S', std::string_view(r.p, len));
+            r.p += len;
+        }
+
+        if (auto err = r.code(_start))
+            return ".start: " + err.value();
+
+        if (!r.read<2>(count))
+            return std::string("truncated functions count");
+        _functions.reserve(count);
+        _instructions.reserve(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t name, params, level;
+            if (!r.read<2>(name) || !r.read<2>(params) || !r.read<2>(level))
+                return "truncated function " + std::to_string(i);
+            if (name >= _constants.size())
+                return "name index " + std::to_string(name) + " of function " + std::to_string(i) + " out of range";
+            _functions.emplace_back((std::int32_t)name, (std::int16_t)params, (std::int16_t)level);
+            _instructions.emplace_back();
+            if (auto err = r.code(_instructions.back()))
+                return ".F" + std::to_string(i) + ": " + err.value();
+        }
+
+        if (r.p != r.end)
+            return std::to_string(r.end - r.p) + " trailing bytes";
+        return {};
+    }
+
+    std::optional<std::string> CodeView::verify() const {
+        const char* p = _begin;
+        for (std::size_t i = 0; i < _count; i++) {
+            if (p >= _end)
+                return "truncated instruction " + std::to_string(i);
+            auto op = (unsigned char)*p++;
+            if (!isOpCode(op))
+                return "unknown opcode " + std::to_string(op) + " at instruction " + std::to_string(i);
+            auto width = operandWidths[op];
+            int operands = (width.x != 0) + (width.y != 0);
+            for (int k = 0; k < operands; k++) {
+                if (_encoding == CodeEncoding::Varint) {
+                    std::uint32_t value;
+                    p = readVarint(p, _end, value);
+                    if (p == nullptr)
+                        return "bad operand at instruction " + std::to_string(i);
+                } else {
+                    std::size_t size = _encoding == CodeEncoding::Fixed32 ? 4 : (k == 0 ? width.x : width.y);
+                    if ((std::size_t)(_end - p) < size)
+                        return "truncated instruction " + std::to_string(i);
+                    p += size;
+                }
+            }
+        }
+        if (p != _end)
+            return std::to_string(_end - p) + " bytes after the last instruction";
+        return {};
+    }
+
+    std::optional<std::string> ObjectFile::verify(std::size_t i) const {
+        if (_version == 1)
+            return {};
+        if (auto err = _instructions[i].verify())
+            return ".F" + std::to_string(i) + ": " + err.value();
+        return {};
+    }
+
+    std::optional<std::string> ObjectFile::parseV2() {
+        const char* data = _file.data();
+        std::size_t size = _file.size();
+        Reader r(data + 8, data + size);
+
+        std::uint32_t flags, sectionCount;
+        if (!r.read<4>(flags) || !r.read<4>(sectionCount))
+            return std::string("truncated header");
+        if (flags & ~objectFlagVarint)
+            return "unknown flags " + std::to_string(flags);
+        auto encoding = (flags & objectFlagVarint) ? CodeEncoding::Varint : CodeEncoding::Fixed32;
+        if (!r.has((std::size_t)sectionCount * sectionEntrySize))
+            return std::string("truncated section table");
+
+        // 段的位置，按 SectionKind 索引
+        const char* sections[7][2] = {};
+        for (std::uint32_t i = 0; i < sectionCount; i++) {
+            std::uint32_t kind, offset, length;
+            if (!r.read<4>(kind) || !r.read<4>(offset) || !r.read<4>(length))
+                return std::string("truncated section table");
+            if (offset > size || length > size - offset)
+                return "section " + std::to_string(i) + " out of range";
+            // 不认识的段跳过
+            if (kind >= ConstantsSection && kind <= FramesSection) {
+                sections[kind][0] = data + offset;
+                sections[kind][1] = data + offset + length;
+            }
+        }
+        for (std::uint32_t kind = ConstantsSection; kind <= CodeSection; kind++) {
+            if (sections[kind][0] == nullptr)
+                return "missing section " + std::to_string(kind);
+        }
+
+        Reader constants(sections[ConstantsSection][0], sections[ConstantsSection][1]);
+        std::uint32_t count;
+        if (!constants.read<4>(count))
+            return std::string("truncated constants count");
+        if (!constants.has(count))
+            return std::string("too many constants");
+        _constants.reserve(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t type, len;
+            if (!constants.read<1>(type) || !constants.read<4>(len) || !constants.has(len))
+                return "truncated constant " + std::to_string(i);
+            if (type != 0)
+                return "unsupported type " + std::to_string(type) + " of constant " + std::to_string(i);
+            _constants.emplace_back('S', std::string_view(constants.p, len));
+            constants.p += len;
+        }
+
+        Reader start(sections[StartSection][0], sections[StartSection][1]);
+        if (!start.read<4>(count))
+            return std::string("truncated .start");
+        _start = CodeView(start.p, start.end, count, encoding);
+        if (auto err = _start.verify())
+            return ".start: " + err.value();
+
+        Reader functions(sections[FunctionsSection][0], sections[FunctionsSection][1]);
+        const char* code = sections[CodeSection][0];
+        std::size_t codeSize = sections[CodeSection][1] - code;
+        if (!functions.read<4>(count) || !functions.has((std::size_t)count * functionEntrySize))
+            return std::string("truncated function table");
+        _functions.reserve(count);
+        _instructions.reserve(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t name, params, level, offset, length, instructions;
+            if (!functions.read<4>(name) || !functions.read<2>(params) || !functions.read<2>(level)
+                || !functions.read<4>(offset) || !functions.read<4>(length) || !functions.read<4>(instructions))
+                return std::string("truncated function table");
+            if (name >= _constants.size())
+                return "name index " + std::to_string(name) + " of function " + std::to_string(i) + " out of range";
+            if (offset > codeSize || length > codeSize - offset)
+                return "code of function " + std::to_string(i) + " out of range";
+            _functions.emplace_back((std::int32_t)name, (std::int16_t)params, (std::int16_t)level);
+            _instructions.emplace_back(code + offset, code + offset + length, instructions, encoding);
+        }
+
+        if (sections[DebugLinesSection][0] != nullptr) {
+            if (auto err = parseLines(sections[DebugLinesSection][0], sections[DebugLinesSection][1]))
+                return err;
+        }
+        if (sections[FramesSection][0] != nullptr)
+            return parseFrames(sections[FramesSection][0], sections[FramesSection][1]);
+        return {};
+    }
+
+    std::optional<std::string> ObjectFile::parseLines(const char* begin, const char* end) {
+        Reader r(begin, end);
+        std::uint32_t count;
+        if (!r.read<4>(count))
+            return std::string("truncated debug lines");
+        if (count != _instructions.size() + 1)
+            return "debug lines for " + std::to_string(count) + " code sequences, expected "
+                + std::to_string(_instructions.size() + 1);
+        _lines.resize(count);
+        const char* p = r.p;
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::string name = i == 0 ? ".start" : ".F" + std::to_string(i - 1);
+            if ((p = readLineTable(p, end, _lines[i])) == nullptr)
+                return "bad debug lines of " + name;
+            std::size_t size = i == 0 ? _start.size() : _instructions[i - 1].size();
+            for (std::size_t k = 0; k < _lines[i].size(); k++) {
+                if (_lines[i][k].offset >= size || (k > 0 && _lines[i][k].offset <= _lines[i][k - 1].offset))
+                    return "bad debug lines of " + name;
+            }
+        }
+        return {};
+    }
+
+    std::optional<std::string> ObjectFile::parseFrames(const char* begin, const char* end) {
+        Reader r(begin, end);
+        std::uint32_t count;
+        if (!r.read<4>(count))
+            return std::string("truncated frames");
+        if (count != _instructions.size() + 1)
+            return "frames for " + std::to_string(count) + " code sequences, expected "
+                + std::to_string(_instructions.size() + 1);
+        if (!r.has((std::size_t)count * frameEntrySize))
+            return std::string("truncated frames");
+        _frames.reserve(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t maxStack = 0, locals = 0;
+            r.read<4>(maxStack);
+            r.read<4>(locals);
+            if (maxStack > 0x7fffffff || locals > maxStack)
+                return "bad frame of " + (i == 0 ? std::string(".start") : ".F" + std::to_string(i - 1));
+            _frames.push_back({ (std::int32_t)maxStack, (std::int32_t)locals });
+        }
+        return {};
+    }
+
+    std::pair<std::optional<ObjectFile>, std::optional<std::string>> ObjectFile::Load(const std::string& path) {
+        ObjectFile object;
+        if (auto err = object._file.open(path))
+            return std::make_pair(std::optional<ObjectFile>(), err);
+        if (auto err = object.parse())
+            return std::make_pair(std::optional<ObjectFile>(), path + ": " + err.value());
+        return std::make_pair(std::optional<ObjectFile>(std::move(object)), std::optional<std::string>());
+    }
+}
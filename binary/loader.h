@@ -0,0 +1,123 @@
+#pragma once
+
+#include "binary.h"
+#include "format.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace c0 {
+
+    // 只读映射到内存中的文件，不支持 mmap 的平台上读入一块缓冲区
+    class MappedFile final {
+    public:
+        MappedFile() : _data(nullptr), _size(0), _mapped(false), _buffer({}) {}
+        MappedFile(MappedFile&&) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&&) noexcept;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        // 失败时返回错误信息
+        std::optional<std::string> open(const std::string& path);
+
+        const char* data() const { return _data; }
+        std::size_t size() const { return _size; }
+
+    private:
+        const char* _data;
+        std::size_t _size;
+        bool _mapped;
+        std::vector<char> _buffer;
+
+        void close();
+    };
+
+    // 目标文件中一段指令序列的视图，遍历时逐条解码，不复制也不分配内存
+    // 只能遍历校验过的指令序列，见 ObjectFile::verify
+    class CodeView final {
+    public:
+        class iterator {
+        public:
+            iterator(const char* p, CodeEncoding encoding) : _p(p), _encoding(encoding) {}
+
+            Instruction operator*() const;
+            iterator& operator++();
+            bool operator==(const iterator& rhs) const { return _p == rhs._p; }
+            bool operator!=(const iterator& rhs) const { return _p != rhs._p; }
+
+        private:
+            const char* _p;
+            CodeEncoding _encoding;
+        };
+
+        CodeView() : CodeView(nullptr, nullptr, 0, CodeEncoding::Version1) {}
+        CodeView(const char* begin, const char* end, std::size_t count, CodeEncoding encoding)
+            : _begin(begin), _end(end), _count(count), _encoding(encoding) {}
+
+        std::size_t size() const { return _count; }
+        iterator begin() const { return iterator(_begin, _encoding); }
+        iterator end() const { return iterator(_end, _encoding); }
+
+        // 校验每条指令的操作码和操作数都在范围内，且正好有 size() 条
+        std::optional<std::string> verify() const;
+
+    private:
+        const char* _begin;
+        const char* _end;
+        std::size_t _count;
+        CodeEncoding _encoding;
+    };
+
+    // .o0 目标文件的读取
+    // Load 时校验文件头、常量和函数表，之后常量和指令都直接引用映射的内存
+    // 版本 1 的函数体只能顺序找到，Load 时全部校验；
+    // 版本 2 可以直接定位函数体，只在 verify 时校验，没用到的函数不会被读取
+    class ObjectFile final {
+    public:
+        ObjectFile(ObjectFile&&) = default;
+        ObjectFile(const ObjectFile&) = delete;
+        ObjectFile& operator=(ObjectFile&&) = default;
+        ObjectFile& operator=(const ObjectFile&) = delete;
+
+        static std::pair<std::optional<ObjectFile>, std::optional<std::string>> Load(const std::string& path);
+
+        std::uint32_t version() const { return _version; }
+        // 常量的类型和值，值指向映射的内存
+        const std::vector<std::pair<char, std::string_view>>& constants() const { return _constants; }
+        const CodeView& start() const { return _start; }
+        const std::vector<funcInfo>& functions() const { return _functions; }
+        // 第 i 个函数的指令
+        const std::vector<CodeView>& instructions() const { return _instructions; }
+
+        // 调试信息段中的行号表，0 为 .start，i + 1 为函数 i；没有调试信息时为空
+        const std::vector<std::vector<LineEntry>>& lines() const { return _lines; }
+        // 栈帧段中的栈帧大小，0 为 .start，i + 1 为函数 i；没有栈帧段时为空
+        // 只检查了数量和 max_stack >= locals，执行引擎使用前需要自己验证
+        const std::vector<frameInfo>& frames() const { return _frames; }
+
+        // 校验第 i 个函数体，版本 1 总是成功
+        std::optional<std::string> verify(std::size_t i) const;
+
+    private:
+        ObjectFile() : _file(), _version(0), _constants({}), _start(), _functions({}), _instructions({}), _lines({}), _frames({}) {}
+
+        MappedFile _file;
+        std::uint32_t _version;
+        std::vector<std::pair<char, std::string_view>> _constants;
+        CodeView _start;
+        std::vector<funcInfo> _functions;
+        std::vector<CodeView> _instructions;
+        std::vector<std::vector<LineEntry>> _lines;
+        std::vector<frameInfo> _frames;
+
+        std::optional<std::string> parse();
+        std::optional<std::string> parseV2();
+        std::optional<std::string> parseLines(const char* begin, const char* end);
+        std::optional<std::string> parseFrames(const char* begin, const char* end);
+    };
+}
@@ -0,0 +1,128 @@
+#include "./binary.h"
+#include "./format.h"
+
+/*
+ * 版本 2 目标文件的写入，格式见 refer/object_format.txt
+ * 所有计数都是 32 位，函数表中记录每个函数体在代码段中的位置，可以只解码用到的函数
+ */
+
+namespace c0 {
+    void appendOperand(std::vector<char> &out, opCode op, int value, bool varint) {
+        if (!varint)
+            appendBE(out, (vm::u4)value, 4);
+        else if (signedOperand(op))
+            appendVarint(out, zigzag(value));
+        else
+            appendVarint(out, (vm::u4)value);
+    }
+
+    void Binary::appendCodeV2(std::vector<char> &out, const std::vector<Instruction> &v, bool varint) {
+        for (auto &ins : v) {
+            out.push_back((char)ins.getOpr());
+            auto width = operandWidths[ins.getOpr()];
+            if (width.x)
+                appendOperand(out, ins.getOpr(), ins.getX(), varint);
+            if (width.y)
+                appendOperand(out, ins.getOpr(), ins.getY(), varint);
+        }
+    }
+
+    void Binary::appendLinesV2(std::vector<char> &out, const std::vector<Instruction> &v) {
+        appendLineTable(out, lineTable(v));
+    }
+
+    std::vector<char> Binary::encodeV2(bool varintOperands, bool debugLines) const {
+        std::vector<char> out;
+        // 定长编码时的大小，变长编码只会更小
+        out.reserve(objectSize() + 4 * (_instructions.size() + 1) * 4 + _functions.size() * functionEntrySize
+                    + _frames.size() * frameEntrySize);
+
+        // constants, start, functions, code，以及可选的 debug_lines 和 frames
+        const std::size_t sectionCount = 4 + (debugLines ? 1 : 0) + (_frames.empty() ? 0 : 1);
+
+        appendBE(out, objectMagic, 4);
+        appendBE(out, 2, 4);
+        appendBE(out, varintOperands ? objectFlagVarint : 0, 4);
+        appendBE(out, sectionCount, 4);
+        std::size_t table = out.size();
+        out.resize(out.size() + sectionCount * sectionEntrySize);
+
+        std::size_t section = 0, sectionBegin = 0;
+        auto beginSection = [&](vm::u4 kind) {
+            patchBE(out, table + section * sectionEntrySize, kind);
+            sectionBegin = out.size();
+        };
+        auto endSection = [&]() {
+            std::size_t entry = table + section * sectionEntrySize;
+            patchBE(out, entry + 4, sectionBegin);
+            patchBE(out, entry + 8, out.size() - sectionBegin);
+            section++;
+        };
+
+        // constants: count, { type, length, bytes }
+        beginSection(ConstantsSection);
+        appendBE(out, _constants.size(), 4);
+        for (auto &pair : _constants) {
+            out.push_back(0x00);
+            appendBE(out, pair.second.length(), 4);
+            out.insert(out.end(), pair.second.begin(), pair.second.end());
+        }
+        endSection();
+
+        // start: instructions_count, code
+        beginSection(StartSection);
+        appendBE(out, _start.size(), 4);
+        appendCodeV2(out, _start, varintOperands);
+        endSection();
+
+        // functions: count, { name_index, params_size, level, code_offset, code_size, instructions_count }
+        beginSection(FunctionsSection);
+        appendBE(out, _functions.size(), 4);
+        std::size_t functionTable = out.size();
+        out.resize(out.size() + _functions.size() * functionEntrySize);
+        endSection();
+
+        // code: 所有函数体，偏移相对于代码段开头
+        beginSection(CodeSection);
+        std::size_t codeBegin = out.size();
+        for (int i = 0; i < (int)_functions.size(); i++) {
+            auto &fun = _functions[i];
+            std::size_t begin = out.size();
+            appendCodeV2(out, _instructions[i], varintOperands);
+
+            std::size_t pos = functionTable + i * functionEntrySize;
+            patchBE(out, pos, (vm::u4)fun.name_index);
+            out[pos + 4] = (char)((vm::u2)fun.params_size >> 8);
+            out[pos + 5] = (char)fun.params_size;
+            out[pos + 6] = (char)((vm::u2)fun.level >> 8);
+            out[pos + 7] = (char)fun.level;
+            patchBE(out, pos + 8, begin - codeBegin);
+            patchBE(out, pos + 12, out.size() - begin);
+            patchBE(out, pos + 16, _instructions[i].size());
+        }
+        endSection();
+
+        // debug_lines: code_count，.start 和每个函数的行号表
+        if (debugLines) {
+            beginSection(DebugLinesSection);
+            appendBE(out, _functions.size() + 1, 4);
+            appendLinesV2(out, _start);
+            for (auto &code : _instructions)
+                appendLinesV2(out, code);
+            endSection();
+        }
+
+        // frames: count，.start 和每个函数的 { max_stack, locals }
+        if (!_frames.empty()) {
+            beginSection(FramesSection);
+            appendBE(out, _frames.size(), 4);
+            for (auto &frame : _frames) {
+                appendBE(out, (vm::u4)frame.max_stack, 4);
+                appendBE(out, (vm::u4)frame.locals, 4);
+            }
+            endSection();
+        }
+
+        return out;
+    }
+}
@@ -0,0 +1,202 @@
+#include "stream_writer.h"
+#include "format.h"
+
+namespace c0 {
+    ObjectStreamWriter::ObjectStreamWriter(std::ofstream& out, ObjectFormat format)
+        : _out(out), _format(format), _functions({}), _pending({}), _queue({}), _codeEntries({}), _lines({}) {}
+
+    ObjectStreamWriter::~ObjectStreamWriter() {
+        if (_writer.joinable())
+            finish();
+    }
+
+    void ObjectStreamWriter::begin(const std::vector<std::pair<char, std::string>>& constants,
+                                   const std::vector<Instruction>& start, const std::vector<funcInfo>& functions) {
+        _functions = functions;
+        std::vector<char> chunk;
+
+        if (_format.version == 1) {
+            const std::size_t limit = 0xffff;
+            if (constants.size() > limit)
+                _error = std::to_string(constants.size()) + " constants";
+            else if (functions.size() > limit)
+                _error = std::to_string(functions.size()) + " functions";
+            else if (auto err = Binary::checkCodeVersion1(start, ".start"))
+                _error = err;
+            for (auto& pair : constants) {
+                if (pair.second.length() > limit)
+                    _error = "a string constant of " + std::to_string(pair.second.length()) + " bytes";
+            }
+            // 放不下时什么也不写出
+            if (_error)
+                return;
+
+            appendBE(chunk, objectMagic, 4);
+            appendBE(chunk, 1, 4);
+            appendBE(chunk, constants.size(), 2);
+            for (auto& pair : constants) {
+                chunk.push_back(0x00);
+                appendBE(chunk, pair.second.length(), 2);
+                chunk.insert(chunk.end(), pair.second.begin(), pair.second.end());
+            }
+            std::size_t pos = chunk.size();
+            chunk.resize(pos + Binary::codeSize(start));
+            Binary::encodeCode(chunk.data() + pos, start);
+            appendBE(chunk, functions.size(), 2);
+        } else {
+            // 段表在 finish 时回填
+            appendBE(chunk, objectMagic, 4);
+            appendBE(chunk, 2, 4);
+            appendBE(chunk, _format.varintOperands ? objectFlagVarint : 0, 4);
+            std::size_t sectionCount = _format.debugLines ? 5 : 4;
+            appendBE(chunk, sectionCount, 4);
+            chunk.resize(chunk.size() + sectionCount * sectionEntrySize);
+
+            _sections[ConstantsSection][0] = chunk.size();
+            appendBE(chunk, constants.size(), 4);
+            for (auto& pair : constants) {
+                chunk.push_back(0x00);
+                appendBE(chunk, pair.second.length(), 4);
+                chunk.insert(chunk.end(), pair.second.begin(), pair.second.end());
+            }
+            _sections[ConstantsSection][1] = chunk.size() - _sections[ConstantsSection][0];
+
+            _sections[StartSection][0] = chunk.size();
+            appendBE(chunk, start.size(), 4);
+            Binary::appendCodeV2(chunk, start, _format.varintOperands);
+            _sections[StartSection][1] = chunk.size() - _sections[StartSection][0];
+
+            _sections[CodeSection][0] = chunk.size();
+            _codeEntries.resize(functions.size());
+            if (_format.debugLines) {
+                _lines.resize(functions.size() + 1);
+                Binary::appendLinesV2(_lines[0], start);
+            }
+        }
+
+        _writer = std::thread(&ObjectStreamWriter::writeLoop, this);
+        std::lock_guard<std::mutex> lock(_mutex);
+        enqueue(std::move(chunk));
+    }
+
+    void ObjectStreamWriter::function(int funcId, const std::vector<Instruction>& code) {
+        std::vector<char> chunk;
+        auto& fun = _functions[funcId];
+        std::optional<std::string> err;
+
+        if (_format.version == 1) {
+            err = Binary::checkCodeVersion1(code, ".F" + std::to_string(funcId));
+            appendBE(chunk, (std::uint32_t)fun.name_index, 2);
+            appendBE(chunk, (std::uint16_t)fun.params_size, 2);
+            appendBE(chunk, (std::uint16_t)fun.level, 2);
+            std::size_t pos = chunk.size();
+            chunk.resize(pos + Binary::codeSize(code));
+            Binary::encodeCode(chunk.data() + pos, code);
+        } else
+            Binary::appendCodeV2(chunk, code, _format.varintOperands);
+        std::vector<char> lines;
+        if (_format.version == 2 && _format.debugLines)
+            Binary::appendLinesV2(lines, code);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_format.version == 2 && _format.debugLines)
+            _lines[funcId + 1] = std::move(lines);
+        if (err && !_error)
+            _error = err;
+        // 出错后不再写出，调用者删除输出文件
+        if (_error)
+            return;
+        _pending.emplace(funcId, std::make_pair(std::move(chunk), code.size()));
+        while (!_pending.empty() && _pending.begin()->first == _nextFunction) {
+            auto& entry = _pending.begin()->second;
+            if (_format.version == 2) {
+                _codeEntries[_nextFunction] = { (std::uint32_t)(_written - _sections[CodeSection][0]),
+                                                (std::uint32_t)entry.first.size(), (std::uint32_t)entry.second };
+            }
+            enqueue(std::move(entry.first));
+            _pending.erase(_pending.begin());
+            _nextFunction++;
+        }
+    }
+
+    std::optional<std::string> ObjectStreamWriter::finish() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_nextFunction != (int)_functions.size() && !_error)
+                _error = "missing code of function " + std::to_string(_nextFunction);
+
+            if (_format.version == 2) {
+                _sections[CodeSection][1] = _written - _sections[CodeSection][0];
+
+                // 函数表放在代码段之后
+                std::vector<char> table;
+                _sections[FunctionsSection][0] = _written;
+                appendBE(table, _functions.size(), 4);
+                for (std::size_t i = 0; i < _functions.size(); i++) {
+                    appendBE(table, (std::uint32_t)_functions[i].name_index, 4);
+                    appendBE(table, (std::uint16_t)_functions[i].params_size, 2);
+                    appendBE(table, (std::uint16_t)_functions[i].level, 2);
+                    for (auto value : _codeEntries[i])
+                        appendBE(table, value, 4);
+                }
+                _sections[FunctionsSection][1] = table.size();
+                enqueue(std::move(table));
+
+                if (_format.debugLines) {
+                    std::vector<char> lines;
+                    _sections[DebugLinesSection][0] = _written;
+                    appendBE(lines, _lines.size(), 4);
+                    for (const auto& code : _lines)
+                        lines.insert(lines.end(), code.begin(), code.end());
+                    _sections[DebugLinesSection][1] = lines.size();
+                    enqueue(std::move(lines));
+                }
+            }
+            _closed = true;
+        }
+        _ready.notify_one();
+        if (_writer.joinable())
+            _writer.join();
+
+        if (_format.version == 2) {
+            std::vector<char> table;
+            for (std::uint32_t kind : { ConstantsSection, StartSection, FunctionsSection, CodeSection, DebugLinesSection }) {
+                if (kind == DebugLinesSection && !_format.debugLines)
+                    continue;
+                appendBE(table, kind, 4);
+                appendBE(table, _sections[kind][0], 4);
+                appendBE(table, _sections[kind][1], 4);
+            }
+            auto end = _out.tellp();
+            _out.seekp(objectV2HeaderSize);
+            _out.write(table.data(), table.size());
+            _out.seekp(end);
+        }
+        _out.flush();
+        if (!_out && !_error)
+            _error = std::string("write failed");
+        return _error;
+    }
+
+    // 调用时需要持有 _mutex
+    void ObjectStreamWriter::enqueue(std::vector<char> chunk) {
+        _written += chunk.size();
+        _queue.push_back(std::move(chunk));
+        _ready.notify_one();
+    }
+
+    void ObjectStreamWriter::writeLoop() {
+        while (true) {
+            std::vector<char> chunk;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _ready.wait(lock, [this] { return !_queue.empty() || _closed; });
+                if (_queue.empty())
+                    return;
+                chunk = std::move(_queue.front());
+                _queue.pop_front();
+            }
+            _out.write(chunk.data(), chunk.size());
+        }
+    }
+}
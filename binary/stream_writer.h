@@ -0,0 +1,63 @@
+#pragma once
+
+#include "binary.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace c0 {
+
+    // 边生成边输出目标文件
+    // begin 时常量表和函数表已经确定，先写出文件头、常量和 .start，
+    // 之后每个函数体编码后交给后台线程写出，内存中只保留还没写出的函数体
+    //   版本 1：函数记录按编号顺序直接写在后面
+    //   版本 2：代码段紧跟 .start，函数表和行号表放在最后，finish 时回填段表
+    class ObjectStreamWriter final {
+    public:
+        ObjectStreamWriter(std::ofstream& out, ObjectFormat format);
+        ObjectStreamWriter(ObjectStreamWriter&&) = delete;
+        ObjectStreamWriter(const ObjectStreamWriter&) = delete;
+        ObjectStreamWriter& operator=(ObjectStreamWriter) = delete;
+        ~ObjectStreamWriter();
+
+        void begin(const std::vector<std::pair<char, std::string>>& constants,
+                   const std::vector<Instruction>& start, const std::vector<funcInfo>& functions);
+        // 可以在多个线程中以任意顺序调用，按编号顺序写出
+        void function(int funcId, const std::vector<Instruction>& code);
+        // 等待所有数据写出，出错时返回错误信息，这时输出的文件不完整
+        std::optional<std::string> finish();
+
+    private:
+        std::ofstream& _out;
+        ObjectFormat _format;
+        std::vector<funcInfo> _functions;
+
+        std::mutex _mutex;
+        std::condition_variable _ready;
+        // 已编码但前面还有函数没完成的函数体
+        std::map<int, std::pair<std::vector<char>, std::size_t>> _pending;
+        int _nextFunction = 0;
+        // 等待后台线程写出的数据
+        std::deque<std::vector<char>> _queue;
+        bool _closed = false;
+        std::optional<std::string> _error;
+        std::thread _writer;
+
+        // 已交给后台线程的字节数
+        std::size_t _written = 0;
+        // 版本 2 的段表，按 SectionKind 索引，每项为 <offset, size>
+        std::array<std::array<std::uint32_t, 2>, 6> _sections = {};
+        // 版本 2 函数表中的 <code_offset, code_size, instructions_count>
+        std::vector<std::array<std::uint32_t, 3>> _codeEntries;
+        // 版本 2 调试信息段中的行号表，0 为 .start，i + 1 为函数 i，finish 时写在函数表之后
+        std::vector<std::vector<char>> _lines;
+
+        void enqueue(std::vector<char> chunk);
+        void writeLoop();
+    };
+}
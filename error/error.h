@@ -43,7 +43,10 @@ namespace c0 {
         ErrFunctionNotDefined,
         ErrInvalidFunctionCall,
         ErrInvalidReturnValue,
-        ErrNeedReturnValue
+        ErrNeedReturnValue,
+        ErrNeedCaseValue,
+        ErrDuplicateCase,
+        ErrInvalidJump
     };
 
 	class CompilationError final{
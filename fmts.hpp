@@ -96,6 +96,15 @@ namespace fmt {
 			case c0::ErrNeedReturnValue:
 				name = "Non-void function should return a value.";
 				break;
+			case c0::ErrNeedCaseValue:
+				name = "Need an integer or char literal after case.";
+				break;
+			case c0::ErrDuplicateCase:
+				name = "The case value or default has appeared in this switch.";
+				break;
+			case c0::ErrInvalidJump:
+				name = "break must be in a loop or switch, continue must be in a loop.";
+				break;
 			}
 			return format_to(ctx.out(), name);
 		}
@@ -247,6 +256,9 @@ namespace fmt {
 			case c0::COMMA:
 				name = "Comma";
 				break;
+			case c0::COLON:
+				name = "Colon";
+				break;
 			case c0::LEFT_PAREN:
 				name = "LeftParen";
 				break;
@@ -343,6 +355,9 @@ namespace fmt {
                 break;
             case c0::SCN:
                 name = "SCAN";
+                break;
+            case c0::SWT:
+                name = "SWITCH";
                 break;
 			}
 			return format_to(ctx.out(), name);
@@ -440,6 +455,9 @@ namespace fmt {
                 case c0::jle:
                     name = "jle";
                     break;
+                case c0::tableSwitch:
+                    name = "tableswitch";
+                    break;
                 case c0::call:
                     name = "call";
                     break;
@@ -458,6 +476,9 @@ namespace fmt {
                 case c0::sPrint:
                     name = "sprint";
                     break;
+                case c0::fPrint:
+                    name = "fprint";
+                    break;
                 case c0::printL:
                     name = "printl";
                     break;
@@ -480,6 +501,8 @@ namespace fmt {
 		auto format(const c0::Instruction &ins, FormatContext &ctx) {
 			switch (ins.getOpr()) {
                 case c0::loadA:
+                case c0::tableSwitch:
+                case c0::fPrint:
                     return format_to(ctx.out(), "{} {}, {}", ins.getOpr(), ins.getX(), ins.getY());
 
                 case c0::biPush:
@@ -1,10 +1,23 @@
 #include "generator.h"
+#include "parallel.h"
 
 namespace c0 {
+    inline void loadI(std::vector<Instruction>& seq, const std::string& opr);
+
+    // 输出一串 PRT 用到的字符串常量，见 Generator::generatePrint
+    std::optional<std::string> printConstant(const PrintRun& run) {
+        if (run.args.empty())
+            return run.texts[0].empty() || run.texts[0] == "\n" ? std::nullopt : std::make_optional(run.texts[0]);
+        if (run.args.size() == 1 && run.texts[0].empty() && run.texts[1].empty())
+            return {};
+        return formatString(run);
+    }
+
     byteCode Generator::Generate() {
         generate();
 
-        byteCode code(_constants, _start, _functions, _instructions);
+        byteCode code(std::move(_constants), std::move(_start), std::move(_functions), std::move(_instructions));
+        code.quadOffsets = std::move(_quadOffsets);
 
         return code;
     }
@@ -12,21 +25,100 @@ namespace c0 {
     void Generator::generate() {
         preTreat();
 
+        if (_stackTemps)
+            collectCallees();
+
         int i, len = _quads.size();
+        std::size_t functionCount = 0;
+        for (const auto& quad : _quads)
+            functionCount += quad.getOperation() == QuadOpr::FUNC;
+        if (_recordOffsets)
+            _quadOffsets.resize(functionCount + 1);
+        auto offsetsOf = [&](std::size_t k) { return _recordOffsets ? &_quadOffsets[k] : nullptr; };
+
+        LabelTable startLabels;
         for (i = 0; i < len && _quads[i].getOperation() != QuadOpr::FUNC; i++) {
-            generateCode(_start, _quads[i]);
+            if (!_stackTemps) {
+                std::size_t from = _start.size();
+                if (_recordOffsets)
+                    _quadOffsets[0].push_back(from);
+                generateCode(_start, startLabels, _quads[i]);
+                stampLines(_start, from, _quads[i].getLine());
+            }
         }
+        if (_stackTemps)
+            generateStackTemps(_start, startLabels, 0, i, 0, true, offsetsOf(0));
 
+        // 按 FUNC 划分函数体，并按串行生成时的顺序预先分配函数编号和常量，
+        // 之后各函数体的生成只读这两张表，可以并行且结果和串行时一致
+        std::vector<std::pair<int, int>> bodies;
         while (i < len) {
-            int16_t funcId = addFunction(_quads[i++]);
-            _labels.clear();
-            _instructions.emplace_back();
-
+            addFunction(_quads[i++]);
+            int begin = i;
             for (; i < len && _quads[i].getOperation() != QuadOpr::FUNC; i++) {
-                generateCode(_instructions[funcId], _quads[i]);
+                if (_quads[i].getOperation() != QuadOpr::PRT)
+                    continue;
+                if (!_formatPrint) {
+                    if (_quads[i].getY() == "@s")
+                        constString(_quads[i].getX().substr(1));
+                    continue;
+                }
+                auto run = printRun(_quads, i, len);
+                if (run.end == (std::size_t)i)
+                    continue;
+                if (auto constant = printConstant(run))
+                    constString(constant.value());
+                i = (int)run.end - 1;
             }
+            bodies.emplace_back(begin, i);
+        }
 
-            backfillLabel(_instructions[funcId]);
+        _instructions.resize(bodies.size());
+        if (_sink)
+            _sink->begin(_constants, _start, _functions);
+
+        auto generateFunction = [&](std::size_t funcId) {
+            auto& seq = _instructions[funcId];
+            LabelTable labels;
+            int begin = bodies[funcId].first, end = bodies[funcId].second;
+            if (_stackTemps)
+                generateStackTemps(seq, labels, begin, end, _functions[funcId].params_size, false,
+                                   offsetsOf(funcId + 1));
+            else {
+                for (int k = begin; k < end; k++) {
+                    std::size_t from = seq.size();
+                    if (_recordOffsets)
+                        _quadOffsets[funcId + 1].push_back(from);
+                    if (_formatPrint && _quads[k].getOperation() == QuadOpr::PRT) {
+                        auto run = printRun(_quads, k, end);
+                        if (run.end > (std::size_t)k) {
+                            // 合并的各条 PRT 都对应这一组指令
+                            for (std::size_t q = k + 1; q < run.end && _recordOffsets; q++)
+                                _quadOffsets[funcId + 1].push_back(from);
+                            for (const auto& arg : run.args)
+                                loadI(seq, arg.first);
+                            generatePrint(seq, run);
+                            stampLines(seq, from, _quads[k].getLine());
+                            k = (int)run.end - 1;
+                            continue;
+                        }
+                    }
+                    generateCode(seq, labels, _quads[k]);
+                    stampLines(seq, from, _quads[k].getLine());
+                }
+            }
+            labels.backfill(seq);
+            if (_sink) {
+                _sink->function((int)funcId, seq);
+                std::vector<Instruction>().swap(seq);
+            }
+        };
+
+        if (_jobs > 1)
+            parallelFor(bodies.size(), _jobs, generateFunction);
+        else {
+            for (std::size_t funcId = 0; funcId < bodies.size(); funcId++)
+                generateFunction(funcId);
         }
     }
 
@@ -67,7 +159,9 @@ namespace c0 {
         if (pos[0] == 'c') {
             global = 1;
             offset = std::stoi(pos.substr(1));
-        } else
+        } else if (pos[0] == '#')
+            offset = std::stoi(pos.substr(1));
+        else
             offset = std::stoi(pos);
 
         //loada level_diff(2), offset(4)
@@ -83,7 +177,7 @@ namespace c0 {
         }
     }
 
-    inline opCode calOpr(const QuadOpr & opr) {
+    opCode calOpr(const QuadOpr & opr) {
         switch (opr) {
             case ADD:
                 return opCode::iAdd;
@@ -98,7 +192,7 @@ namespace c0 {
         }
     }
 
-    inline opCode relOpr(const QuadOpr & opr, const std::string& rel) {
+    opCode relOpr(const QuadOpr & opr, const std::string& rel) {
         opCode op = opCode::nop;
         switch (opr) {
             case GOTO:
@@ -139,7 +233,7 @@ namespace c0 {
         return op;
     }
 
-    void Generator::generateCode(std::vector<Instruction>& seq, const Quadruple& quad) {
+    void Generator::generateCode(std::vector<Instruction>& seq, LabelTable& labels, const Quadruple& quad) {
         switch (quad.getOperation()) {
             // a = t    ASN t	-	a
             case QuadOpr::ASN:
@@ -167,7 +261,7 @@ namespace c0 {
                 break;
 
             case QuadOpr::LAB:
-                setLabel(quad.getX(), seq.size());
+                labels.setLabel(quad.getX(), seq.size());
                 break;
             case QuadOpr::FUNC:
                 // wont happen
@@ -215,8 +309,17 @@ namespace c0 {
             case QuadOpr::GOTO:
             case QuadOpr::BNZ:
             case QuadOpr::BZ:
-                seq.emplace_back(relOpr(quad.getOperation(), quad.getY()), std::stoi(quad.getX().substr(1)));
+                labels.addJump(seq, relOpr(quad.getOperation(), quad.getY()), quad.getX());
                 break;
+            // 跳转表		SWT		a		$low	L0,...,Ln-1,Ldefault
+            case QuadOpr::SWT: {
+                auto targets = switchLabels(quad.getR());
+                loadI(seq, quad.getX());
+                seq.emplace_back(opCode::tableSwitch, std::stoi(quad.getY().substr(1)), (int)targets.size() - 1);
+                for (const auto& target : targets)
+                    labels.addJump(seq, opCode::jmp, target);
+                break;
+            }
 
             //print(a)	PRT 	a 		i/c/s/ln
             case QuadOpr::PRT:
@@ -241,52 +344,86 @@ namespace c0 {
         }
     }
 
-    void Generator::backfillLabel(std::vector<Instruction>& insSeq) {
-        for (Instruction& i : insSeq) {
-            switch (i.getOpr()) {
-                case opCode::jmp:
-                case opCode::je:	case opCode::jne:
-                case opCode::jl:	case opCode::jge:
-                case opCode::jg:	case opCode::jle:
-                    i.setX(_labels[i.getX()]);
-                    break;
-                default:
-                    break;
-            }
+    // 没有参数时输出字符串常量，只有一个整数时用 iprint，否则用 fprint
+    void Generator::generatePrint(std::vector<Instruction>& seq, const PrintRun& run) {
+        auto constant = printConstant(run);
+        if (!run.args.empty()) {
+            if (constant.has_value())
+                seq.emplace_back(opCode::fPrint, constString(constant.value()), (int)run.args.size());
+            else
+                seq.emplace_back(opCode::iPrint);
+        } else if (constant.has_value()) {
+            seq.emplace_back(opCode::loadC, constString(constant.value()));
+            seq.emplace_back(opCode::sPrint);
+        } else if (run.texts[0] == "\n")
+            seq.emplace_back(opCode::printL);
+    }
+
+    void stampLines(std::vector<Instruction>& seq, std::size_t from, std::uint32_t line) {
+        for (std::size_t i = from; i < seq.size(); i++) {
+            if (seq[i].getLine() == 0)
+                seq[i].setLine(line);
         }
     }
 
     int Generator::addFunction(const Quadruple& quad) {
         // FUNC 	name	para_size	level
-        int16_t name = constString(quad.getX().substr(1));
+        int32_t name = constString(quad.getX().substr(1));
         int16_t size = std::stoi(quad.getY().substr(1));
         int16_t level = std::stoi(quad.getR().substr(1));
 
         _functions.emplace_back(name, size, level);
+        _functionIndex[quad.getX().substr(1)] = (int)_functions.size() - 1;
         return (int)_functions.size() - 1;
     }
 
+    // 生成函数体时常量都已预先加入，并行生成时这里只会读
     int Generator::constString(const std::string & s) {
-        int i;
-        for (i = 0; i < (int)_constants.size(); i++) {
-            if (_constants[i].second == s)
-                return i;
-        }
+        auto it = _constantIndex.find(s);
+        if (it != _constantIndex.end())
+            return it->second;
+        int i = (int)_constants.size();
         _constants.emplace_back('S', s);
+        _constantIndex.emplace(s, i);
         return i;
     }
 
     int Generator::getFuncId(const std::string & s) {
-        int name = constString(s);
-        for (int i = 0; i < (int)_functions.size(); i++) {
-            if (_functions[i].name_index == name)
-                return i;
-        }
+        auto it = _functionIndex.find(s);
+        if (it != _functionIndex.end())
+            return it->second;
         return -1;
     }
 
-    void Generator::setLabel(const std::string & label, int pos) {
-        _labels[std::stoi(label.substr(1))] = pos;
-   }
+    int& LabelTable::slot(int id) {
+        if (_labels.empty())
+            _base = id;
+        if (id < _base) {
+            _labels.insert(_labels.begin(), _base - id, 0);
+            _base = id;
+        }
+        if (id - _base >= (int)_labels.size())
+            _labels.resize(id - _base + 1, 0);
+        return _labels[id - _base];
+    }
+
+    void LabelTable::setLabel(const std::string & label, int pos) {
+        slot(std::stoi(label.substr(1))) = pos;
+    }
+
+    void LabelTable::addJump(std::vector<Instruction>& seq, opCode op, const std::string & label) {
+        int id = std::stoi(label.substr(1));
+        slot(id);
+        _fixups.push_back(seq.size());
+        seq.emplace_back(op, id);
+    }
+
+    void LabelTable::backfill(std::vector<Instruction>& seq) {
+        for (auto pos : _fixups) {
+            Instruction& i = seq[pos];
+            i.setX(_labels[i.getX() - _base]);
+        }
+        _fixups.clear();
+    }
 
-}
\ No newline at end of file
+}
@@ -9,20 +9,31 @@
 #include <optional>
 #include <utility>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <cstdint>
 #include <cstddef> // for std::size_t
 
 namespace c0 {
     class funcInfo {
     public:
-        std::int16_t name_index;
+        std::int32_t name_index;
         std::int16_t params_size;
         std::int16_t level;
 
-        funcInfo(int16_t name, int16_t size, int16_t level)
+        funcInfo(int32_t name, int16_t size, int16_t level)
             : name_index(name), params_size(size), level(level) {}
     };
 
+    // 一段指令序列执行时从 fp 开始使用的栈槽数，见 vm/stack_depth.h 中的 frameSizes
+    class frameInfo {
+    public:
+        // 参数、局部变量和操作栈合计的最大深度，分配这么多槽之后执行时不会越界
+        std::int32_t max_stack;
+        // 参数和 loada 0, n 访问的局部变量占用的槽数
+        std::int32_t locals;
+    };
+
     class byteCode {
     public:
         byteCode(std::vector<std::pair<char, std::string>> constants,
@@ -31,13 +42,59 @@ namespace c0 {
                  std::vector<std::vector<Instruction>> instructions)
                   : constants(std::move(constants)), start(std::move(start)),
                     functions(std::move(functions)), instructions(std::move(instructions)) {}
+        // 只能移动，避免在编译阶段之间整体复制
+        byteCode(byteCode&&) = default;
+        byteCode(const byteCode&) = delete;
+        byteCode& operator=(byteCode&&) = default;
+        byteCode& operator=(const byteCode&) = delete;
 
         std::vector<std::pair<char, std::string>> constants;
         std::vector<Instruction> start;
         std::vector<funcInfo> functions;
         std::vector<std::vector<Instruction>> instructions;
+        // 只在 Generator::setQuadOffsets 时记录：quadOffsets[0] 为 .start，quadOffsets[i + 1] 为函数 i，
+        // 其中第 k 项为函数体第 k 条四元式（不含 FUNC）生成的第一条指令的下标，没有生成指令时为下一条指令的下标
+        std::vector<std::vector<std::uint32_t>> quadOffsets;
+    };
+
+    // 一个函数内的标号表
+    // 标号由 Analyser 在整个程序内顺序编号，一个函数用到的标号是连续的一段，只为这一段分配空间
+    class LabelTable final {
+    public:
+        void setLabel(const std::string&, int pos);
+        // 生成跳转到 label 的指令，在 backfill 时回填
+        void addJump(std::vector<Instruction>&, opCode, const std::string& label);
+        void backfill(std::vector<Instruction>&);
+
+    private:
+        int _base = 0;
+        std::vector<int> _labels;
+        // 需要回填的跳转指令
+        std::vector<std::size_t> _fixups;
+
+        int& slot(int id);
+    };
+
+    // 接收 Generator 生成结果的流式接口
+    // 设置后每个函数体生成完就交给 function，之后 Generator 不再保留它，Generate 返回的 instructions 为空
+    class GeneratorSink {
+    public:
+        virtual ~GeneratorSink() = default;
+
+        // 在生成任何函数体之前调用，此时常量表和函数表都已确定
+        virtual void begin(const std::vector<std::pair<char, std::string>>& constants,
+                           std::vector<Instruction>& start, const std::vector<funcInfo>& functions) = 0;
+        // 并行生成时会在多个线程中以任意顺序调用
+        virtual void function(int funcId, std::vector<Instruction>& code) = 0;
     };
 
+    // ADD/SUB/MUL/DIV 对应的运算指令
+    opCode calOpr(const QuadOpr&);
+    // GOTO/BNZ/BZ 及其比较关系对应的跳转指令
+    opCode relOpr(const QuadOpr&, const std::string& rel);
+    // seq[from...] 中还没有行号的指令取四元式的行号
+    void stampLines(std::vector<Instruction>& seq, std::size_t from, std::uint32_t line);
+
 	class Generator final {
     private:
         using uint32_t = std::uint32_t;
@@ -46,18 +103,36 @@ namespace c0 {
         using int16_t = std::int16_t;
 
 	public:
-		Generator(std::vector<Quadruple> q)
-		    : _quads(std::move(q)), _constants({}), _start({}), _functions({}), _instructions({}) {}
+		// stackTemps: 只被下一条四元式使用一次的临时变量留在操作栈上，不分配栈帧
+		// jobs: 并行生成函数体的线程数，为 1 时串行生成
+		Generator(std::vector<Quadruple> q, bool stackTemps = false, unsigned jobs = 1)
+		    : _quads(std::move(q)), _stackTemps(stackTemps), _jobs(jobs),
+		      _constants({}), _start({}), _functions({}), _instructions({}) {}
 		Generator(Generator&&) = delete;
 		Generator(const Generator&) = delete;
 		Generator& operator=(Generator) = delete;
 
-		// 唯一接口
+		// 唯一接口，只能调用一次，结果从 Generator 中移出
         byteCode Generate();
+        // 流式输出，见 GeneratorSink
+        void setSink(GeneratorSink* sink) { _sink = sink; }
+        // 记录每条四元式对应的指令，见 byteCode::quadOffsets，用于 --profile-generate
+        void setQuadOffsets(bool record) { _recordOffsets = record; }
+        // 把连续的 PRT 合成一条 fprint（扩展指令，见 refer/instruction.txt），关闭时只使用标准指令
+        void setFormatPrint(bool merge) { _formatPrint = merge; }
 
     private:
         std::vector<Quadruple> _quads;
-        std::map<int, int> _labels;
+        bool _stackTemps;
+        unsigned _jobs;
+        GeneratorSink* _sink = nullptr;
+        bool _recordOffsets = false;
+        bool _formatPrint = false;
+        std::vector<std::vector<std::uint32_t>> _quadOffsets;
+        // 常量 -> 常量表下标
+        std::unordered_map<std::string, int> _constantIndex;
+        // 函数名 -> 函数表下标
+        std::unordered_map<std::string, int> _functionIndex;
 
 	    std::vector<std::pair<char, std::string>> _constants;
 	    std::vector<Instruction> _start;
@@ -71,11 +146,20 @@ namespace c0 {
 	    int constString(const std::string&);
 
 	    void preTreat();
-	    void generateCode(std::vector<Instruction>&, const Quadruple&);
+	    void generateCode(std::vector<Instruction>&, LabelTable&, const Quadruple&);
+	    // 一串 PRT 的参数已经依次压入，生成输出它们的指令
+	    void generatePrint(std::vector<Instruction>&, const PrintRun&);
+
+	    // stack temps 模式，见 stack_temps.cpp
+	    // 函数名 -> <参数大小, 是否有返回值>
+	    std::map<std::string, std::pair<int, bool>> _callees;
+	    // 全局变量在 .start 中的实际栈偏移
+	    std::vector<int> _globalSlots;
+	    void collectCallees();
+	    // offsets 不为空时记录每条四元式生成的第一条指令的下标
+	    void generateStackTemps(std::vector<Instruction>&, LabelTable&, std::size_t begin, std::size_t end,
+	                            int paraSize, bool isStart, std::vector<std::uint32_t>* offsets);
 //	    void getAddr(std::vector<Instruction>&, const std::string&);
 //	    void loadI(std::vector<Instruction>&, const std::string&);
-
-	    void setLabel(const std::string&, int);
-	    void backfillLabel(std::vector<Instruction>&);
 	};
 }
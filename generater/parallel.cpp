@@ -0,0 +1,87 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace c0 {
+    // 一个线程待处理的下标 [begin, end)，自己从队头取，其它线程从队尾偷
+    class WorkRange {
+    public:
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+
+        bool pop(std::size_t& index) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (begin == end)
+                return false;
+            index = begin++;
+            return true;
+        }
+
+        // 偷走后一半（向上取整），返回偷到的区间
+        bool steal(std::size_t& stolenBegin, std::size_t& stolenEnd) {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::size_t size = end - begin;
+            if (size == 0)
+                return false;
+            stolenEnd = end;
+            stolenBegin = end = end - (size + 1) / 2;
+            return true;
+        }
+    };
+
+    void parallelFor(std::size_t n, unsigned jobs, const std::function<void(std::size_t)>& fn) {
+        jobs = (unsigned)std::min<std::size_t>(std::max(jobs, 1u), std::max<std::size_t>(n, 1));
+        std::vector<WorkRange> ranges(jobs);
+        for (unsigned w = 0; w < jobs; w++) {
+            ranges[w].begin = n * w / jobs;
+            ranges[w].end = n * (w + 1) / jobs;
+        }
+
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        auto worker = [&](unsigned self) {
+            std::size_t index;
+            while (true) {
+                while (ranges[self].pop(index)) {
+                    try {
+                        fn(index);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+
+                bool stolen = false;
+                for (unsigned k = 1; k < jobs && !stolen; k++) {
+                    std::size_t begin, end;
+                    if (ranges[(self + k) % jobs].steal(begin, end)) {
+                        std::lock_guard<std::mutex> lock(ranges[self].mutex);
+                        ranges[self].begin = begin;
+                        ranges[self].end = end;
+                        stolen = true;
+                    }
+                }
+                // 窃取失败说明所有下标都已被取走
+                if (!stolen)
+                    return;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < jobs; w++)
+            threads.emplace_back(worker, w);
+        worker(0);
+        for (auto& thread : threads)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
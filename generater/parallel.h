@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace c0 {
+    // 用 jobs 个线程对 [0, n) 中的每个下标调用一次 fn
+    // 每个线程先处理自己的一段下标，做完后从其它线程的队尾窃取一半，
+    // 函数体大小相差很大时也能保持各线程负载均衡
+    // fn 抛出的第一个异常会在所有线程结束后重新抛出
+    void parallelFor(std::size_t n, unsigned jobs, const std::function<void(std::size_t)>& fn);
+}
@@ -0,0 +1,524 @@
+#include "generator.h"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+/*
+ * stack temps 模式
+ *
+ * 默认的代码生成把每个临时变量都放在栈帧里：
+ *     PUSH $0; ADD a b #t; ASN #t - x
+ *     => ipush 0; loada t; <a>; <b>; iadd; istore; loada x; loada t; iload; istore
+ * 如果 #t 的值只被之后的一条四元式使用一次，就把计算它的指令推迟到使用处展开，
+ * 值直接留在操作栈上：
+ *     => loada x; <a>; <b>; iadd; istore
+ * 一个临时变量的所有定值都这样处理时，连同它的 PUSH $0 一起去掉，
+ * 之后的栈偏移和 POP 的数量相应减少。
+ *
+ * 只有纯运算（ASN/NEG/ADD/SUB/MUL/DIV 写临时变量）会被推迟，它们不读写变量以外的状态，
+ * 所以推迟到同一基本块内的使用处求值不改变语义。
+ */
+
+namespace c0 {
+    inline bool isTemp(const std::string& opr) {
+        return !opr.empty() && opr[0] == '#';
+    }
+
+    inline int tempSlot(const std::string& opr) {
+        return std::stoi(opr.substr(1));
+    }
+
+    inline bool isPureDef(const Quadruple& quad) {
+        switch (quad.getOperation()) {
+            case QuadOpr::ASN:
+            case QuadOpr::NEG:
+            case QuadOpr::ADD:
+            case QuadOpr::SUB:
+            case QuadOpr::MUL:
+            case QuadOpr::DIV:
+                return isTemp(quad.getR());
+            default:
+                return false;
+        }
+    }
+
+    // 四元式读取的操作数，按求值顺序
+    std::vector<std::string> readOperands(const Quadruple& quad) {
+        switch (quad.getOperation()) {
+            case QuadOpr::ASN:
+            case QuadOpr::NEG:
+            case QuadOpr::PUSH:
+            case QuadOpr::SWT:
+                return { quad.getX() };
+            case QuadOpr::ADD:
+            case QuadOpr::SUB:
+            case QuadOpr::MUL:
+            case QuadOpr::DIV:
+            case QuadOpr::EQU:
+            case QuadOpr::NE:
+            case QuadOpr::LT:
+            case QuadOpr::LE:
+            case QuadOpr::GT:
+            case QuadOpr::GE:
+                return { quad.getX(), quad.getY() };
+            case QuadOpr::RET:
+                if (quad.getX().empty())
+                    return {};
+                return { quad.getX() };
+            case QuadOpr::PRT:
+                if (quad.getY() == "@i" || quad.getY() == "@c")
+                    return { quad.getX() };
+                return {};
+            default:
+                return {};
+        }
+    }
+
+    class TempPlan {
+    public:
+        // 被推迟到哪一条四元式求值，-1 表示照常写回栈帧
+        std::vector<int> absorbedInto;
+        // 创建临时变量的 PUSH $0 所创建的栈偏移，其它四元式为 -1
+        std::vector<int> creates;
+        // 该临时变量的 PUSH $0 是否被去掉
+        std::vector<bool> elided;
+        // 标号处每个栈偏移是否实际分配，沿控制流求出
+        // pass 重新布局基本块后，标号之前的四元式不一定会执行到标号，不能沿用顺序执行到这里的状态
+        std::unordered_map<std::string, std::vector<bool>> labelSlots;
+    };
+
+    // 沿控制流求出每个标号处的 TempPlan::labelSlots，和 generateStackTemps 中 slots 的变化一致
+    void planLabelSlots(TempPlan& plan, const std::vector<Quadruple>& quads, std::size_t begin, std::size_t end,
+                        int paraSize, const std::map<std::string, std::pair<int, bool>>& callees) {
+        std::unordered_map<std::string, std::size_t> labelAt;
+        for (std::size_t q = 0; q < end - begin; q++) {
+            if (quads[begin + q].getOperation() == QuadOpr::LAB)
+                labelAt[quads[begin + q].getX()] = q;
+        }
+
+        std::vector<std::pair<std::size_t, std::vector<bool>>> work;
+        work.emplace_back(0, std::vector<bool>(paraSize, true));
+        auto reach = [&](const std::string& label, const std::vector<bool>& slots) {
+            auto at = labelAt.find(label);
+            if (at != labelAt.end() && plan.labelSlots.emplace(label, slots).second)
+                work.emplace_back(at->second + 1, slots);
+        };
+        while (!work.empty()) {
+            auto q = work.back().first;
+            auto slots = std::move(work.back().second);
+            work.pop_back();
+            for (bool next = true; next && q < end - begin; q++) {
+                const auto& quad = quads[begin + q];
+                switch (quad.getOperation()) {
+                    case QuadOpr::PUSH:
+                        slots.push_back(plan.creates[q] < 0 || !plan.elided[q]);
+                        break;
+                    case QuadOpr::POP:
+                        slots.resize(std::max(0, (int)slots.size() - std::stoi(quad.getX().substr(1))));
+                        break;
+                    case QuadOpr::CAL: {
+                        auto it = callees.find(quad.getX());
+                        if (it != callees.end()) {
+                            slots.resize(std::max(0, (int)slots.size() - it->second.first));
+                            if (it->second.second)
+                                slots.push_back(true);
+                        }
+                        break;
+                    }
+                    case QuadOpr::LAB:
+                        // 已经从别处到达过的标号不再重复
+                        next = plan.labelSlots.emplace(quad.getX(), slots).second;
+                        break;
+                    case QuadOpr::GOTO:
+                        reach(quad.getX(), slots);
+                        next = false;
+                        break;
+                    case QuadOpr::BZ:
+                    case QuadOpr::BNZ:
+                        reach(quad.getX(), slots);
+                        break;
+                    case QuadOpr::SWT:
+                        for (const auto& target : switchLabels(quad.getR()))
+                            reach(target, slots);
+                        next = false;
+                        break;
+                    case QuadOpr::RET:
+                        next = false;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    TempPlan planTemps(const std::vector<Quadruple>& quads, std::size_t begin, std::size_t end, int paraSize,
+                       const std::map<std::string, std::pair<int, bool>>& callees) {
+        std::size_t n = end - begin;
+        TempPlan plan;
+        plan.absorbedInto.assign(n, -1);
+        plan.creates.assign(n, -1);
+        plan.elided.assign(n, false);
+
+        // 栈深度，和 Analyser 中的 _nextStackIndex 一致
+        std::vector<int> depth(n + 1, 0);
+        std::vector<int> callResult(n, -1);
+        int d = paraSize;
+        for (std::size_t q = 0; q < n; q++) {
+            const auto& quad = quads[begin + q];
+            depth[q] = d;
+            switch (quad.getOperation()) {
+                case QuadOpr::PUSH:
+                    if (quad.getX() == "$0" && q + 1 < n && isPureDef(quads[begin + q + 1])
+                        && tempSlot(quads[begin + q + 1].getR()) == d)
+                        plan.creates[q] = d;
+                    d++;
+                    break;
+                case QuadOpr::POP:
+                    d -= std::stoi(quad.getX().substr(1));
+                    break;
+                case QuadOpr::CAL: {
+                    auto it = callees.find(quad.getX());
+                    if (it != callees.end()) {
+                        d -= it->second.first;
+                        if (it->second.second)
+                            callResult[q] = d++;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        depth[n] = d;
+
+        // 每个临时变量的使用之后是否还会被使用
+        std::vector<std::array<bool, 2>> liveAfter(n, {false, false});
+        std::unordered_map<int, bool> live;
+        for (std::size_t q = n; q-- > 0;) {
+            const auto& quad = quads[begin + q];
+            if (isPureDef(quad))
+                live[tempSlot(quad.getR())] = false;
+            if (callResult[q] >= 0)
+                live[callResult[q]] = false;
+
+            auto operands = readOperands(quad);
+            for (std::size_t k = 0; k < operands.size(); k++) {
+                if (isTemp(operands[k]))
+                    liveAfter[q][k] = live[tempSlot(operands[k])];
+            }
+            for (const auto& opr : operands) {
+                if (isTemp(opr))
+                    live[tempSlot(opr)] = true;
+            }
+        }
+
+        // 模拟一遍，决定哪些定值可以推迟
+        std::vector<int> pending;
+        std::unordered_map<int, int> lastDef;
+        for (std::size_t q = 0; q < n; q++) {
+            const auto& quad = quads[begin + q];
+            if (plan.creates[q] >= 0)
+                continue;
+
+            auto operands = readOperands(quad);
+            bool repeated = operands.size() == 2 && operands[0] == operands[1];
+            for (std::size_t k = 0; k < operands.size(); k++) {
+                if (!isTemp(operands[k]) || repeated || liveAfter[q][k])
+                    continue;
+                auto def = lastDef.find(tempSlot(operands[k]));
+                if (def == lastDef.end())
+                    continue;
+                for (auto it = pending.begin(); it != pending.end(); it++) {
+                    if (*it == def->second) {
+                        plan.absorbedInto[def->second] = (int)q;
+                        pending.erase(it);
+                        break;
+                    }
+                }
+            }
+
+            if (isPureDef(quad)) {
+                // 推迟的定值不能读到之后被改写的临时变量
+                for (auto it = pending.begin(); it != pending.end();) {
+                    const auto& def = quads[begin + *it];
+                    auto reads = readOperands(def);
+                    bool conflict = def.getR() == quad.getR();
+                    for (const auto& opr : reads)
+                        conflict = conflict || opr == quad.getR();
+                    it = conflict ? pending.erase(it) : it + 1;
+                }
+                pending.push_back((int)q);
+                lastDef[tempSlot(quad.getR())] = (int)q;
+            } else if (quad.getOperation() != QuadOpr::PUSH) {
+                // 其它四元式可能改变变量的值或控制流，推迟的定值不能越过它们
+                pending.clear();
+            }
+            if (callResult[q] >= 0)
+                lastDef.erase(callResult[q]);
+        }
+
+        // 临时变量的所有定值都被推迟时去掉它的栈帧
+        for (std::size_t q = 0; q < n; q++) {
+            int slot = plan.creates[q];
+            if (slot < 0)
+                continue;
+            bool allAbsorbed = true;
+            for (std::size_t r = q + 1; r < n && depth[r] > slot; r++) {
+                if (plan.creates[r] == slot)
+                    break;
+                const auto& quad = quads[begin + r];
+                if (isPureDef(quad) && tempSlot(quad.getR()) == slot && plan.absorbedInto[r] < 0) {
+                    allAbsorbed = false;
+                    break;
+                }
+            }
+            plan.elided[q] = allAbsorbed;
+        }
+
+        planLabelSlots(plan, quads, begin, end, paraSize, callees);
+        return plan;
+    }
+
+    void Generator::collectCallees() {
+        std::string name;
+        for (const auto& quad : _quads) {
+            if (quad.getOperation() == QuadOpr::FUNC) {
+                name = quad.getX();
+                _callees[name] = std::make_pair(std::stoi(quad.getY().substr(1)), false);
+            } else if (quad.getOperation() == QuadOpr::RET && !quad.getX().empty() && !name.empty())
+                _callees[name].second = true;
+        }
+    }
+
+    void Generator::generateStackTemps(std::vector<Instruction>& seq, LabelTable& labels, std::size_t begin,
+                                       std::size_t end, int paraSize, bool isStart,
+                                       std::vector<std::uint32_t>* offsets) {
+        auto plan = planTemps(_quads, begin, end, paraSize, _callees);
+
+        // Analyser 的栈偏移 -> 实际栈偏移
+        std::vector<int> slots;
+        int used = 0;
+        auto pushSlot = [&](bool materialized) {
+            slots.push_back(materialized ? used++ : -1);
+        };
+        auto popSlots = [&](int count) {
+            int materialized = 0;
+            for (; count > 0 && !slots.empty(); count--) {
+                if (slots.back() >= 0) {
+                    materialized++;
+                    used--;
+                }
+                slots.pop_back();
+            }
+            return materialized;
+        };
+        auto localSlot = [&](int index) {
+            if (index < (int)slots.size() && slots[index] >= 0)
+                return slots[index];
+            return used + index - (int)slots.size();
+        };
+        auto globalSlot = [&](int index) {
+            if (index < (int)_globalSlots.size() && _globalSlots[index] >= 0)
+                return _globalSlots[index];
+            return index;
+        };
+
+        for (int i = 0; i < paraSize; i++)
+            pushSlot(true);
+
+        std::unordered_map<int, int> lastDef;
+        std::unordered_map<int, std::vector<Instruction>> deferred;
+
+        auto addr = [&](std::vector<Instruction>& out, const std::string& pos) {
+            if (pos[0] == 'c')
+                out.emplace_back(opCode::loadA, 1, globalSlot(std::stoi(pos.substr(1))));
+            else if (pos[0] == '#')
+                out.emplace_back(opCode::loadA, 0, localSlot(tempSlot(pos)));
+            else
+                out.emplace_back(opCode::loadA, 0, localSlot(std::stoi(pos)));
+        };
+        auto load = [&](std::vector<Instruction>& out, int q, const std::string& opr) {
+            if (opr[0] == '$') {
+                out.emplace_back(opCode::iPush, std::stoi(opr.substr(1)));
+                return;
+            }
+            if (isTemp(opr)) {
+                auto def = lastDef.find(tempSlot(opr));
+                if (def != lastDef.end() && plan.absorbedInto[def->second] == q) {
+                    auto& code = deferred[def->second];
+                    out.insert(out.end(), code.begin(), code.end());
+                    deferred.erase(def->second);
+                    return;
+                }
+            }
+            addr(out, opr);
+            out.emplace_back(opCode::iLoad);
+        };
+
+        for (std::size_t i = begin; i < end; i++) {
+            const auto& quad = _quads[i];
+            int q = (int)(i - begin);
+            // 吸收进来的定义已经带有自己的行号
+            std::size_t from = seq.size();
+            if (offsets)
+                offsets->push_back(from);
+
+            if (isPureDef(quad)) {
+                std::vector<Instruction> code;
+                load(code, q, quad.getX());
+                if (quad.getOperation() == QuadOpr::NEG)
+                    code.emplace_back(opCode::iNeg);
+                else if (quad.getOperation() != QuadOpr::ASN) {
+                    load(code, q, quad.getY());
+                    code.emplace_back(calOpr(quad.getOperation()));
+                }
+                stampLines(code, 0, quad.getLine());
+
+                lastDef[tempSlot(quad.getR())] = q;
+                if (plan.absorbedInto[q] >= 0)
+                    deferred[q] = std::move(code);
+                else {
+                    addr(seq, quad.getR());
+                    seq.insert(seq.end(), code.begin(), code.end());
+                    seq.emplace_back(opCode::iStore);
+                    stampLines(seq, from, quad.getLine());
+                }
+                continue;
+            }
+
+            switch (quad.getOperation()) {
+                case QuadOpr::ASN:
+                case QuadOpr::NEG:
+                case QuadOpr::ADD:
+                case QuadOpr::SUB:
+                case QuadOpr::MUL:
+                case QuadOpr::DIV:
+                    addr(seq, quad.getR());
+                    load(seq, q, quad.getX());
+                    if (quad.getOperation() == QuadOpr::NEG)
+                        seq.emplace_back(opCode::iNeg);
+                    else if (quad.getOperation() != QuadOpr::ASN) {
+                        load(seq, q, quad.getY());
+                        seq.emplace_back(calOpr(quad.getOperation()));
+                    }
+                    seq.emplace_back(opCode::iStore);
+                    break;
+
+                case QuadOpr::LAB: {
+                    labels.setLabel(quad.getX(), seq.size());
+                    auto it = plan.labelSlots.find(quad.getX());
+                    if (it != plan.labelSlots.end()) {
+                        slots.clear();
+                        used = 0;
+                        for (bool materialized : it->second)
+                            pushSlot(materialized);
+                    }
+                    break;
+                }
+                case QuadOpr::FUNC:
+                    break;
+
+                case QuadOpr::PUSH:
+                    if (plan.creates[q] >= 0 && plan.elided[q]) {
+                        pushSlot(false);
+                        break;
+                    }
+                    load(seq, q, quad.getX());
+                    pushSlot(true);
+                    break;
+                case QuadOpr::POP:
+                    seq.emplace_back(opCode::popN, popSlots(std::stoi(quad.getX().substr(1))));
+                    break;
+                case QuadOpr::CAL: {
+                    seq.emplace_back(opCode::call, getFuncId(quad.getX().substr(1)));
+                    auto it = _callees.find(quad.getX());
+                    if (it != _callees.end()) {
+                        popSlots(it->second.first);
+                        if (it->second.second) {
+                            pushSlot(true);
+                            lastDef.erase((int)slots.size() - 1);
+                        }
+                    }
+                    break;
+                }
+                case QuadOpr::RET:
+                    if (quad.getX().empty())
+                        seq.emplace_back(opCode::ret);
+                    else {
+                        load(seq, q, quad.getX());
+                        seq.emplace_back(opCode::iRet);
+                    }
+                    break;
+
+                case QuadOpr::EQU:
+                case QuadOpr::NE:
+                case QuadOpr::LT:
+                case QuadOpr::LE:
+                case QuadOpr::GT:
+                case QuadOpr::GE:
+                    load(seq, q, quad.getX());
+                    load(seq, q, quad.getY());
+                    seq.emplace_back(opCode::iCmp);
+                    break;
+
+                case QuadOpr::GOTO:
+                case QuadOpr::BNZ:
+                case QuadOpr::BZ:
+                    labels.addJump(seq, relOpr(quad.getOperation(), quad.getY()), quad.getX());
+                    break;
+                case QuadOpr::SWT: {
+                    auto targets = switchLabels(quad.getR());
+                    load(seq, q, quad.getX());
+                    seq.emplace_back(opCode::tableSwitch, std::stoi(quad.getY().substr(1)), (int)targets.size() - 1);
+                    for (const auto& target : targets)
+                        labels.addJump(seq, opCode::jmp, target);
+                    break;
+                }
+
+                case QuadOpr::PRT: {
+                    if (!_formatPrint) {
+                        if (quad.getY() == "@i") {
+                            load(seq, q, quad.getX());
+                            seq.emplace_back(opCode::iPrint);
+                        } else if (quad.getY() == "@c") {
+                            load(seq, q, quad.getX());
+                            seq.emplace_back(opCode::cPrint);
+                        } else if (quad.getY() == "@s") {
+                            seq.emplace_back(opCode::loadC, constString(quad.getX().substr(1)));
+                            seq.emplace_back(opCode::sPrint);
+                        } else if (quad.getY() == "@ln")
+                            seq.emplace_back(opCode::printL);
+                        break;
+                    }
+                    auto run = printRun(_quads, i, end);
+                    // 合并不了的只有运行时才知道的字符
+                    if (run.end == i) {
+                        load(seq, q, quad.getX());
+                        seq.emplace_back(opCode::cPrint);
+                        break;
+                    }
+                    for (const auto& arg : run.args)
+                        load(seq, (int)(arg.second - begin), arg.first);
+                    generatePrint(seq, run);
+                    // 合并的各条 PRT 都对应这一组指令
+                    for (; i + 1 < run.end; i++) {
+                        if (offsets)
+                            offsets->push_back(from);
+                    }
+                    break;
+                }
+                case QuadOpr::SCN:
+                    addr(seq, quad.getX());
+                    seq.emplace_back(opCode::iScan);
+                    seq.emplace_back(opCode::iStore);
+                    break;
+            }
+            stampLines(seq, from, quad.getLine());
+        }
+
+        if (isStart)
+            _globalSlots = slots;
+    }
+}
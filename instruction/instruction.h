@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <utility>
 
@@ -29,17 +30,54 @@ namespace c0 {
         jge = 0x74,
         jg = 0x75,
         jle = 0x76,
+        // tableswitch low, n：弹出 v，之后紧跟 n + 1 条 jmp，
+        // 0 <= v - low < n 时执行第 v - low 条，否则执行最后一条
+        tableSwitch = 0x78,
         call = 0x80,
         ret = 0x88,
         iRet = 0x89,
         iPrint = 0xa0,
         cPrint = 0xa2,
         sPrint = 0xa3,
+        // fprint c, n：弹出 n 个值，输出常量 c，其中的 %d 依次换成这些值（先压入的在前），%% 输出 %
+        fPrint = 0xa4,
         printL = 0xaf,
         iScan = 0xb0,
         cScan = 0xb2,
 	};
 	
+    // 指令操作数在目标文件中的字节数，没有的操作数为 0
+    class OperandWidth {
+    public:
+        u1 x;
+        u1 y;
+
+        constexpr int size() const { return x + y; }
+    };
+
+    constexpr std::array<OperandWidth, 256> makeOperandWidths() {
+        std::array<OperandWidth, 256> widths = {};
+        widths[opCode::biPush] = {1, 0};
+        widths[opCode::iPush] = {4, 0};
+        widths[opCode::popN] = {4, 0};
+        widths[opCode::loadC] = {2, 0};
+        widths[opCode::loadA] = {2, 4};
+        widths[opCode::jmp] = {2, 0};
+        widths[opCode::je] = {2, 0};
+        widths[opCode::jne] = {2, 0};
+        widths[opCode::jl] = {2, 0};
+        widths[opCode::jge] = {2, 0};
+        widths[opCode::jg] = {2, 0};
+        widths[opCode::jle] = {2, 0};
+        widths[opCode::tableSwitch] = {4, 2};
+        widths[opCode::call] = {2, 0};
+        widths[opCode::fPrint] = {2, 2};
+        return widths;
+    }
+
+    // 以 opCode 为下标
+    inline constexpr std::array<OperandWidth, 256> operandWidths = makeOperandWidths();
+
 	class Instruction final {
 	public:
 		friend void swap(Instruction& lhs, Instruction& rhs);
@@ -51,8 +89,8 @@ namespace c0 {
         Instruction(opCode opr, int x, int y) : _opr(opr), _x(x), _y(y) {}
 
 		Instruction() : Instruction(opCode::nop){}
-		Instruction(const Instruction& i) { _opr = i._opr; _x = i._x; _y = i._y;}
-		Instruction(Instruction&& i) : Instruction() { swap(*this, i); }
+		Instruction(const Instruction& i) { _opr = i._opr; _x = i._x; _y = i._y; _line = i._line;}
+		Instruction(Instruction&& i) noexcept : Instruction() { swap(*this, i); }
 		Instruction& operator=(Instruction i) { swap(*this, i); return *this; }
 		bool operator==(const Instruction& i) const { return _opr == i._opr && _x == i._x; }
 
@@ -63,10 +101,14 @@ namespace c0 {
         void setOpr(opCode opr) {_opr = opr;}
         void setX(int x) {_x = x;}
         void setY(int y) {_y = y;}
+        // 源代码行号，只用于调试信息，0 表示和前一条指令相同
+        std::uint32_t getLine() const {return _line;}
+        void setLine(std::uint32_t line) {_line = line;}
 
     private:
 		opCode _opr;
 		int _x, _y;
+		std::uint32_t _line = 0;
 	};
 
 	inline void swap(Instruction& lhs, Instruction& rhs) {
@@ -74,5 +116,6 @@ namespace c0 {
 		swap(lhs._opr, rhs._opr);
 		swap(lhs._x, rhs._x);
 		swap(lhs._y, rhs._y);
+		swap(lhs._line, rhs._line);
 	}
 }
\ No newline at end of file
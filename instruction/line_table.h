@@ -0,0 +1,44 @@
+#pragma once
+
+#include "instruction.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace c0 {
+
+    // 行号表的一项：从第 offset 条指令开始属于源代码的第 line 行
+    class LineEntry {
+    public:
+        std::uint32_t offset;
+        std::uint32_t line;
+
+        bool operator==(const LineEntry& rhs) const { return offset == rhs.offset && line == rhs.line; }
+    };
+
+    // 只在行号变化处记录一项，没有行号的指令属于前一条指令所在的行
+    inline std::vector<LineEntry> lineTable(const std::vector<Instruction>& code) {
+        std::vector<LineEntry> table;
+        std::uint32_t current = 0;
+        for (std::size_t i = 0; i < code.size(); i++) {
+            auto line = code[i].getLine();
+            if (line != 0 && line != current) {
+                table.push_back({ (std::uint32_t)i, line });
+                current = line;
+            }
+        }
+        return table;
+    }
+
+    // 展开为每条指令的行号，第一项之前的指令为 0
+    inline std::vector<std::uint32_t> expandLines(const std::vector<LineEntry>& table, std::size_t count) {
+        std::vector<std::uint32_t> lines(count, 0);
+        for (std::size_t k = 0; k < table.size(); k++) {
+            std::size_t end = k + 1 < table.size() ? table[k + 1].offset : count;
+            for (std::size_t i = table[k].offset; i < end && i < count; i++)
+                lines[i] = table[k].line;
+        }
+        return lines;
+    }
+}
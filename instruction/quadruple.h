@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <utility>
+#include <vector>
 
 namespace c0 {
 
@@ -29,7 +31,10 @@ namespace c0 {
 		BZ,
 
 		PRT,
-		SCN
+		SCN,
+
+		// 按 x - y 的值跳转到 r 中的标号，见 switchLabels
+		SWT
 	};
 	
 	class Quadruple final {
@@ -41,9 +46,9 @@ namespace c0 {
 		Quadruple(QuadOpr opr, std::string x, std::string y, std::string r)
 		    : _opr(opr), _x(std::move(x)), _y(std::move(y)), _r(std::move(r)) {}
 
-		Quadruple() : Quadruple(QuadOpr::LAB, 0){}
-		Quadruple(const Quadruple& i) { _opr = i._opr; _x = i._x; _y = i._y; _r = i._r;}
-		Quadruple(Quadruple&& i) : Quadruple() { swap(*this, i); }
+		Quadruple() : Quadruple(QuadOpr::LAB, ""){}
+		Quadruple(const Quadruple& i) { _opr = i._opr; _x = i._x; _y = i._y; _r = i._r; _line = i._line; _count = i._count; _taken = i._taken;}
+		Quadruple(Quadruple&& i) noexcept : Quadruple() { swap(*this, i); }
 		Quadruple& operator=(Quadruple i) { swap(*this, i); return *this; }
 		bool operator==(const Quadruple& i) const { return _opr == i._opr && _x == i._x; }
 
@@ -53,19 +58,102 @@ namespace c0 {
 		std::string getR() const { return _r; }
         void setX(const std::string &x) {_x = x;}
         void setY(const std::string &y) {_y = y;}
+        void setR(const std::string &r) {_r = r;}
+        // 生成这条四元式的源代码行号，从 1 开始，0 表示未知
+        std::uint32_t getLine() const { return _line; }
+        void setLine(std::uint32_t line) { _line = line; }
+        // 剖析数据（--profile-use）中这条四元式所在基本块执行的次数，没有剖析数据时为 0
+        std::uint64_t getCount() const { return _count; }
+        void setCount(std::uint64_t count) { _count = count; }
+        // 只用于 BZ/BNZ，剖析数据中跳转的次数
+        std::uint64_t getTaken() const { return _taken; }
+        void setTaken(std::uint64_t taken) { _taken = taken; }
 
 
     private:
 		QuadOpr _opr;
 		std::string _x, _y, _r;
+		std::uint32_t _line = 0;
+		std::uint64_t _count = 0, _taken = 0;
+	};
+
+	// SWT 的 r 是逗号分隔的 n + 1 个标号：x - y 为 k（0 <= k < n）时跳到第 k 个，否则跳到最后一个
+	inline std::vector<std::string> switchLabels(const std::string& r) {
+		std::vector<std::string> labels;
+		std::size_t begin = 0;
+		for (std::size_t i = 0; i <= r.size(); i++) {
+			if (i == r.size() || r[i] == ',') {
+				labels.push_back(r.substr(begin, i - begin));
+				begin = i + 1;
+			}
+		}
+		return labels;
+	}
+
+	inline std::string joinLabels(const std::vector<std::string>& labels) {
+		std::string r;
+		for (const auto& label : labels)
+			r += (r.empty() ? "" : ",") + label;
+		return r;
+	}
+
+	// 一串连续的 PRT 合成的一次输出：texts[0] args[0] texts[1] ... args[n-1] texts[n]
+	// 立即数、字符、字符串和换行都并入 texts，args 只有运行时才知道的整数
+	class PrintRun {
+	public:
+		std::vector<std::string> texts;
+		// 操作数和它所在的 PRT 的下标
+		std::vector<std::pair<std::string, std::size_t>> args;
+		// 之后第一条不属于这一串的四元式
+		std::size_t end;
 	};
 
+	// 从 quads[begin] 开始合并到 limit 之前，一条也合并不了时 end 为 begin
+	inline PrintRun printRun(const std::vector<Quadruple>& quads, std::size_t begin, std::size_t limit) {
+		PrintRun run = { { "" }, {}, begin };
+		for (; run.end < limit && quads[run.end].getOperation() == QuadOpr::PRT; run.end++) {
+			const auto& quad = quads[run.end];
+			auto x = quad.getX();
+			// 运行时才知道的字符和 '\0' 不合并
+			if (quad.getY() == "@c" && (x[0] != '$' || std::stoi(x.substr(1)) == 0))
+				break;
+			if (quad.getY() == "@s")
+				run.texts.back() += x.substr(1);
+			else if (quad.getY() == "@ln")
+				run.texts.back() += '\n';
+			else if (x[0] == '$' && quad.getY() == "@c")
+				run.texts.back() += (char)std::stoi(x.substr(1));
+			else if (x[0] == '$')
+				run.texts.back() += x.substr(1);
+			else {
+				run.args.emplace_back(x, run.end);
+				run.texts.emplace_back();
+			}
+		}
+		return run;
+	}
+
+	// fprint 的格式串，见 opCode::fPrint
+	inline std::string formatString(const PrintRun& run) {
+		std::string format;
+		for (std::size_t k = 0; k < run.texts.size(); k++) {
+			if (k > 0)
+				format += "%d";
+			for (char c : run.texts[k])
+				format += c == '%' ? "%%" : std::string(1, c);
+		}
+		return format;
+	}
+
 	inline void swap(Quadruple& lhs, Quadruple& rhs) {
 		using std::swap;
 		swap(lhs._opr, rhs._opr);
 		swap(lhs._x, rhs._x);
 		swap(lhs._y, rhs._y);
 		swap(lhs._r, rhs._r);
+		swap(lhs._line, rhs._line);
+		swap(lhs._count, rhs._count);
+		swap(lhs._taken, rhs._taken);
 	}
 
 }
\ No newline at end of file
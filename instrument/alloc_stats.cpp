@@ -0,0 +1,39 @@
+#include "alloc_stats.h"
+
+#ifdef CC0_COUNT_ALLOCS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<std::size_t> allocCount(0);
+    std::atomic<std::size_t> allocBytes(0);
+
+    void* countedAlloc(std::size_t size) {
+        allocCount.fetch_add(1, std::memory_order_relaxed);
+        allocBytes.fetch_add(size, std::memory_order_relaxed);
+        if (void* p = std::malloc(size == 0 ? 1 : size))
+            return p;
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+namespace c0 {
+#ifdef CC0_COUNT_ALLOCS
+    bool allocStatsEnabled() { return true; }
+    AllocStats allocStats() {
+        return { allocCount.load(std::memory_order_relaxed), allocBytes.load(std::memory_order_relaxed) };
+    }
+#else
+    bool allocStatsEnabled() { return false; }
+    AllocStats allocStats() { return { 0, 0 }; }
+#endif
+}
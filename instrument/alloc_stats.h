@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+namespace c0 {
+
+    // 程序启动以来全局 operator new 的调用次数和分配的字节数
+    class AllocStats {
+    public:
+        std::size_t count;
+        std::size_t bytes;
+
+        AllocStats operator-(const AllocStats& rhs) const { return { count - rhs.count, bytes - rhs.bytes }; }
+    };
+
+    // 只有定义了 CC0_COUNT_ALLOCS（cmake -DCC0_COUNT_ALLOCS=ON）时才会替换全局 operator new 并计数，
+    // 否则 allocStats 总是返回 0
+    bool allocStatsEnabled();
+    AllocStats allocStats();
+}
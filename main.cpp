@@ -5,10 +5,75 @@
 #include "analyser/analyser.h"
 #include "generater/generator.h"
 #include "binary/binary.h"
+#include "binary/loader.h"
+#include "binary/stream_writer.h"
+#include "optimizer/pass_manager.h"
+#include "optimizer/profile_data.h"
+#include "instrument/alloc_stats.h"
+#include "vm/vm.h"
+#include "vm/register_vm.h"
+#include "vm/stack_depth.h"
+#include "native/x86_64.h"
+#include "native/c99.h"
 #include "fmts.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+c0::PassManager passManager;
+// 临时变量留在操作栈上，见 generater/stack_temps.cpp
+bool stackTemps = false;
+// 连续的 print 合成扩展指令 fprint，见 Generator::setFormatPrint
+bool formatPrint = false;
+// 并行生成函数体的线程数
+unsigned jobs = 1;
+// -c 输出的目标文件格式
+c0::ObjectFormat objectFormat;
+// run 时解释器是否融合超级指令
+bool superinstructions = true;
+// run 时使用的解释器，stack 或 register
+std::string engine = "stack";
+// run 时 stack 解释器把热点函数编译成本地代码的阈值，0 表示不使用 JIT
+std::uint32_t jitThreshold = 0;
+// run 时剖析报告和折叠栈的输出文件，为空时不输出
+std::string profileReport;
+std::string profileStacks;
+// -g：输出源代码行号表
+bool debugInfo = false;
+// run --profile-generate 写出剖析数据的文件，为空时不输出
+std::string profileGenerate;
+// --profile-use 读入的剖析数据
+std::optional<c0::ProfileData> profileUse;
+
+// 每个阶段的内存分配次数，见 --alloc-stats
+std::vector<std::pair<std::string, c0::AllocStats>> stageAllocs;
+c0::AllocStats lastAllocs = { 0, 0 };
+
+void _markStage(const std::string& name) {
+	auto now = c0::allocStats();
+	stageAllocs.emplace_back(name, now - lastAllocs);
+	lastAllocs = c0::allocStats();
+}
+
+void _reportAllocs(std::ostream& out) {
+	if (!c0::allocStatsEnabled()) {
+		out << "allocation counting is disabled, rebuild with -DCC0_COUNT_ALLOCS=ON\n";
+		return;
+	}
+	out << fmt::format("{:<16}{:>12}{:>14}\n", "stage", "allocs", "bytes");
+	for (const auto& stage : stageAllocs)
+		out << fmt::format("{:<16}{:>12}{:>14}\n", stage.first, stage.second.count, stage.second.bytes);
+}
 
 std::vector<c0::Token> _tokenize(std::istream& input) {
 	c0::Tokenizer tkz(input);
@@ -17,7 +82,7 @@ std::vector<c0::Token> _tokenize(std::istream& input) {
 		fmt::print(stderr, "Tokenization error: {}\n", p.second.value());
 		exit(2);
 	}
-	return p.first;
+	return std::move(p.first);
 }
 
 void Tokenize(std::istream& input, std::ostream& output) {
@@ -29,71 +94,399 @@ void Tokenize(std::istream& input, std::ostream& output) {
 
 void Analyse(std::istream& input, std::ostream& output){
 	auto tks = _tokenize(input);
-	c0::Analyser analyser(tks);
+	c0::Analyser analyser(std::move(tks));
 	auto p = analyser.Analyse();
 	if (p.second.has_value()) {
 		fmt::print(stderr, "Syntactic analysis error: {}\n", p.second.value());
 		exit(2);
 	}
-	auto v = p.first;
+	auto v = std::move(p.first);
 	for (auto& it : v)
 		output << fmt::format("{}\n", it);
 }
 
-void Compile(std::istream& input, std::ostream& output){
+// 分析并运行 quad 级的 pass
+std::vector<c0::Quadruple> _analyse(std::istream& input) {
+	lastAllocs = c0::allocStats();
 	auto tks = _tokenize(input);
-	c0::Analyser analyser(tks);
+	_markStage("tokenize");
+	c0::Analyser analyser(std::move(tks));
 	auto ana = analyser.Analyse();
 	if (ana.second.has_value()) {
 		fmt::print(stderr, "Syntactic analysis error: {}\n", ana.second.value());
 		exit(2);
 	}
-	auto quad = ana.first;
-    c0::Generator generator(quad);
+	auto quad = std::move(ana.first);
+	_markStage("analyse");
+	if (profileUse.has_value()) {
+		for (const auto& name : profileUse->annotate(quad))
+			fmt::print(stderr, "Warning: profile of {} does not match the source, ignored.\n", name);
+	}
+	passManager.runOnQuads(quad);
+	_markStage("quad passes");
+	return quad;
+}
+
+// sink 不为空时函数体交给 sink，code 级的 pass 由 sink 逐个函数运行
+// quads 不为空时保存生成字节码的四元式，并记录每条四元式对应的指令，供 --profile-generate 使用
+c0::byteCode _generate(std::istream& input, c0::GeneratorSink* sink = nullptr,
+                       std::vector<c0::Quadruple>* quads = nullptr) {
+	auto quad = _analyse(input);
+    if (quads != nullptr)
+        *quads = quad;
+    c0::Generator generator(std::move(quad), stackTemps, jobs);
+    generator.setSink(sink);
+    generator.setQuadOffsets(quads != nullptr);
+    generator.setFormatPrint(formatPrint);
     auto code = generator.Generate();
+	_markStage("generate");
+    if (sink == nullptr) {
+        passManager.runOnCode(code);
+        _markStage("code passes");
+    }
+    return code;
+}
 
+// .s0 中的字符串常量：文本按行解析，换行、引号、反斜杠和其它控制字符写成转义序列
+std::string _escape(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '\n')
+            out += "\\n";
+        else if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20 || c == 0x7f)
+            out += fmt::format("\\x{:02x}", (unsigned char)c);
+        else
+            out += c;
+    }
+    return out;
+}
+
+// 输出 .s0 文本，Compile 和 --disassemble 共用
+// constants 中的元素为 <类型, 值>，start 和 instructions[i] 可以遍历出 Instruction
+// frames 和 lines 不为空时最后输出栈帧大小和行号表，[0] 为 .start，[i + 1] 为函数 i
+template<typename Constants, typename Code, typename Bodies>
+void _printText(std::ostream& output, const Constants& constants, const Code& start,
+				const std::vector<c0::funcInfo>& functions, const Bodies& instructions,
+				const std::vector<c0::frameInfo>& frames = {},
+				const std::vector<std::vector<c0::LineEntry>>& lines = {}) {
     int i;
     output << ".constants:\n";
     i = 0;
-    for (const auto& pair : code.constants) {
-        output << i++ << "\t" << pair.first << "\t\"" << pair.second << "\"\n";
+    for (const auto& pair : constants) {
+        output << i++ << "\t" << pair.first << "\t\"" << _escape(pair.second) << "\"\n";
     }
 
     output << ".start:\n";
     i = 0;
-    for (const auto& it : code.start) {
+    for (const auto& it : start) {
         output << i++ << "\t" << fmt::format("{}\n", it);
     }
 
     output << ".functions:\n";
     i = 0;
-    for (const auto& it : code.functions) {
+    for (const auto& it : functions) {
         output << i++ << "\t" << fmt::format("{}\n", it);
     }
 
-    for (i = 0; i < (int)code.instructions.size(); i++) {
+    for (i = 0; i < (int)instructions.size(); i++) {
         output << ".F" << i << ":\n";
         int j = 0;
-        for (const auto &it : code.instructions[i]) {
+        for (const auto &it : instructions[i]) {
             output << j++ << "\t" << fmt::format("{}\n", it);
         }
     }
+
+    // 每行为 max_stack 和 locals
+    if (!frames.empty())
+        output << ".frames:\n";
+    for (i = 0; i < (int)frames.size(); i++) {
+        output << (i == 0 ? std::string(".start") : ".F" + std::to_string(i - 1))
+               << "\t" << frames[i].max_stack << "\t" << frames[i].locals << "\n";
+    }
+
+    // 每项为 指令下标:行号
+    if (lines.empty())
+        return;
+    output << ".lines:\n";
+    for (i = 0; i < (int)lines.size(); i++) {
+        output << (i == 0 ? std::string(".start") : ".F" + std::to_string(i - 1));
+        for (const auto& entry : lines[i])
+            output << (&entry == &lines[i].front() ? "\t" : " ") << entry.offset << ":" << entry.line;
+        output << "\n";
+    }
 }
 
-void BinaryCode(std::istream& input, std::ofstream& output){
-	auto tks = _tokenize(input);
-	c0::Analyser analyser(tks);
-	auto ana = analyser.Analyse();
-	if (ana.second.has_value()) {
-		fmt::print(stderr, "Syntactic analysis error: {}\n", ana.second.value());
+// -S native / -S c：不经过字节码，直接从四元式生成 x86-64 汇编或 C99
+void Assemble(std::istream& input, std::ostream& output, const std::string& target) {
+	auto quad = _analyse(input);
+	std::optional<std::string> err;
+	if (target == "native")
+		err = c0::generateX86_64(quad, output);
+	else if (target == "c")
+		err = c0::generateC99(quad, output);
+	if (err.has_value()) {
+		fmt::print(stderr, "Code generation error: {}\n", err.value());
 		exit(2);
 	}
-	auto quad = ana.first;
-    c0::Generator generator(quad);
-    auto code = generator.Generate();
+	_markStage("generate");
+}
+
+void Compile(std::istream& input, std::ostream& output){
+    auto code = _generate(input);
+
+    std::vector<std::vector<c0::LineEntry>> lines;
+    if (debugInfo) {
+        lines.push_back(c0::lineTable(code.start));
+        for (const auto& it : code.instructions)
+            lines.push_back(c0::lineTable(it));
+    }
+    // 代码总是由本程序生成，栈深度不一致时只是不输出栈帧
+    std::vector<c0::frameInfo> frames;
+    if (c0::frameSizes(code, frames))
+        frames.clear();
+    _printText(output, code.constants, code.start, code.functions, code.instructions, frames, lines);
+    _markStage("output");
+}
+
+// 读入并校验目标文件，出错时退出
+c0::ObjectFile _loadObject(const std::string& inputFile) {
+    auto object = c0::ObjectFile::Load(inputFile);
+    if (object.second.has_value()) {
+        fmt::print(stderr, "Object file error: {}\n", object.second.value());
+        exit(2);
+    }
+    auto obj = std::move(object.first.value());
+    auto err = obj.start().verify();
+    for (std::size_t i = 0; !err.has_value() && i < obj.instructions().size(); i++)
+        err = obj.verify(i);
+    if (err.has_value()) {
+        fmt::print(stderr, "Object file error: {}: {}\n", inputFile, err.value());
+        exit(2);
+    }
+    return obj;
+}
+
+bool _isObjectFile(std::istream& input) {
+    char head[4] = {};
+    input.read(head, sizeof(head));
+    bool object = input.gcount() == (std::streamsize)sizeof(head)
+        && ((unsigned char)head[0] << 24 | (unsigned char)head[1] << 16
+            | (unsigned char)head[2] << 8 | (unsigned char)head[3]) == c0::objectMagic;
+    input.clear();
+    input.seekg(0);
+    return object;
+}
+
+// 有行号表时把行号放回指令上，供 --profile 使用
+std::vector<c0::Instruction> _decode(const c0::CodeView& view, const std::vector<c0::LineEntry>& lines = {}) {
+    std::vector<c0::Instruction> seq;
+    seq.reserve(view.size());
+    for (const auto& it : view)
+        seq.push_back(it);
+    for (const auto& entry : lines)
+        seq[entry.offset].setLine(entry.line);
+    return seq;
+}
+
+// 目标文件中的代码转成 byteCode，供 run 和 --disassemble 使用
+c0::byteCode _byteCode(const c0::ObjectFile& obj) {
+    std::vector<std::pair<char, std::string>> constants;
+    for (const auto& it : obj.constants())
+        constants.emplace_back(it.first, std::string(it.second));
+    // 没有调试信息时 lines 为空
+    const auto& lines = obj.lines();
+    auto linesOf = [&](std::size_t i) { return i < lines.size() ? lines[i] : std::vector<c0::LineEntry>(); };
+    std::vector<std::vector<c0::Instruction>> instructions;
+    for (std::size_t i = 0; i < obj.instructions().size(); i++)
+        instructions.push_back(_decode(obj.instructions()[i], linesOf(i + 1)));
+    return c0::byteCode(std::move(constants), _decode(obj.start(), linesOf(0)), obj.functions(),
+                        std::move(instructions));
+}
 
-    c0::Binary binary(code.constants, code.start, code.functions, code.instructions);
-    binary.output_binary(output);
+// 目标文件没有栈帧段时（版本 1 或者栈深度不一致）和 -s 一样由栈深度分析求出，代码有错时不输出
+void Disassemble(const std::string& inputFile, std::ostream& output) {
+    auto obj = _loadObject(inputFile);
+    auto frames = obj.frames();
+    if (frames.empty()) {
+        auto code = _byteCode(obj);
+        auto err = c0::checkCode(code.start, -1, code.functions.size(), code.constants.size());
+        for (std::size_t i = 0; !err.has_value() && i < code.instructions.size(); i++)
+            err = c0::checkCode(code.instructions[i], (int)i, code.functions.size(), code.constants.size());
+        if (err.has_value() || c0::frameSizes(code, frames))
+            frames.clear();
+    }
+    _printText(output, obj.constants(), obj.start(), obj.functions(), obj.instructions(), frames, obj.lines());
+}
+
+template<typename Engine>
+void _reportVM(const Engine& vm) {
+    fmt::print(stderr, "instructions: {} loaded, {} after translation\n",
+               vm.loadedInstructions(), vm.decodedInstructions());
+    if (c0::VM::countsDispatches())
+        fmt::print(stderr, "dispatches: {}\n", vm.dispatches());
+    else
+        fmt::print(stderr, "dispatch counting is disabled, rebuild with -DCC0_VM_STATS=ON\n");
+}
+
+// 写出剖析结果，--profile 和 --profile-stacks 的文件
+void _writeProfile(const c0::Profiler& profiler) {
+	auto write = [](const std::string& file, const std::function<void(std::ostream&)>& writer) {
+		if (file.empty())
+			return;
+		std::ofstream out(file, std::ios::out | std::ios::trunc);
+		if (!out)
+			fmt::print(stderr, "Fail to open {} for writing.\n", file);
+		else
+			writer(out);
+	};
+	write(profileReport, [&](std::ostream& out) {
+		profiler.report(out, [](c0::opCode op) { return fmt::format("{}", op); });
+	});
+	write(profileStacks, [&](std::ostream& out) { profiler.collapsedStacks(out); });
+}
+
+// 由 VM 的指令计数写出 --profile-generate 的剖析数据
+void _writeProfileData(const c0::Profiler& profiler, const c0::byteCode& code,
+                       const std::vector<c0::Quadruple>& quads) {
+    // 函数末尾的 LAB 对应的下标可以等于函数的指令数
+    auto valid = [&](int funcId, std::size_t index) {
+        return index < (funcId < 0 ? code.start.size() : code.instructions[funcId].size());
+    };
+    auto data = c0::ProfileData::collect(quads, code.quadOffsets,
+        [&](int funcId, std::size_t index) { return valid(funcId, index) ? profiler.executed(funcId, index) : 0; },
+        [&](int funcId, std::size_t index) { return valid(funcId, index) ? profiler.taken(funcId, index) : 0; });
+    std::ofstream out(profileGenerate, std::ios::out | std::ios::trunc);
+    if (!out)
+        fmt::print(stderr, "Fail to open {} for writing.\n", profileGenerate);
+    else
+        data.write(out);
+}
+
+// run：输入是目标文件时直接解释执行，否则先编译再在内存中执行
+void Run(const std::string& inputFile, std::istream& input, bool stats) {
+    std::vector<c0::Quadruple> quads;
+    auto code = [&] {
+        if (!_isObjectFile(input))
+            return _generate(input, nullptr, profileGenerate.empty() ? nullptr : &quads);
+        if (!profileGenerate.empty()) {
+            fmt::print(stderr, "--profile-generate requires a source file.\n");
+            exit(2);
+        }
+
+        return _byteCode(_loadObject(inputFile));
+    }();
+
+    std::optional<std::string> err;
+    std::cout.flush();
+    if (engine == "register") {
+        c0::RegisterVM vm(code, std::cin, std::cout);
+        err = vm.Run();
+        if (stats)
+            _reportVM(vm);
+    } else {
+        bool profile = !profileReport.empty() || !profileStacks.empty() || !profileGenerate.empty();
+        c0::VM vm(code, std::cin, std::cout, 1 << 20, superinstructions, jitThreshold, profile);
+        err = vm.Run();
+        std::cout.flush();
+        // 加载出错时没有剖析数据
+        if (profile && vm.profiler())
+            _writeProfile(*vm.profiler());
+        if (!profileGenerate.empty() && vm.profiler())
+            _writeProfileData(*vm.profiler(), code, quads);
+        if (stats) {
+            _reportVM(vm);
+            if (jitThreshold > 0)
+                fmt::print(stderr, "jit: {} functions compiled, {} native entries\n",
+                           vm.compiledFunctions(), vm.nativeEntries());
+        }
+    }
+    std::cout.flush();
+    if (err.has_value()) {
+        fmt::print(stderr, "Runtime error: {}\n", err.value());
+        exit(3);
+    }
+}
+
+void BinaryCode(std::istream& input, std::ofstream& output){
+    auto code = _generate(input);
+
+    // 版本 2 的可选段，栈深度不一致时不输出
+    std::vector<c0::frameInfo> frames;
+    if (objectFormat.version == 2 && c0::frameSizes(code, frames))
+        frames.clear();
+    c0::Binary binary(std::move(code));
+    binary.setFrames(std::move(frames));
+    if (objectFormat.version == 1) {
+        auto overflow = binary.checkVersion1();
+        if (overflow.has_value()) {
+            fmt::print(stderr, "Object file version 1 cannot hold {}, use --object-version=2.\n", overflow.value());
+            exit(2);
+        }
+    }
+    binary.output_binary(output, objectFormat);
+    _markStage("output");
+}
+
+// --stream：每个函数体生成后立即运行 code 级的 pass 并交给 ObjectStreamWriter 写出
+class StreamingSink final : public c0::GeneratorSink {
+public:
+    explicit StreamingSink(c0::ObjectStreamWriter& writer) : _writer(writer) {}
+
+    void begin(const std::vector<std::pair<char, std::string>>& constants,
+               std::vector<c0::Instruction>& start, const std::vector<c0::funcInfo>& functions) override {
+        passManager.runOnFunction(-1, start);
+        _writer.begin(constants, start, functions);
+    }
+
+    void function(int funcId, std::vector<c0::Instruction>& code) override {
+        passManager.runOnFunction(funcId, code);
+        _writer.function(funcId, code);
+    }
+
+private:
+    c0::ObjectStreamWriter& _writer;
+};
+
+// 出错时已经写出了一部分，删除输出文件
+void StreamBinaryCode(std::istream& input, std::ofstream& output, const std::string& outputFile) {
+    c0::ObjectStreamWriter writer(output, objectFormat);
+    StreamingSink sink(writer);
+    _generate(input, &sink);
+    auto err = writer.finish();
+    _markStage("output");
+    if (err.has_value()) {
+        output.close();
+        std::remove(outputFile.c_str());
+        fmt::print(stderr, "Fail to write object file: {}\n", err.value());
+        exit(2);
+    }
+}
+
+// argparse 不支持 --opt=value 和 -jN 的写法，拆成两个参数
+// c0 run file 等同于 c0 --run file
+std::vector<std::string> _normalizeArgs(int argc, char** argv) {
+	std::vector<std::string> args;
+	for (int i = 0; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i == 1 && arg == "run") {
+			args.push_back("--run");
+			continue;
+		}
+		auto eq = arg.find('=');
+		if (arg.rfind("--", 0) == 0 && eq != std::string::npos) {
+			args.push_back(arg.substr(0, eq));
+			args.push_back(arg.substr(eq + 1));
+		} else if (arg.size() > 2 && arg.rfind("-j", 0) == 0) {
+			args.push_back("-j");
+			args.push_back(arg.substr(2));
+		} else
+			args.push_back(arg);
+	}
+	return args;
 }
 
 int main(int argc, char** argv) {
@@ -116,13 +509,103 @@ int main(int argc, char** argv) {
 		.default_value(false)
 		.implicit_value(true)
 		.help("generate binary object file for the input file.");
+	program.add_argument("-S")
+		.default_value(std::string(""))
+		.help("generate assembly for the target: native (x86-64 GNU as) or c (C99).");
+	program.add_argument("--object-version")
+		.default_value(std::string("1"))
+		.help("format version of the binary object file, 1 or 2.");
+	program.add_argument("--varint-operands")
+		.default_value(false)
+		.implicit_value(true)
+		.help("encode operands as varints in object file version 2.");
+	program.add_argument("-g")
+		.default_value(false)
+		.implicit_value(true)
+		.help("emit a source line table: appended to -s output, or as a debug section with -c (object version 2).");
+	program.add_argument("--stream")
+		.default_value(false)
+		.implicit_value(true)
+		.help("with -c, write each function as soon as it is generated.");
+	program.add_argument("--disassemble")
+		.default_value(false)
+		.implicit_value(true)
+		.help("translate the input binary object file to byte code text.");
+	program.add_argument("--run")
+		.default_value(false)
+		.implicit_value(true)
+		.help("compile the input file, or load the input object file, and interpret it.");
+	program.add_argument("--engine")
+		.default_value(std::string("stack"))
+		.help("with run, interpret with the stack or register engine.");
+	program.add_argument("--no-superinstructions")
+		.default_value(false)
+		.implicit_value(true)
+		.help("with run, interpret the byte code without fusing instruction sequences.");
+	program.add_argument("--jit")
+		.default_value(false)
+		.implicit_value(true)
+		.help("with run, compile hot functions to x86-64 machine code.");
+	program.add_argument("--jit-threshold")
+		.default_value(std::string("1000"))
+		.help("with --jit, calls plus backward jumps before a function is compiled.");
+	program.add_argument("--profile")
+		.default_value(std::string(""))
+		.help("with run, profile the stack engine and write the report to the file.");
+	program.add_argument("--profile-stacks")
+		.default_value(std::string(""))
+		.help("with run, profile the stack engine and write collapsed stacks for flamegraph.pl to the file.");
+	program.add_argument("--profile-generate")
+		.default_value(std::string(""))
+		.help("with run, compile without optimization and write block and call counts of the stack engine to the file.");
+	program.add_argument("--profile-use")
+		.default_value(std::string(""))
+		.help("read block and call counts written by --profile-generate to guide the quad passes.");
+	program.add_argument("--vm-stats")
+		.default_value(false)
+		.implicit_value(true)
+		.help("with run, report instruction and dispatch counts to stderr.");
 	program.add_argument("-o", "--output")
 		.required()
 		.default_value(std::string("-"))
 		.help("specify the output file.");
+	program.add_argument("-O0")
+		.default_value(false)
+		.implicit_value(true)
+		.help("disable optimization (default).");
+	program.add_argument("-O1")
+		.default_value(false)
+		.implicit_value(true)
+		.help("enable cheap optimizations.");
+	program.add_argument("-O2")
+		.default_value(false)
+		.implicit_value(true)
+		.help("enable all optimizations.");
+	program.add_argument("--passes")
+		.default_value(std::string(""))
+		.help("run the comma separated passes instead of an -O pipeline.");
+	program.add_argument("--stack-temps")
+		.default_value(false)
+		.implicit_value(true)
+		.help("keep single-use temporaries on the operand stack (implied by -O2).");
+	program.add_argument("--fprint")
+		.default_value(false)
+		.implicit_value(true)
+		.help("merge print statements into the fprint extension instruction (implied by -O1 and -O2).");
+	program.add_argument("-j", "--jobs")
+		.default_value(std::string("1"))
+		.help("generate function bodies with N threads, 0 for one per core.");
+	program.add_argument("--alloc-stats")
+		.default_value(false)
+		.implicit_value(true)
+		.help("report allocations made by each compiler stage to stderr.");
+	program.add_argument("--time-passes")
+		.default_value(false)
+		.implicit_value(true)
+		.help("report time and IR size of each pass to stderr.");
 
 	try {
-		program.parse_args(argc, argv);
+		program.parse_args(_normalizeArgs(argc, argv));
 	}
 	catch (const std::runtime_error& err) {
 		fmt::print(stderr, "{}\n\n", err.what());
@@ -151,22 +634,110 @@ int main(int argc, char** argv) {
 	if (output_file == "-")
 	    output_file = "out";
 
-	if (program["-c"] == true)
-        outf.open(output_file, std::ios::binary | std::ios::out | std::ios::trunc);
-	else
-        outf.open(output_file, std::ios::out | std::ios::trunc);
+	// run 时程序的输出写到标准输出，不创建输出文件
+	if (program["--run"] == true)
+		output = &std::cout;
+	else {
+		if (program["-c"] == true)
+			outf.open(output_file, std::ios::binary | std::ios::out | std::ios::trunc);
+		else
+			outf.open(output_file, std::ios::out | std::ios::trunc);
 
-    if (!outf) {
-        fmt::print(stderr, "Fail to open {} for writing.\n", output_file);
-        exit(2);
-    }
-    output = &outf;
+		if (!outf) {
+			fmt::print(stderr, "Fail to open {} for writing.\n", output_file);
+			exit(2);
+		}
+		output = &outf;
+	}
 
-	if (program["-s"] == true && program["-c"] == true) {
+	auto target = program.get<std::string>("-S");
+	if (!target.empty() && target != "native" && target != "c") {
+		fmt::print(stderr, "Unknown target {}, use native or c.\n", target);
+		exit(2);
+	}
+	int modes = (program["-s"] == true) + (program["-c"] == true) + (program["--disassemble"] == true)
+		+ (program["--run"] == true) + !target.empty();
+	if (modes > 1) {
 		fmt::print(stderr, "You can only generate byte code or binary file at one time.");
 		exit(2);
 	}
 
+	if (program["--run"] == true)
+		profileGenerate = program.get<std::string>("--profile-generate");
+	auto passes = program.get<std::string>("--passes");
+	// 剖析数据以没有经过任何 pass 的四元式为准，忽略 -O 和 --passes
+	if (!profileGenerate.empty())
+		stackTemps = false;
+	else if (!passes.empty()) {
+		auto unknown = passManager.addPasses(passes);
+		if (unknown.has_value()) {
+			fmt::print(stderr, "Unknown pass {}. Available passes:", unknown.value());
+			for (const auto& name : c0::PassManager::availablePasses())
+				fmt::print(stderr, " {}", name);
+			fmt::print(stderr, "\n");
+			exit(2);
+		}
+	}
+	else if (program["-O2"] == true) {
+		passManager.addPipeline(2);
+		stackTemps = true;
+		formatPrint = true;
+	}
+	else if (program["-O1"] == true) {
+		passManager.addPipeline(1);
+		formatPrint = true;
+	}
+	else
+		passManager.addPipeline(0);
+	if (program["--stack-temps"] == true && profileGenerate.empty())
+		stackTemps = true;
+	if (program["--fprint"] == true)
+		formatPrint = true;
+
+	auto profileFile = program.get<std::string>("--profile-use");
+	if (!profileFile.empty()) {
+		std::ifstream in(profileFile);
+		if (!in) {
+			fmt::print(stderr, "Fail to open {} for reading.\n", profileFile);
+			exit(2);
+		}
+		profileUse.emplace();
+		auto err = profileUse->read(in);
+		if (err.has_value()) {
+			fmt::print(stderr, "Profile error: {}: {}\n", profileFile, err.value());
+			exit(2);
+		}
+	}
+
+	try {
+		int n = std::stoi(program.get<std::string>("--jobs"));
+		if (n < 0)
+			throw std::invalid_argument("negative");
+		jobs = n == 0 ? std::max(1u, std::thread::hardware_concurrency()) : (unsigned)n;
+	}
+	catch (const std::logic_error&) {
+		fmt::print(stderr, "Invalid number of jobs {}.\n", program.get<std::string>("--jobs"));
+		exit(2);
+	}
+
+	auto objectVersion = program.get<std::string>("--object-version");
+	if (objectVersion != "1" && objectVersion != "2") {
+		fmt::print(stderr, "Unsupported object file version {}.\n", objectVersion);
+		exit(2);
+	}
+	objectFormat.version = std::stoi(objectVersion);
+	objectFormat.varintOperands = program["--varint-operands"] == true;
+	if (objectFormat.varintOperands && objectFormat.version != 2) {
+		fmt::print(stderr, "--varint-operands requires --object-version=2.\n");
+		exit(2);
+	}
+	debugInfo = program["-g"] == true;
+	objectFormat.debugLines = debugInfo && program["-c"] == true;
+	if (objectFormat.debugLines && objectFormat.version != 2) {
+		fmt::print(stderr, "-g with -c requires --object-version=2.\n");
+		exit(2);
+	}
+
 //	if (program["-t"] == true) {
 //		Tokenize(*input, *output);
 //	}
@@ -176,12 +747,55 @@ int main(int argc, char** argv) {
 	if (program["-s"] == true) {
 		Compile(*input, *output);
 	}
+	else if (program["-c"] == true && program["--stream"] == true) {
+        StreamBinaryCode(*input, outf, output_file);
+	}
 	else if (program["-c"] == true) {
         BinaryCode(*input, outf);
 	}
+	else if (!target.empty()) {
+		Assemble(*input, *output, target);
+	}
+	else if (program["--disassemble"] == true) {
+		Disassemble(input_file, *output);
+	}
+	else if (program["--run"] == true) {
+		superinstructions = program["--no-superinstructions"] == false;
+		engine = program.get<std::string>("--engine");
+		if (engine != "stack" && engine != "register") {
+			fmt::print(stderr, "Unknown engine {}, use stack or register.\n", engine);
+			exit(2);
+		}
+		if (program["--jit"] == true) {
+			try {
+				int n = std::stoi(program.get<std::string>("--jit-threshold"));
+				if (n <= 0)
+					throw std::invalid_argument("not positive");
+				jitThreshold = (std::uint32_t)n;
+			}
+			catch (const std::logic_error&) {
+				fmt::print(stderr, "Invalid jit threshold {}.\n", program.get<std::string>("--jit-threshold"));
+				exit(2);
+			}
+			if (engine != "stack" || !c0::Jit::supported())
+				fmt::print(stderr, "--jit is only supported by the stack engine on x86-64 Linux, interpreting instead.\n");
+		}
+		profileReport = program.get<std::string>("--profile");
+		profileStacks = program.get<std::string>("--profile-stacks");
+		if ((!profileReport.empty() || !profileStacks.empty() || !profileGenerate.empty()) && engine != "stack") {
+			fmt::print(stderr, "--profile and --profile-generate are only supported by the stack engine.\n");
+			exit(2);
+		}
+		Run(input_file, *input, program["--vm-stats"] == true);
+	}
 	else {
 		fmt::print(stderr, "You must choose  byte code or binary file to generate.");
 		exit(2);
 	}
+
+	if (program["--time-passes"] == true)
+		passManager.report(std::cerr);
+	if (program["--alloc-stats"] == true)
+		_reportAllocs(std::cerr);
 	return 0;
 }
\ No newline at end of file
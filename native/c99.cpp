@@ -0,0 +1,313 @@
+#include "c99.h"
+#include "quad_frame.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <unordered_set>
+
+namespace c0 {
+
+    namespace {
+        // 非打印字符用八进制转义；? 也要转义，避免 -std=c99 下组成三字符组
+        std::string escape(const std::string& s) {
+            std::string out;
+            for (char c : s) {
+                if (c == '"' || c == '\\' || c == '?') {
+                    out += '\\';
+                    out += c;
+                } else if (c >= 0x20 && c < 0x7f)
+                    out += c;
+                else {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\%03o", (unsigned char)c);
+                    out += buf;
+                }
+            }
+            return out;
+        }
+
+        // 比较关系成立（taken）或不成立时的 C 运算符
+        std::string relationOperator(QuadOpr relation, bool taken) {
+            switch (relation) {
+                case QuadOpr::EQU:
+                    return taken ? "==" : "!=";
+                case QuadOpr::NE:
+                    return taken ? "!=" : "==";
+                case QuadOpr::LT:
+                    return taken ? "<" : ">=";
+                case QuadOpr::LE:
+                    return taken ? "<=" : ">";
+                case QuadOpr::GT:
+                    return taken ? ">" : "<=";
+                default:
+                    return taken ? ">=" : "<";
+            }
+        }
+
+        std::string label(const std::string& name) {
+            return "L" + name.substr(1);
+        }
+
+        class CEmitter {
+        public:
+            CEmitter(const std::vector<Quadruple>& quads, const QuadProgram& program, std::ostream& out)
+                : _quads(quads), _program(program), _out(out) {}
+
+            void declarations();
+            // funcId 为 -1 时输出 .start
+            void function(int funcId);
+
+        private:
+            const std::vector<Quadruple>& _quads;
+            const QuadProgram& _program;
+            std::ostream& _out;
+            const QuadFunction* _fun = nullptr;
+            bool _start = false;
+
+            void line(const std::string& text) { _out << "    " << text << '\n'; }
+            std::string signature(const QuadFunction& fun) const;
+            // main 总是返回 int32_t，和 runtime/c0rt.c 中的声明一致
+            bool returnsInt(const QuadFunction& fun) const { return fun.returnsValue || fun.name == "main"; }
+            std::string slot(int k) const { return (_start ? "g" : "s") + std::to_string(k); }
+            std::string operand(const std::string& opr) const;
+            void quad(std::size_t i);
+            // 一串 PRT 合成一次调用
+            void print(const PrintRun& run);
+        };
+
+        std::string CEmitter::signature(const QuadFunction& fun) const {
+            std::string params;
+            for (int k = 0; k < fun.paramSize; k++)
+                params += (k ? ", int32_t s" : "int32_t s") + std::to_string(k);
+            return std::string(returnsInt(fun) ? "int32_t" : "void") + " c0f_" + fun.name
+                + "(" + (params.empty() ? "void" : params) + ")";
+        }
+
+        std::string CEmitter::operand(const std::string& opr) const {
+            auto parsed = QuadOperand::parse(opr);
+            switch (parsed.kind) {
+                case QuadOperand::Immediate:
+                    // -2147483648 在 C 中是对 2147483648 取负，类型不是 int32_t
+                    if (parsed.value == INT32_MIN)
+                        return "INT32_MIN";
+                    return std::to_string(parsed.value);
+                case QuadOperand::Global:
+                    return "g" + std::to_string(parsed.value);
+                case QuadOperand::Slot:
+                    return slot(parsed.value);
+                default:
+                    return "0";
+            }
+        }
+
+        void CEmitter::declarations() {
+            _out << "/* generated by cc0 */\n#include <stdint.h>\n\n#include \"c0rt.h\"\n\n";
+            if (_program.start.frameSize > 0) {
+                for (int k = 0; k < _program.start.frameSize; k++)
+                    _out << "static int32_t g" << k << ";\n";
+                _out << "\n";
+            }
+            _out << "void c0_start(void);\n";
+            for (const auto& fun : _program.functions)
+                _out << signature(fun) << ";\n";
+        }
+
+        void CEmitter::function(int funcId) {
+            _start = funcId < 0;
+            _fun = _start ? &_program.start : &_program.functions[funcId];
+
+            // 只声明用到的槽和跳转到的标号，生成的代码在 -Wall 下没有警告
+            std::set<int> slots;
+            std::unordered_set<std::string> targets;
+            for (std::size_t i = _fun->begin; i < _fun->end; i++) {
+                const auto& quad = _quads[i];
+                int d = _fun->depth[i - _fun->begin];
+                switch (quad.getOperation()) {
+                    case QuadOpr::GOTO: case QuadOpr::BZ: case QuadOpr::BNZ:
+                        targets.insert(quad.getX());
+                        break;
+                    case QuadOpr::SWT:
+                        for (const auto& target : switchLabels(quad.getR()))
+                            targets.insert(target);
+                        break;
+                    case QuadOpr::PUSH:
+                        slots.insert(d);
+                        break;
+                    case QuadOpr::CAL:
+                        slots.insert(d - _program.functions[_program.functionIndex.at(quad.getX().substr(1))].paramSize);
+                        break;
+                    default:
+                        break;
+                }
+                for (const auto& opr : { quad.getX(), quad.getY(), quad.getR() }) {
+                    if (QuadOperand::parse(opr).kind == QuadOperand::Slot)
+                        slots.insert(QuadOperand::parse(opr).value);
+                }
+            }
+
+            _out << "\n" << (_start ? "void c0_start(void)" : signature(*_fun)) << " {\n";
+            if (!_start) {
+                std::string locals;
+                for (int k : slots) {
+                    if (k >= _fun->paramSize)
+                        locals += (locals.empty() ? "" : ", ") + slot(k);
+                }
+                if (!locals.empty())
+                    line("int32_t " + locals + ";");
+            }
+
+            for (std::size_t i = _fun->begin; i < _fun->end; i++) {
+                if (_quads[i].getOperation() == QuadOpr::LAB && targets.count(_quads[i].getX()) == 0)
+                    continue;
+                if (_quads[i].getOperation() == QuadOpr::PRT) {
+                    auto run = printRun(_quads, i, _fun->end);
+                    if (run.end > i) {
+                        print(run);
+                        i = run.end - 1;
+                        continue;
+                    }
+                }
+                quad(i);
+            }
+
+            if (!_start) {
+                // 执行到末尾没有返回
+                line("c0rt_fall_off(\"" + escape(_fun->name) + "\");");
+            }
+            _out << "}\n";
+        }
+
+        void CEmitter::print(const PrintRun& run) {
+            if (run.args.empty()) {
+                if (run.texts[0] == "\n")
+                    line("c0rt_print_line();");
+                else if (!run.texts[0].empty())
+                    line("c0rt_print_string(\"" + escape(run.texts[0]) + "\");");
+                return;
+            }
+            if (run.args.size() == 1 && run.texts[0].empty() && run.texts[1].empty()) {
+                line("c0rt_print_int(" + operand(run.args[0].first) + ");");
+                return;
+            }
+            std::string call = "c0rt_print_format(\"" + escape(formatString(run)) + "\"";
+            for (const auto& arg : run.args)
+                call += ", " + operand(arg.first);
+            line(call + ");");
+        }
+
+        void CEmitter::quad(std::size_t i) {
+            const auto& quad = _quads[i];
+            int d = _fun->depth[i - _fun->begin];
+            auto x = operand(quad.getX()), y = operand(quad.getY()), r = operand(quad.getR());
+
+            switch (quad.getOperation()) {
+                case QuadOpr::ASN:
+                    line(r + " = " + x + ";");
+                    break;
+                case QuadOpr::NEG:
+                    line(r + " = c0rt_neg(" + x + ");");
+                    break;
+                case QuadOpr::ADD:
+                    line(r + " = c0rt_add(" + x + ", " + y + ");");
+                    break;
+                case QuadOpr::SUB:
+                    line(r + " = c0rt_sub(" + x + ", " + y + ");");
+                    break;
+                case QuadOpr::MUL:
+                    line(r + " = c0rt_mul(" + x + ", " + y + ");");
+                    break;
+                case QuadOpr::DIV:
+                    line(r + " = c0rt_div(" + x + ", " + y + ");");
+                    break;
+
+                case QuadOpr::LAB:
+                    // C99 中标号后面必须是语句，函数末尾的标号后面没有
+                    _out << label(quad.getX()) << ":;\n";
+                    break;
+                case QuadOpr::FUNC:
+                case QuadOpr::POP:
+                    break;
+                case QuadOpr::PUSH:
+                    line(slot(d) + " = " + x + ";");
+                    break;
+                case QuadOpr::CAL: {
+                    const auto& callee = _program.functions[_program.functionIndex.at(quad.getX().substr(1))];
+                    int base = d - callee.paramSize;
+                    std::string args;
+                    for (int k = 0; k < callee.paramSize; k++)
+                        args += (k ? ", " : "") + slot(base + k);
+                    std::string call = "c0f_" + callee.name + "(" + args + ");";
+                    line(callee.returnsValue ? slot(base) + " = " + call : call);
+                    break;
+                }
+                case QuadOpr::RET:
+                    if (_start)
+                        line("return;");
+                    else if (!quad.getX().empty())
+                        line("return " + x + ";");
+                    else
+                        line(returnsInt(*_fun) ? "return 0;" : "return;");
+                    break;
+
+                case QuadOpr::EQU: case QuadOpr::NE: case QuadOpr::LT:
+                case QuadOpr::LE: case QuadOpr::GT: case QuadOpr::GE:
+                    // 由之后的 BZ/BNZ 生成条件
+                    break;
+                case QuadOpr::GOTO:
+                    line("goto " + label(quad.getX()) + ";");
+                    break;
+                case QuadOpr::BNZ:
+                case QuadOpr::BZ: {
+                    QuadOpr relation;
+                    if (!branchRelation(_quads, i, relation))
+                        break;
+                    const auto& compare = _quads[i - 1];
+                    line("if (" + operand(compare.getX()) + " "
+                         + relationOperator(relation, quad.getOperation() == QuadOpr::BNZ) + " "
+                         + operand(compare.getY()) + ") goto " + label(quad.getX()) + ";");
+                    break;
+                }
+                case QuadOpr::SWT: {
+                    // 连续的 case 由 C 编译器生成跳转表
+                    auto targets = switchLabels(quad.getR());
+                    line("switch ((uint32_t)" + x + " - (uint32_t)" + y + ") {");
+                    for (std::size_t k = 0; k + 1 < targets.size(); k++)
+                        line("case " + std::to_string(k) + ": goto " + label(targets[k]) + ";");
+                    line("default: goto " + label(targets.back()) + ";");
+                    line("}");
+                    break;
+                }
+
+                case QuadOpr::PRT:
+                    if (quad.getY() == "@i")
+                        line("c0rt_print_int(" + x + ");");
+                    else if (quad.getY() == "@c")
+                        line("c0rt_print_char(" + x + ");");
+                    else if (quad.getY() == "@s")
+                        line("c0rt_print_string(\"" + escape(quad.getX().substr(1)) + "\");");
+                    else if (quad.getY() == "@ln")
+                        line("c0rt_print_line();");
+                    break;
+                case QuadOpr::SCN:
+                    line(x + " = c0rt_scan_int();");
+                    break;
+            }
+        }
+    }
+
+    std::optional<std::string> generateC99(const std::vector<Quadruple>& quads, std::ostream& out) {
+        QuadProgram program;
+        if (auto err = analyseFrames(quads, program))
+            return err;
+        if (program.functionIndex.count("main") == 0)
+            return std::string("no main function");
+
+        CEmitter emitter(quads, program, out);
+        emitter.declarations();
+        emitter.function(-1);
+        for (int i = 0; i < (int)program.functions.size(); i++)
+            emitter.function(i);
+        return {};
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "instruction/quadruple.h"
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 把四元式翻译成 C99，用宿主的 C 编译器优化，和 runtime/c0rt.c 一起编译链接，见 readme
+    // 每个函数的栈帧槽（参数、局部变量和临时变量）是一个 int32_t 局部变量 sN，全局变量为 gN；
+    // 标号为 goto 的目标，算术和输入输出调用 runtime/c0rt.h 中的函数，语义和虚拟机相同
+    // 出错时返回错误信息
+    std::optional<std::string> generateC99(const std::vector<Quadruple>& quads, std::ostream& out);
+}
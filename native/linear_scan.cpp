@@ -0,0 +1,180 @@
+#include "linear_scan.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace c0 {
+
+    std::optional<SlotIntervals> slotIntervals(const std::vector<Quadruple>& quads, const QuadProgram& program,
+                                               const QuadFunction& fun) {
+        int n = (int)(fun.end - fun.begin);
+        SlotIntervals result;
+        auto& intervals = result.intervals;
+        result.created.assign(n, -1);
+
+        // 每个槽当前的区间
+        std::vector<int> open(fun.frameSize, -1);
+        for (int k = 0; k < fun.paramSize; k++) {
+            open[k] = k;
+            intervals.push_back({ k, -1, -1, false, -1 });
+        }
+        auto create = [&](int slot, int q) {
+            open[slot] = (int)intervals.size();
+            result.created[q] = (int)intervals.size();
+            intervals.push_back({ slot, q, q, false, -1 });
+        };
+        auto use = [&](const std::string& opr, int q) {
+            auto operand = QuadOperand::parse(opr);
+            if (operand.kind != QuadOperand::Slot)
+                return true;
+            if (operand.value < 0 || operand.value >= fun.frameSize || open[operand.value] < 0)
+                return false;
+            intervals[open[operand.value]].end = q;
+            return true;
+        };
+
+        std::unordered_map<std::string, int> labels;
+        std::vector<std::pair<int, std::string>> jumps;
+        std::vector<int> calls;
+        for (int q = 0; q < n; q++) {
+            const auto& quad = quads[fun.begin + q];
+            int d = fun.depth[q];
+            bool ok = true;
+            switch (quad.getOperation()) {
+                case QuadOpr::LAB:
+                    labels[quad.getX()] = q;
+                    break;
+                case QuadOpr::GOTO: case QuadOpr::BZ: case QuadOpr::BNZ:
+                    jumps.emplace_back(q, quad.getX());
+                    break;
+                case QuadOpr::SWT:
+                    ok = use(quad.getX(), q);
+                    for (const auto& label : switchLabels(quad.getR()))
+                        jumps.emplace_back(q, label);
+                    break;
+                case QuadOpr::PUSH:
+                    ok = use(quad.getX(), q);
+                    create(d, q);
+                    break;
+                case QuadOpr::POP:
+                    for (int k = fun.depth[q + 1]; k < d; k++)
+                        open[k] = -1;
+                    break;
+                case QuadOpr::CAL: {
+                    const auto& callee = program.functions[program.functionIndex.at(quad.getX().substr(1))];
+                    for (int k = d - callee.paramSize; k < d; k++) {
+                        if (open[k] < 0)
+                            return {};
+                        intervals[open[k]].end = q;
+                        open[k] = -1;
+                    }
+                    if (callee.returnsValue)
+                        create(d - callee.paramSize, q);
+                    calls.push_back(q);
+                    break;
+                }
+                case QuadOpr::PRT:
+                case QuadOpr::SCN:
+                    ok = use(quad.getX(), q);
+                    calls.push_back(q);
+                    break;
+                case QuadOpr::FUNC:
+                    break;
+                default:
+                    ok = use(quad.getX(), q) && use(quad.getY(), q) && use(quad.getR(), q);
+                    break;
+            }
+            if (!ok)
+                return {};
+        }
+
+        // 跳转两端之间的栈不能低于跳转处，否则同一个槽在两端是不同的区间
+        std::vector<std::pair<int, int>> edges;
+        for (const auto& jump : jumps) {
+            auto it = labels.find(jump.second);
+            if (it == labels.end())
+                return {};
+            int from = jump.first, to = it->second;
+            for (int q = std::min(from, to); q <= std::max(from, to); q++) {
+                if (fun.depth[q] < fun.depth[from])
+                    return {};
+            }
+            if (to <= from)
+                edges.emplace_back(from, to);
+        }
+
+        // 在循环中存活到回跳目标之后的值要一直存活到回跳处
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto& interval : intervals) {
+                for (const auto& edge : edges) {
+                    if (interval.start < edge.second && edge.second <= interval.end && interval.end < edge.first) {
+                        interval.end = edge.first;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (auto& interval : intervals) {
+            auto call = std::upper_bound(calls.begin(), calls.end(), interval.start);
+            interval.crossesCall = call != calls.end() && *call <= interval.end;
+        }
+        return result;
+    }
+
+    void linearScan(std::vector<LiveInterval>& intervals, int calleeSaved, int total) {
+        std::vector<int> order(intervals.size());
+        for (std::size_t i = 0; i < order.size(); i++)
+            order[i] = (int)i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return intervals[a].start < intervals[b].start;
+        });
+
+        std::vector<bool> free(total, true);
+        std::vector<int> active;
+        for (int i : order) {
+            auto& current = intervals[i];
+            for (auto it = active.begin(); it != active.end();) {
+                if (intervals[*it].end < current.start) {
+                    free[intervals[*it].reg] = true;
+                    it = active.erase(it);
+                } else
+                    it++;
+            }
+
+            // 不跨调用的区间优先使用会被调用改写的寄存器，减少需要保存的寄存器
+            current.reg = -1;
+            if (!current.crossesCall) {
+                for (int r = calleeSaved; r < total && current.reg < 0; r++) {
+                    if (free[r])
+                        current.reg = r;
+                }
+            }
+            for (int r = 0; r < calleeSaved && current.reg < 0; r++) {
+                if (free[r])
+                    current.reg = r;
+            }
+            if (current.reg >= 0) {
+                free[current.reg] = false;
+                active.push_back(i);
+                continue;
+            }
+
+            // 溢出：当前区间和占用可用寄存器的区间中结束最晚的留在栈帧中
+            int spill = -1;
+            for (int a : active) {
+                if (current.crossesCall && intervals[a].reg >= calleeSaved)
+                    continue;
+                if (spill < 0 || intervals[a].end > intervals[spill].end)
+                    spill = a;
+            }
+            if (spill >= 0 && intervals[spill].end > current.end) {
+                current.reg = intervals[spill].reg;
+                intervals[spill].reg = -1;
+                active.erase(std::find(active.begin(), active.end(), spill));
+                active.push_back(i);
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "quad_frame.h"
+
+#include <optional>
+#include <vector>
+
+namespace c0 {
+
+    // 栈帧中一个槽从被压入（或作为参数进入函数）到被弹出之间的一个值
+    // 位置是函数体内四元式的下标
+    class LiveInterval {
+    public:
+        int slot;
+        // 定值的位置，参数为 -1
+        int start;
+        // 最后一次使用的位置，循环中定值、循环后才不再使用的值延长到回跳处
+        int end;
+        // 区间中有调用（CAL、PRT、SCN），只能使用调用后保持不变的寄存器
+        bool crossesCall;
+        // 分配的寄存器编号，-1 表示留在栈帧中
+        int reg;
+    };
+
+    class SlotIntervals {
+    public:
+        // 前 paramSize 个是参数
+        std::vector<LiveInterval> intervals;
+        // created[i] 为第 i 条四元式（PUSH 或有返回值的 CAL）新建的区间，没有时为 -1
+        std::vector<int> created;
+    };
+
+    // 求出函数中每个槽的存活区间
+    // 要求跳转的两端之间栈深度不低于跳转处的深度，即跳转不会离开又回到同一个槽的不同值；
+    // 四元式由 Analyser 生成时总是如此，否则返回空，调用者应把所有槽留在栈帧中
+    std::optional<SlotIntervals> slotIntervals(const std::vector<Quadruple>& quads, const QuadProgram& program,
+                                               const QuadFunction& fun);
+
+    // Poletto & Sarkar 的线性扫描寄存器分配，结果写入 reg
+    // 编号 [0, calleeSaved) 的寄存器在调用后保持不变，[calleeSaved, total) 会被调用改写；
+    // 没有空闲寄存器时溢出结束最晚的区间
+    void linearScan(std::vector<LiveInterval>& intervals, int calleeSaved, int total);
+}
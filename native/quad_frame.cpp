@@ -0,0 +1,126 @@
+#include "quad_frame.h"
+
+namespace c0 {
+
+    QuadOperand QuadOperand::parse(const std::string& opr) {
+        if (opr.empty() || opr[0] == '@')
+            return { Name, 0 };
+        if (opr[0] == '$')
+            return { Immediate, (std::int32_t)std::stol(opr.substr(1)) };
+        if (opr[0] == 'c')
+            return { Global, std::stoi(opr.substr(1)) };
+        if (opr[0] == '#')
+            return { Slot, std::stoi(opr.substr(1)) };
+        return { Slot, std::stoi(opr) };
+    }
+
+    bool branchRelation(const std::vector<Quadruple>& quads, std::size_t branch, QuadOpr& relation) {
+        if (branch == 0)
+            return false;
+        switch (quads[branch - 1].getOperation()) {
+            case QuadOpr::EQU: case QuadOpr::NE: case QuadOpr::LT:
+            case QuadOpr::LE: case QuadOpr::GT: case QuadOpr::GE:
+                relation = quads[branch - 1].getOperation();
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    namespace {
+        std::optional<std::string> computeDepths(const std::vector<Quadruple>& quads, QuadProgram& program,
+                                                 QuadFunction& fun) {
+            std::string where = fun.name.empty() ? ".start" : fun.name;
+            std::size_t n = fun.end - fun.begin;
+            fun.depth.assign(n + 1, 0);
+            // 标号 -> 深度，跳转出现在标号之前时先记下
+            std::unordered_map<std::string, int> labelDepth;
+            int d = fun.paramSize;
+            fun.frameSize = d;
+
+            auto checkLabel = [&](const std::string& label) -> std::optional<std::string> {
+                auto it = labelDepth.emplace(label, d);
+                if (!it.second && it.first->second != d)
+                    return where + ": stack depth differs at label " + label;
+                return {};
+            };
+
+            for (std::size_t i = 0; i < n; i++) {
+                const auto& quad = quads[fun.begin + i];
+                fun.depth[i] = d;
+                switch (quad.getOperation()) {
+                    case QuadOpr::PUSH:
+                        d++;
+                        break;
+                    case QuadOpr::POP:
+                        d -= std::stoi(quad.getX().substr(1));
+                        break;
+                    case QuadOpr::CAL: {
+                        auto it = program.functionIndex.find(quad.getX().substr(1));
+                        if (it == program.functionIndex.end())
+                            return where + ": call to undefined function " + quad.getX().substr(1);
+                        const auto& callee = program.functions[it->second];
+                        d -= callee.paramSize;
+                        if (d < 0)
+                            break;
+                        if (callee.returnsValue)
+                            d++;
+                        break;
+                    }
+                    case QuadOpr::LAB:
+                    case QuadOpr::GOTO:
+                    case QuadOpr::BZ:
+                    case QuadOpr::BNZ:
+                        if (auto err = checkLabel(quad.getX()))
+                            return err;
+                        break;
+                    case QuadOpr::SWT:
+                        for (const auto& label : switchLabels(quad.getR())) {
+                            if (auto err = checkLabel(label))
+                                return err;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                if (d < 0)
+                    return where + ": stack underflow";
+                if (d > fun.frameSize)
+                    fun.frameSize = d;
+            }
+            fun.depth[n] = d;
+            return {};
+        }
+    }
+
+    std::optional<std::string> analyseFrames(const std::vector<Quadruple>& quads, QuadProgram& program) {
+        program.functions.clear();
+        program.functionIndex.clear();
+
+        std::size_t i = 0;
+        for (; i < quads.size() && quads[i].getOperation() != QuadOpr::FUNC; i++)
+            ;
+        program.start = { "", 0, false, 0, i, {}, 0 };
+
+        // 先建立函数表，调用可以出现在被调用函数的定义之前
+        while (i < quads.size()) {
+            QuadFunction fun = { quads[i].getX().substr(1), std::stoi(quads[i].getY().substr(1)), false,
+                                 i + 1, i + 1, {}, 0 };
+            for (i++; i < quads.size() && quads[i].getOperation() != QuadOpr::FUNC; i++) {
+                if (quads[i].getOperation() == QuadOpr::RET && !quads[i].getX().empty())
+                    fun.returnsValue = true;
+            }
+            fun.end = i;
+            program.functionIndex[fun.name] = (int)program.functions.size();
+            program.functions.push_back(std::move(fun));
+        }
+
+        if (auto err = computeDepths(quads, program, program.start))
+            return err;
+        for (auto& fun : program.functions) {
+            if (auto err = computeDepths(quads, program, fun))
+                return err;
+        }
+        return {};
+    }
+}
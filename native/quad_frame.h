@@ -0,0 +1,59 @@
+#pragma once
+
+#include "instruction/quadruple.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace c0 {
+
+    // 四元式的操作数
+    // $n 立即数；cN 全局变量，即 .start 栈中的第 N 个槽；n 和 #n 当前栈帧的第 n 个槽，#n 为临时变量；
+    // 其它（@ 开头的字符串、标号、函数名，或者为空）为 Name
+    class QuadOperand {
+    public:
+        enum Kind { Immediate, Global, Slot, Name };
+
+        Kind kind;
+        std::int32_t value;
+
+        static QuadOperand parse(const std::string& opr);
+    };
+
+    // 一个函数或 .start 的四元式
+    class QuadFunction {
+    public:
+        // 不含 @，.start 为空
+        std::string name;
+        int paramSize;
+        // 函数中有带值的 RET
+        bool returnsValue;
+        // 函数体为 quads[begin, end)，不含 FUNC
+        std::size_t begin;
+        std::size_t end;
+        // depth[i] 为 quads[begin + i] 执行前的栈深度，大小为 end - begin + 1
+        // 和 Analyser 中的 _nextStackIndex 一致：PUSH 加一，POP $n 减 n，CAL 弹出参数，有返回值时再压入返回值
+        std::vector<int> depth;
+        // 栈深度的最大值，.start 的为全局变量的个数
+        int frameSize;
+    };
+
+    class QuadProgram {
+    public:
+        QuadFunction start;
+        std::vector<QuadFunction> functions;
+        // 函数名（不含 @）-> functions 的下标
+        std::unordered_map<std::string, int> functionIndex;
+    };
+
+    // 按 FUNC 划分函数并求出每条四元式处的栈深度，供不经过字节码的后端使用
+    // 调用未定义的函数、栈深度为负或者跳转和标号处的深度不同时返回错误信息
+    std::optional<std::string> analyseFrames(const std::vector<Quadruple>& quads, QuadProgram& program);
+
+    // BZ/BNZ 的比较关系由前一条四元式决定，前一条不是比较时返回 false，和 Generator 一样不跳转
+    bool branchRelation(const std::vector<Quadruple>& quads, std::size_t branch, QuadOpr& relation);
+}
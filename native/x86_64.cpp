@@ -0,0 +1,484 @@
+#include "x86_64.h"
+#include "quad_frame.h"
+#include "linear_scan.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+namespace c0 {
+
+    namespace {
+        // 可分配的寄存器，前 5 个在调用后保持不变，用到时在序言中保存
+        // eax、ecx、edx 留作运算和除法的临时寄存器
+        const char* const registers[] = {
+            "%ebx", "%r12d", "%r13d", "%r14d", "%r15d",
+            "%esi", "%edi", "%r8d", "%r9d", "%r10d", "%r11d",
+        };
+        const char* const savedRegisters[] = { "%rbx", "%r12", "%r13", "%r14", "%r15" };
+        constexpr int calleeSaved = 5;
+        constexpr int registerCount = 11;
+        const char* const argumentRegisters[] = { "%edi", "%esi", "%edx", "%ecx", "%r8d", "%r9d" };
+        constexpr int registerArguments = 6;
+
+        bool isRegister(const std::string& opr) { return opr[0] == '%'; }
+        bool isImmediate(const std::string& opr) { return opr[0] == '$'; }
+        bool isMemory(const std::string& opr) { return !isRegister(opr) && !isImmediate(opr); }
+
+        std::string escape(const std::string& s) {
+            std::string out;
+            for (char c : s) {
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                    out += c;
+                } else if (c >= 0x20 && c < 0x7f)
+                    out += c;
+                else {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\%03o", (unsigned char)c);
+                    out += buf;
+                }
+            }
+            return out;
+        }
+
+        // 比较关系成立（taken）或不成立时跳转的指令
+        std::string conditionalJump(QuadOpr relation, bool taken) {
+            switch (relation) {
+                case QuadOpr::EQU:
+                    return taken ? "je" : "jne";
+                case QuadOpr::NE:
+                    return taken ? "jne" : "je";
+                case QuadOpr::LT:
+                    return taken ? "jl" : "jge";
+                case QuadOpr::LE:
+                    return taken ? "jle" : "jg";
+                case QuadOpr::GT:
+                    return taken ? "jg" : "jle";
+                default:
+                    return taken ? "jge" : "jl";
+            }
+        }
+
+        std::string label(const std::string& name) {
+            return ".Lq" + name.substr(1);
+        }
+
+        class X86Emitter {
+        public:
+            X86Emitter(const std::vector<Quadruple>& quads, const QuadProgram& program, std::ostream& out)
+                : _quads(quads), _program(program), _out(out) {}
+
+            // funcId 为 -1 时输出 .start
+            void function(int funcId);
+            void data();
+
+        private:
+            const std::vector<Quadruple>& _quads;
+            const QuadProgram& _program;
+            std::ostream& _out;
+            std::unordered_map<std::string, int> _strings;
+            std::vector<std::string> _stringList;
+            int _unique = 0;
+
+            // 当前函数
+            const QuadFunction* _fun = nullptr;
+            int _id = 0;
+            std::string _exit;
+            std::string _divisionByZero;
+            bool _divides = false;
+            std::vector<LiveInterval> _intervals;
+            std::vector<int> _created;
+            // 每个槽当前的区间，没有分配寄存器时为空
+            std::vector<int> _current;
+            int _saved = 0;
+
+            void line(const std::string& text) { _out << '\t' << text << '\n'; }
+            void move(const std::string& src, const std::string& dst);
+            void arguments();
+            std::string global(int slot) { return "c0_globals+" + std::to_string(4 * slot) + "(%rip)"; }
+            std::string slot(int k);
+            std::string operand(const std::string& opr);
+            std::string string(const std::string& s);
+            void quad(int q);
+            void arithmetic(const std::string& op, bool commutative, const Quadruple& quad);
+            void divide(const Quadruple& quad);
+            bool overwritten(int q, int k) const;
+        };
+
+        void X86Emitter::move(const std::string& src, const std::string& dst) {
+            if (src == dst)
+                return;
+            if (isMemory(src) && isMemory(dst)) {
+                line("movl " + src + ", %eax");
+                line("movl %eax, " + dst);
+            } else
+                line("movl " + src + ", " + dst);
+        }
+
+        std::string X86Emitter::slot(int k) {
+            if (_id < 0)
+                return global(k);
+            if (!_intervals.empty() && _current[k] >= 0 && _intervals[_current[k]].reg >= 0)
+                return registers[_intervals[_current[k]].reg];
+            return "-" + std::to_string(8 * _saved + 4 * (k + 1)) + "(%rbp)";
+        }
+
+        std::string X86Emitter::operand(const std::string& opr) {
+            auto parsed = QuadOperand::parse(opr);
+            switch (parsed.kind) {
+                case QuadOperand::Immediate:
+                    return "$" + std::to_string(parsed.value);
+                case QuadOperand::Global:
+                    return global(parsed.value);
+                case QuadOperand::Slot:
+                    return slot(parsed.value);
+                default:
+                    return "$0";
+            }
+        }
+
+        std::string X86Emitter::string(const std::string& s) {
+            auto it = _strings.emplace(s, (int)_stringList.size());
+            if (it.second)
+                _stringList.push_back(s);
+            return ".Lstr" + std::to_string(it.first->second);
+        }
+
+        // 参数从寄存器和调用者的栈移到各自的位置
+        // 目的寄存器可能是另一个参数所在的寄存器，按依赖顺序移动，成环时经过 eax
+        void X86Emitter::arguments() {
+            std::vector<std::pair<std::string, std::string>> moves;
+            for (int k = 0; k < _fun->paramSize && k < registerArguments; k++) {
+                if (slot(k) != argumentRegisters[k])
+                    moves.emplace_back(argumentRegisters[k], slot(k));
+            }
+            while (!moves.empty()) {
+                bool moved = false;
+                for (std::size_t i = 0; i < moves.size() && !moved; i++) {
+                    bool blocked = false;
+                    for (std::size_t j = 0; j < moves.size(); j++)
+                        blocked = blocked || (j != i && moves[j].first == moves[i].second);
+                    if (!blocked) {
+                        move(moves[i].first, moves[i].second);
+                        moves.erase(moves.begin() + i);
+                        moved = true;
+                    }
+                }
+                if (!moved) {
+                    auto src = moves[0].first;
+                    move(src, "%eax");
+                    for (auto& m : moves) {
+                        if (m.first == src)
+                            m.first = "%eax";
+                    }
+                }
+            }
+            for (int k = registerArguments; k < _fun->paramSize; k++)
+                move(std::to_string(16 + 8 * (k - registerArguments)) + "(%rbp)", slot(k));
+        }
+
+        void X86Emitter::function(int funcId) {
+            _id = funcId;
+            _fun = funcId < 0 ? &_program.start : &_program.functions[funcId];
+            std::string suffix = funcId < 0 ? "_start" : std::to_string(funcId);
+            _exit = ".Lret" + suffix;
+            _divisionByZero = ".Ldivzero" + suffix;
+            _divides = false;
+            int n = (int)(_fun->end - _fun->begin);
+
+            // .start 的槽就是全局变量，不分配寄存器
+            _intervals.clear();
+            _created.clear();
+            _current.assign(_fun->frameSize, -1);
+            if (funcId >= 0) {
+                if (auto slots = slotIntervals(_quads, _program, *_fun)) {
+                    _intervals = std::move(slots->intervals);
+                    _created = std::move(slots->created);
+                    linearScan(_intervals, calleeSaved, registerCount);
+                    for (int k = 0; k < _fun->paramSize; k++)
+                        _current[k] = k;
+                }
+            }
+            std::vector<bool> used(calleeSaved, false);
+            for (const auto& interval : _intervals) {
+                if (interval.reg >= 0 && interval.reg < calleeSaved)
+                    used[interval.reg] = true;
+            }
+            _saved = (int)std::count(used.begin(), used.end(), true);
+
+            std::string symbol = funcId < 0 ? "c0_start" : "c0f_" + _fun->name;
+            _out << "\n\t.globl " << symbol << "\n\t.type " << symbol << ", @function\n" << symbol << ":\n";
+            line("pushq %rbp");
+            line("movq %rsp, %rbp");
+            for (int r = 0; r < calleeSaved; r++) {
+                if (used[r])
+                    line(std::string("pushq ") + savedRegisters[r]);
+            }
+            // 只为留在栈帧中的槽分配空间，调用时 rsp 按 16 字节对齐
+            int slots = 0;
+            if (funcId >= 0 && _intervals.empty())
+                slots = 4 * _fun->frameSize;
+            for (const auto& interval : _intervals) {
+                if (interval.reg < 0)
+                    slots = std::max(slots, 4 * (interval.slot + 1));
+            }
+            int frame = (8 * _saved + slots + 15) / 16 * 16 - 8 * _saved;
+            if (frame > 0)
+                line("subq $" + std::to_string(frame) + ", %rsp");
+            arguments();
+
+            for (int q = 0; q < n; q++)
+                quad(q);
+
+            if (funcId >= 0) {
+                // 执行到末尾没有返回
+                line("leaq .Lname" + suffix + "(%rip), %rdi");
+                line("call c0rt_fall_off");
+            }
+            _out << _exit << ":\n";
+            if (_saved > 0) {
+                line("leaq -" + std::to_string(8 * _saved) + "(%rbp), %rsp");
+                for (int r = calleeSaved - 1; r >= 0; r--) {
+                    if (used[r])
+                        line(std::string("popq ") + savedRegisters[r]);
+                }
+            } else
+                line("movq %rbp, %rsp");
+            line("popq %rbp");
+            line("ret");
+            if (_divides) {
+                _out << _divisionByZero << ":\n";
+                line("call c0rt_division_by_zero");
+            }
+            _out << "\t.size " << symbol << ", .-" << symbol << "\n";
+        }
+
+        void X86Emitter::arithmetic(const std::string& op, bool commutative, const Quadruple& quad) {
+            auto x = operand(quad.getX()), y = operand(quad.getY()), r = operand(quad.getR());
+            if (isRegister(r) && r != y) {
+                move(x, r);
+                line(op + " " + y + ", " + r);
+            } else if (isRegister(r) && commutative)
+                line(op + " " + x + ", " + r);
+            else {
+                move(x, "%eax");
+                line(op + " " + y + ", %eax");
+                move("%eax", r);
+            }
+        }
+
+        void X86Emitter::divide(const Quadruple& quad) {
+            auto x = operand(quad.getX()), y = operand(quad.getY()), r = operand(quad.getR());
+            auto divisor = QuadOperand::parse(quad.getY());
+            bool constant = divisor.kind == QuadOperand::Immediate;
+            if (constant && divisor.value == 0) {
+                _divides = true;
+                line("jmp " + _divisionByZero);
+                return;
+            }
+            line("movl " + y + ", %ecx");
+            move(x, "%eax");
+            if (constant && divisor.value == -1)
+                line("negl %eax");
+            else if (constant) {
+                line("cltd");
+                line("idivl %ecx");
+            } else {
+                // 除数为 -1 时取负，避免 INT_MIN / -1 溢出
+                _divides = true;
+                std::string negate = ".Lneg" + std::to_string(_unique), done = ".Ldiv" + std::to_string(_unique);
+                _unique++;
+                line("testl %ecx, %ecx");
+                line("je " + _divisionByZero);
+                line("cmpl $-1, %ecx");
+                line("je " + negate);
+                line("cltd");
+                line("idivl %ecx");
+                line("jmp " + done);
+                _out << negate << ":\n";
+                line("negl %eax");
+                _out << done << ":\n";
+            }
+            move("%eax", r);
+        }
+
+        // 第 q 条四元式写入槽 k 并且不读它
+        bool X86Emitter::overwritten(int q, int k) const {
+            if (q >= (int)(_fun->end - _fun->begin))
+                return false;
+            const auto& quad = _quads[_fun->begin + q];
+            switch (quad.getOperation()) {
+                case QuadOpr::ASN: case QuadOpr::NEG:
+                case QuadOpr::ADD: case QuadOpr::SUB: case QuadOpr::MUL: case QuadOpr::DIV: {
+                    auto written = QuadOperand::parse(quad.getR());
+                    auto x = QuadOperand::parse(quad.getX()), y = QuadOperand::parse(quad.getY());
+                    auto reads = [&](const QuadOperand& opr) { return opr.kind == QuadOperand::Slot && opr.value == k; };
+                    return reads(written) && !reads(x) && !reads(y);
+                }
+                default:
+                    return false;
+            }
+        }
+
+        void X86Emitter::quad(int q) {
+            const auto& quad = _quads[_fun->begin + q];
+            int d = _fun->depth[q];
+            auto create = [&] {
+                if (!_intervals.empty() && _created[q] >= 0)
+                    _current[_intervals[_created[q]].slot] = _created[q];
+            };
+
+            switch (quad.getOperation()) {
+                case QuadOpr::ASN:
+                    move(operand(quad.getX()), operand(quad.getR()));
+                    break;
+                case QuadOpr::NEG: {
+                    auto r = operand(quad.getR());
+                    move(operand(quad.getX()), r);
+                    line("negl " + r);
+                    break;
+                }
+                case QuadOpr::ADD:
+                    arithmetic("addl", true, quad);
+                    break;
+                case QuadOpr::SUB:
+                    arithmetic("subl", false, quad);
+                    break;
+                case QuadOpr::MUL:
+                    arithmetic("imull", true, quad);
+                    break;
+                case QuadOpr::DIV:
+                    divide(quad);
+                    break;
+
+                case QuadOpr::LAB:
+                    _out << label(quad.getX()) << ":\n";
+                    break;
+                case QuadOpr::FUNC:
+                    break;
+                case QuadOpr::PUSH: {
+                    auto src = operand(quad.getX());
+                    create();
+                    // 新的临时变量紧接着被整体写入时不需要初始化
+                    if (quad.getX() != "$0" || !overwritten(q + 1, d))
+                        move(src, slot(d));
+                    break;
+                }
+                case QuadOpr::POP:
+                    break;
+                case QuadOpr::CAL: {
+                    int id = _program.functionIndex.at(quad.getX().substr(1));
+                    const auto& callee = _program.functions[id];
+                    int base = d - callee.paramSize;
+                    int stacked = std::max(0, callee.paramSize - registerArguments);
+                    int pad = stacked % 2 ? 8 : 0;
+                    if (pad)
+                        line("subq $8, %rsp");
+                    for (int i = callee.paramSize - 1; i >= registerArguments; i--) {
+                        move(slot(base + i), "%eax");
+                        line("pushq %rax");
+                    }
+                    for (int i = 0; i < callee.paramSize && i < registerArguments; i++)
+                        move(slot(base + i), argumentRegisters[i]);
+                    line("call c0f_" + callee.name);
+                    if (stacked > 0)
+                        line("addq $" + std::to_string(8 * stacked + pad) + ", %rsp");
+                    if (callee.returnsValue) {
+                        create();
+                        move("%eax", slot(base));
+                    }
+                    break;
+                }
+                case QuadOpr::RET:
+                    if (!quad.getX().empty())
+                        move(operand(quad.getX()), "%eax");
+                    line("jmp " + _exit);
+                    break;
+
+                case QuadOpr::EQU: case QuadOpr::NE: case QuadOpr::LT:
+                case QuadOpr::LE: case QuadOpr::GT: case QuadOpr::GE: {
+                    // 只设置标志位，由之后的 BZ/BNZ 跳转
+                    auto x = operand(quad.getX()), y = operand(quad.getY());
+                    if (isImmediate(x) || (isMemory(x) && isMemory(y))) {
+                        move(x, "%eax");
+                        x = "%eax";
+                    }
+                    line("cmpl " + y + ", " + x);
+                    break;
+                }
+                case QuadOpr::GOTO:
+                    line("jmp " + label(quad.getX()));
+                    break;
+                case QuadOpr::BNZ:
+                case QuadOpr::BZ: {
+                    QuadOpr relation;
+                    if (branchRelation(_quads, _fun->begin + q, relation))
+                        line(conditionalJump(relation, quad.getOperation() == QuadOpr::BNZ) + " " + label(quad.getX()));
+                    break;
+                }
+                case QuadOpr::SWT: {
+                    // 表中是各个标号相对表头的偏移，放在只读数据段
+                    auto targets = switchLabels(quad.getR());
+                    std::string table = ".Lsw" + std::to_string(_unique++);
+                    move(operand(quad.getX()), "%eax");
+                    line("subl " + quad.getY() + ", %eax");
+                    line("cmpl $" + std::to_string(targets.size() - 1) + ", %eax");
+                    line("jae " + label(targets.back()));
+                    line("leaq " + table + "(%rip), %rcx");
+                    line("movslq (%rcx,%rax,4), %rax");
+                    line("addq %rcx, %rax");
+                    line("jmp *%rax");
+                    _out << "\t.section .rodata\n\t.align 4\n" << table << ":\n";
+                    for (std::size_t k = 0; k + 1 < targets.size(); k++)
+                        line(".long " + label(targets[k]) + "-" + table);
+                    _out << "\t.text\n";
+                    break;
+                }
+
+                case QuadOpr::PRT:
+                    if (quad.getY() == "@i" || quad.getY() == "@c") {
+                        move(operand(quad.getX()), "%edi");
+                        line(quad.getY() == "@i" ? "call c0rt_print_int" : "call c0rt_print_char");
+                    } else if (quad.getY() == "@s") {
+                        line("leaq " + string(quad.getX().substr(1)) + "(%rip), %rdi");
+                        line("call c0rt_print_string");
+                    } else if (quad.getY() == "@ln")
+                        line("call c0rt_print_line");
+                    break;
+                case QuadOpr::SCN:
+                    line("call c0rt_scan_int");
+                    move("%eax", operand(quad.getX()));
+                    break;
+            }
+        }
+
+        void X86Emitter::data() {
+            _out << "\n\t.section .rodata\n";
+            for (std::size_t i = 0; i < _stringList.size(); i++)
+                _out << ".Lstr" << i << ":\n\t.string \"" << escape(_stringList[i]) << "\"\n";
+            for (std::size_t i = 0; i < _program.functions.size(); i++)
+                _out << ".Lname" << i << ":\n\t.string \"" << escape(_program.functions[i].name) << "\"\n";
+
+            _out << "\n\t.bss\n\t.align 4\nc0_globals:\n";
+            _out << "\t.zero " << 4 * std::max(1, _program.start.frameSize) << "\n";
+            _out << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+        }
+    }
+
+    std::optional<std::string> generateX86_64(const std::vector<Quadruple>& quads, std::ostream& out) {
+        QuadProgram program;
+        if (auto err = analyseFrames(quads, program))
+            return err;
+        if (program.functionIndex.count("main") == 0)
+            return std::string("no main function");
+
+        out << "# generated by cc0\n\t.text\n";
+        X86Emitter emitter(quads, program, out);
+        emitter.function(-1);
+        for (int i = 0; i < (int)program.functions.size(); i++)
+            emitter.function(i);
+        emitter.data();
+        return {};
+    }
+}
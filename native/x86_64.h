@@ -0,0 +1,18 @@
+#pragma once
+
+#include "instruction/quadruple.h"
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 把四元式翻译成 GNU as 的 x86-64 汇编（AT&T 语法，System V 调用约定）
+    // 和 runtime/c0rt.c 一起汇编链接成可执行文件，见 readme
+    // C0 函数 f 的符号为 c0f_f，参数和返回值按 C 的 int 传递；.start 为 c0_start，全局变量在 c0_globals 中
+    // 栈帧中的槽（参数、局部变量和临时变量）用线性扫描分配到寄存器，分配不到的留在栈帧中
+    // 出错时返回错误信息
+    std::optional<std::string> generateX86_64(const std::vector<Quadruple>& quads, std::ostream& out);
+}
@@ -0,0 +1,121 @@
+#include "fold.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+
+namespace c0 {
+    inline bool isImmediate(const std::string& opr) {
+        return !opr.empty() && opr[0] == '$';
+    }
+
+    inline std::int64_t immediate(const std::string& opr) {
+        return std::stoll(opr.substr(1));
+    }
+
+    // C0 的 int 是 32 位补码，溢出时回绕
+    inline std::string wrapImmediate(std::int64_t v) {
+        return "$" + std::to_string((std::int32_t)(std::uint32_t)v);
+    }
+
+    std::optional<std::string> foldArithmetic(QuadOpr opr, std::int64_t x, std::int64_t y) {
+        switch (opr) {
+            case QuadOpr::ADD:
+                return wrapImmediate(x + y);
+            case QuadOpr::SUB:
+                return wrapImmediate(x - y);
+            case QuadOpr::MUL:
+                return wrapImmediate(x * y);
+            case QuadOpr::DIV:
+                // leave runtime errors to the runtime
+                if (y == 0 || (x == INT32_MIN && y == -1))
+                    return {};
+                return wrapImmediate(x / y);
+            default:
+                return {};
+        }
+    }
+
+    std::optional<bool> foldRelation(QuadOpr opr, std::int64_t x, std::int64_t y) {
+        switch (opr) {
+            case QuadOpr::EQU:
+                return x == y;
+            case QuadOpr::NE:
+                return x != y;
+            case QuadOpr::LT:
+                return x < y;
+            case QuadOpr::LE:
+                return x <= y;
+            case QuadOpr::GT:
+                return x > y;
+            case QuadOpr::GE:
+                return x >= y;
+            default:
+                return {};
+        }
+    }
+
+    void FoldPass::runOnQuads(std::vector<Quadruple>& quads) {
+        std::vector<Quadruple> folded;
+        folded.reserve(quads.size());
+
+        for (std::size_t i = 0; i < quads.size(); i++) {
+            const auto& quad = quads[i];
+            auto opr = quad.getOperation();
+
+            switch (opr) {
+                case QuadOpr::NEG:
+                    if (isImmediate(quad.getX())) {
+                        folded.emplace_back(QuadOpr::ASN, wrapImmediate(-immediate(quad.getX())), "", quad.getR());
+                        continue;
+                    }
+                    break;
+
+                case QuadOpr::ADD:
+                case QuadOpr::SUB:
+                case QuadOpr::MUL:
+                case QuadOpr::DIV:
+                    if (isImmediate(quad.getX()) && isImmediate(quad.getY())) {
+                        auto v = foldArithmetic(opr, immediate(quad.getX()), immediate(quad.getY()));
+                        if (v.has_value()) {
+                            folded.emplace_back(QuadOpr::ASN, v.value(), "", quad.getR());
+                            continue;
+                        }
+                    }
+                    break;
+
+                case QuadOpr::EQU:
+                case QuadOpr::NE:
+                case QuadOpr::LT:
+                case QuadOpr::LE:
+                case QuadOpr::GT:
+                case QuadOpr::GE:
+                    if (isImmediate(quad.getX()) && isImmediate(quad.getY()) && i + 1 < quads.size()
+                        && (quads[i + 1].getOperation() == QuadOpr::BZ || quads[i + 1].getOperation() == QuadOpr::BNZ)) {
+                        bool cond = foldRelation(opr, immediate(quad.getX()), immediate(quad.getY())).value();
+                        const auto& branch = quads[++i];
+                        // BZ 在条件不满足时跳转，BNZ 在条件满足时跳转
+                        if (cond == (branch.getOperation() == QuadOpr::BNZ))
+                            folded.emplace_back(QuadOpr::GOTO, branch.getX());
+                        continue;
+                    }
+                    break;
+
+                case QuadOpr::SWT:
+                    if (isImmediate(quad.getX())) {
+                        auto targets = switchLabels(quad.getR());
+                        std::uint32_t k = (std::uint32_t)immediate(quad.getX()) - (std::uint32_t)immediate(quad.getY());
+                        folded.emplace_back(QuadOpr::GOTO, targets[std::min<std::size_t>(k, targets.size() - 1)]);
+                        continue;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+            folded.push_back(quad);
+        }
+
+        quads.swap(folded);
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "optimizer/pass.h"
+
+namespace c0 {
+
+    // 常量折叠
+    // 两个操作数都是立即数的运算改写为 ASN，
+    // 两个操作数都是立即数的比较连同其后的 BZ/BNZ 改写为 GOTO 或直接删除，
+    // 按立即数跳转的 SWT 改写为 GOTO
+    class FoldPass final : public Pass {
+    public:
+        std::string name() const override { return "fold"; }
+        Level level() const override { return QuadLevel; }
+
+        void runOnQuads(std::vector<Quadruple>&) override;
+    };
+}
@@ -0,0 +1,172 @@
+#include "inline.h"
+#include "native/quad_frame.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace c0 {
+    namespace {
+        // 没有剖析数据时内联的函数体的最大四元式数
+        constexpr std::size_t smallCallee = 12;
+        // 热点调用点内联的函数体的最大四元式数
+        constexpr std::size_t hotCallee = 80;
+        // 调用次数至少占所有调用的 1/hotShare 时为热点
+        constexpr std::uint64_t hotShare = 100;
+        // 内联后的四元式数不超过原来的 growthLimit 倍
+        constexpr std::size_t growthLimit = 2;
+
+        // 栈帧槽平移 base，其它操作数不变
+        std::string shift(const std::string& opr, int base) {
+            auto parsed = QuadOperand::parse(opr);
+            if (parsed.kind != QuadOperand::Slot)
+                return opr;
+            return (opr[0] == '#' ? "#" : "") + std::to_string(parsed.value + base);
+        }
+
+        bool isLabelOperand(QuadOpr opr) {
+            return opr == QuadOpr::LAB || opr == QuadOpr::GOTO || opr == QuadOpr::BZ || opr == QuadOpr::BNZ;
+        }
+
+        class Inliner {
+        public:
+            explicit Inliner(const std::vector<Quadruple>& quads) : _quads(quads) {
+                for (const auto& quad : quads) {
+                    if (quad.getOperation() == QuadOpr::LAB)
+                        _nextLabel = std::max(_nextLabel, std::stoi(quad.getX().substr(1)) + 1);
+                }
+            }
+
+            // 把 callee 展开到 out 的末尾，base 为第一个参数的槽，site 为调用点的四元式
+            void expand(std::vector<Quadruple>& out, const QuadFunction& callee, int base, const Quadruple& site);
+
+        private:
+            const std::vector<Quadruple>& _quads;
+            int _nextLabel = 0;
+
+            std::string newLabel() { return "@" + std::to_string(_nextLabel++); }
+        };
+
+        void Inliner::expand(std::vector<Quadruple>& out, const QuadFunction& callee, int base, const Quadruple& site) {
+            std::unordered_map<std::string, std::string> labels;
+            auto label = [&](const std::string& name) {
+                auto it = labels.find(name);
+                if (it == labels.end())
+                    it = labels.emplace(name, newLabel()).first;
+                return it->second;
+            };
+            std::string end = newLabel();
+            // 调用之后留在栈上的返回值
+            int keep = callee.returnsValue ? 1 : 0;
+            std::uint64_t entry = _quads[callee.begin].getCount();
+
+            auto emit = [&](Quadruple quad, const Quadruple& from) {
+                quad.setLine(from.getLine());
+                if (entry > 0) {
+                    quad.setCount((std::uint64_t)((long double)from.getCount() * site.getCount() / entry));
+                    quad.setTaken((std::uint64_t)((long double)from.getTaken() * site.getCount() / entry));
+                }
+                out.push_back(std::move(quad));
+            };
+            // 把相对于 base 的栈深度从 from 调整到 to
+            auto adjust = [&](int from, int to, const Quadruple& at) {
+                if (from > to)
+                    emit(Quadruple(QuadOpr::POP, "$" + std::to_string(from - to)), at);
+                for (int k = from; k < to; k++)
+                    emit(Quadruple(QuadOpr::PUSH, "$0"), at);
+            };
+
+            for (std::size_t i = callee.begin; i < callee.end; i++) {
+                const auto& quad = _quads[i];
+                int d = callee.depth[i - callee.begin];
+                if (isLabelOperand(quad.getOperation())) {
+                    // 循环开头的 LAB 的 y、r 也是标号
+                    bool loop = quad.getOperation() == QuadOpr::LAB && !quad.getY().empty();
+                    emit(Quadruple(quad.getOperation(), label(quad.getX()), loop ? label(quad.getY()) : quad.getY(),
+                                   loop ? label(quad.getR()) : quad.getR()), quad);
+                    continue;
+                }
+                if (quad.getOperation() == QuadOpr::SWT) {
+                    auto targets = switchLabels(quad.getR());
+                    for (auto& target : targets)
+                        target = label(target);
+                    emit(Quadruple(QuadOpr::SWT, shift(quad.getX(), base), quad.getY(), joinLabels(targets)), quad);
+                    continue;
+                }
+                if (quad.getOperation() != QuadOpr::RET) {
+                    emit(Quadruple(quad.getOperation(), shift(quad.getX(), base), shift(quad.getY(), base),
+                                   shift(quad.getR(), base)), quad);
+                    continue;
+                }
+
+                // 返回值写到第一个参数的槽，栈中只留下它
+                if (keep && d >= 1) {
+                    emit(Quadruple(QuadOpr::ASN, shift(quad.getX(), base), "", std::to_string(base)), quad);
+                    adjust(d, keep, quad);
+                } else if (keep) {
+                    emit(Quadruple(QuadOpr::PUSH, shift(quad.getX(), base)), quad);
+                } else
+                    adjust(d, 0, quad);
+                emit(Quadruple(QuadOpr::GOTO, end), quad);
+                // 之后的四元式不可达，恢复原来的栈深度，使栈深度仍然可以顺序求出
+                adjust(keep, d, quad);
+            }
+            adjust(callee.depth.back(), keep, site);
+            emit(Quadruple(QuadOpr::LAB, end), site);
+        }
+    }
+
+    void InlinePass::runOnQuads(std::vector<Quadruple>& quads) {
+        QuadProgram program;
+        if (analyseFrames(quads, program))
+            return;
+
+        std::uint64_t totalCalls = 0;
+        for (const auto& quad : quads) {
+            if (quad.getOperation() == QuadOpr::CAL)
+                totalCalls += quad.getCount();
+        }
+        bool profiled = totalCalls > 0;
+
+        std::vector<bool> recursive(program.functions.size(), false);
+        for (std::size_t f = 0; f < program.functions.size(); f++) {
+            const auto& fun = program.functions[f];
+            for (std::size_t i = fun.begin; i < fun.end; i++) {
+                if (quads[i].getOperation() == QuadOpr::CAL && quads[i].getX().substr(1) == fun.name)
+                    recursive[f] = true;
+            }
+        }
+
+        auto shouldInline = [&](const Quadruple& site, std::size_t caller, std::size_t callee) {
+            std::size_t size = program.functions[callee].end - program.functions[callee].begin;
+            if (callee == caller || recursive[callee])
+                return false;
+            if (profiled)
+                return site.getCount() > 0 && site.getCount() * hotShare >= totalCalls && size <= hotCallee;
+            return size <= smallCallee;
+        };
+
+        Inliner inliner(quads);
+        std::vector<Quadruple> out;
+        out.reserve(quads.size());
+        std::size_t limit = quads.size() * growthLimit;
+        out.insert(out.end(), quads.begin(), quads.begin() + program.start.end);
+        for (std::size_t f = 0; f < program.functions.size(); f++) {
+            const auto& fun = program.functions[f];
+            // FUNC
+            out.push_back(quads[fun.begin - 1]);
+            for (std::size_t i = fun.begin; i < fun.end; i++) {
+                const auto& quad = quads[i];
+                if (quad.getOperation() == QuadOpr::CAL) {
+                    std::size_t callee = program.functionIndex.at(quad.getX().substr(1));
+                    const auto& target = program.functions[callee];
+                    if (shouldInline(quad, f, callee) && out.size() + 2 * (target.end - target.begin) <= limit) {
+                        inliner.expand(out, target, fun.depth[i - fun.begin] - target.paramSize, quad);
+                        continue;
+                    }
+                }
+                out.push_back(quad);
+            }
+        }
+        quads.swap(out);
+    }
+}
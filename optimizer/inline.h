@@ -0,0 +1,20 @@
+#pragma once
+
+#include "optimizer/pass.h"
+
+namespace c0 {
+
+    // 函数内联
+    // 调用点 PUSH a1 ... PUSH an; CAL f 压入的 n 个槽就是 f 的参数，把 CAL 换成 f 的函数体：
+    // f 的栈帧槽平移到第一个参数的位置，标号换成新的标号，RET 换成把返回值写到第一个参数的槽、
+    // 弹出其余的槽并跳到函数体之后，和 CAL 之后的栈深度一致
+    // 有剖析数据时（--profile-use）只内联执行次数多的调用点，并按调用点的次数缩放内联进来的四元式的次数；
+    // 没有剖析数据时只内联很小的函数。不内联递归函数，也不内联到 .start 中
+    class InlinePass final : public Pass {
+    public:
+        std::string name() const override { return "inline"; }
+        Level level() const override { return QuadLevel; }
+
+        void runOnQuads(std::vector<Quadruple>&) override;
+    };
+}
@@ -0,0 +1,334 @@
+#include "layout.h"
+#include "optimizer/profile_data.h"
+#include "native/quad_frame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace c0 {
+    namespace {
+        // 静态估计时每层循环中的块的相对频率
+        constexpr double loopWeight = 8;
+        // 静态估计时回到循环开头、留在循环中的一边的概率
+        constexpr double loopLikely = 0.9;
+        // 静态估计时不直接返回的一边、比较相等不成立的一边的概率
+        constexpr double returnLikely = 0.75;
+        constexpr double unequalLikely = 0.75;
+
+        bool isBranch(QuadOpr opr) {
+            return opr == QuadOpr::BZ || opr == QuadOpr::BNZ;
+        }
+
+        // 执行后不会顺序执行到下一块
+        bool isTerminator(QuadOpr opr) {
+            return opr == QuadOpr::GOTO || opr == QuadOpr::SWT || opr == QuadOpr::RET;
+        }
+
+        class Edge {
+        public:
+            int from;
+            int to;
+            double weight;
+            // 原来的布局中就是顺序执行
+            bool fallThrough;
+        };
+
+        class Layout {
+        public:
+            Layout(const std::vector<Quadruple>& quads, const QuadFunction& fun, int& nextLabel)
+                : _quads(quads), _fun(fun), _nextLabel(nextLabel) {}
+
+            // 把重新布局的函数体追加到 out，无法布局时原样追加
+            void run(std::vector<Quadruple>& out);
+
+        private:
+            const std::vector<Quadruple>& _quads;
+            const QuadFunction& _fun;
+            int& _nextLabel;
+
+            std::vector<QuadBlock> _blocks;
+            // 顺序执行的后继和跳转目标，没有时为 -1；前一条不是比较的 BZ/BNZ 不跳转，没有跳转目标
+            std::vector<int> _fall;
+            std::vector<int> _target;
+            // 以 SWT 结尾的块可能跳到的块，不重复
+            std::vector<std::vector<int>> _cases;
+
+            bool buildGraph();
+            std::vector<Edge> profiledEdges() const;
+            std::vector<Edge> staticEdges() const;
+            std::vector<int> placeChains(std::vector<Edge> edges) const;
+            void emit(const std::vector<int>& order, std::vector<Quadruple>& out);
+
+            int depthBefore(std::size_t i) const { return _fun.depth[i - _fun.begin]; }
+            const Quadruple& last(int b) const { return _quads[_blocks[b].last]; }
+            bool terminates(int b) const { return isTerminator(last(b).getOperation()); }
+        };
+
+        bool Layout::buildGraph() {
+            _blocks = quadBlocks(_quads, _fun.begin, _fun.end);
+            int n = (int)_blocks.size();
+            std::unordered_map<std::string, int> labelBlock;
+            for (int b = 0; b < n; b++) {
+                if (_quads[_blocks[b].first].getOperation() == QuadOpr::LAB)
+                    labelBlock[_quads[_blocks[b].first].getX()] = b;
+            }
+
+            _fall.assign(n, -1);
+            _target.assign(n, -1);
+            _cases.assign(n, {});
+            for (int b = 0; b < n; b++) {
+                auto opr = last(b).getOperation();
+                if (!isTerminator(opr) && b + 1 < n)
+                    _fall[b] = b + 1;
+                if (opr == QuadOpr::SWT) {
+                    for (const auto& label : switchLabels(last(b).getR())) {
+                        auto it = labelBlock.find(label);
+                        if (it == labelBlock.end())
+                            return false;
+                        if (std::find(_cases[b].begin(), _cases[b].end(), it->second) == _cases[b].end())
+                            _cases[b].push_back(it->second);
+                    }
+                }
+                QuadOpr relation;
+                if (opr == QuadOpr::GOTO || (isBranch(opr) && branchRelation(_quads, _blocks[b].last, relation))) {
+                    auto it = labelBlock.find(last(b).getX());
+                    if (it == labelBlock.end())
+                        return false;
+                    _target[b] = it->second;
+                }
+            }
+            return true;
+        }
+
+        // 边的权重为执行次数
+        std::vector<Edge> Layout::profiledEdges() const {
+            std::vector<Edge> edges;
+            for (int b = 0; b < (int)_blocks.size(); b++) {
+                std::uint64_t count = last(b).getCount();
+                std::uint64_t taken = 0;
+                if (_target[b] != -1)
+                    taken = isBranch(last(b).getOperation()) ? std::min(last(b).getTaken(), count) : count;
+                if (_target[b] != -1)
+                    edges.push_back({ b, _target[b], (double)taken, false });
+                if (_fall[b] != -1)
+                    edges.push_back({ b, _fall[b], (double)(count - taken), true });
+                // 没有记录每一项的次数，平均分给各个目标
+                for (int c : _cases[b])
+                    edges.push_back({ b, c, (double)count / _cases[b].size(), false });
+            }
+            return edges;
+        }
+
+        // 块的频率按所在的循环层数估计，不可达的块为 0
+        // 跳回前面的块的边看作循环的回边，回边的目标到跳转之间的块都在循环中
+        // 条件跳转的概率依次按回边、离开循环、直接返回和比较相等的启发式估计（Ball-Larus）
+        std::vector<Edge> Layout::staticEdges() const {
+            int n = (int)_blocks.size();
+            std::vector<bool> reachable(n, false);
+            std::vector<int> work = { 0 };
+            reachable[0] = true;
+            while (!work.empty()) {
+                int b = work.back();
+                work.pop_back();
+                auto successors = _cases[b];
+                successors.push_back(_fall[b]);
+                successors.push_back(_target[b]);
+                for (int s : successors) {
+                    if (s != -1 && !reachable[s]) {
+                        reachable[s] = true;
+                        work.push_back(s);
+                    }
+                }
+            }
+
+            std::vector<int> loopDepth(n, 0);
+            for (int b = 0; b < n; b++) {
+                if (reachable[b] && _target[b] != -1 && _target[b] <= b) {
+                    for (int k = _target[b]; k <= b; k++)
+                        loopDepth[k]++;
+                }
+            }
+            auto returns = [&](int b) { return last(b).getOperation() == QuadOpr::RET; };
+            auto relation = [&](int b) {
+                QuadOpr opr = QuadOpr::LAB;
+                branchRelation(_quads, _blocks[b].last, opr);
+                return opr;
+            };
+
+            std::vector<Edge> edges;
+            for (int b = 0; b < n; b++) {
+                double freq = reachable[b] ? std::pow(loopWeight, loopDepth[b]) : 0;
+                int t = _target[b], f = _fall[b];
+                // 跳转的概率
+                double p = t == -1 ? 0 : 1;
+                if (t != -1 && f != -1) {
+                    p = 0.5;
+                    if (t <= b)
+                        p = loopLikely;
+                    else if (loopDepth[t] < loopDepth[b] && loopDepth[f] >= loopDepth[b])
+                        p = 1 - loopLikely;
+                    else if (loopDepth[f] < loopDepth[b] && loopDepth[t] >= loopDepth[b])
+                        p = loopLikely;
+                    else if (returns(t) && !returns(f))
+                        p = 1 - returnLikely;
+                    else if (returns(f) && !returns(t))
+                        p = returnLikely;
+                    else if (relation(b) == QuadOpr::EQU || relation(b) == QuadOpr::NE) {
+                        // BZ 在条件不成立时跳转
+                        bool jumpsIfEqual = (relation(b) == QuadOpr::EQU) == (last(b).getOperation() == QuadOpr::BNZ);
+                        p = jumpsIfEqual ? 1 - unequalLikely : unequalLikely;
+                    }
+                }
+                if (t != -1)
+                    edges.push_back({ b, t, freq * p, false });
+                if (f != -1)
+                    edges.push_back({ b, f, freq * (1 - p), true });
+                for (int c : _cases[b])
+                    edges.push_back({ b, c, freq / _cases[b].size(), false });
+            }
+            return edges;
+        }
+
+        // 按权重从大到小合并链：边的起点是一条链的末尾、终点是另一条链的开头时把两条链连起来
+        // 入口块始终是第一条链的开头，最后一块之后没有可以顺序执行的块，始终在最后一条链的末尾
+        // 其余的链按开头的块原来的顺序放置，返回块的放置顺序
+        std::vector<int> Layout::placeChains(std::vector<Edge> edges) const {
+            int n = (int)_blocks.size();
+            std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+                if (a.weight != b.weight)
+                    return a.weight > b.weight;
+                return a.fallThrough && !b.fallThrough;
+            });
+
+            std::vector<std::vector<int>> chains(n);
+            std::vector<int> chainOf(n);
+            for (int b = 0; b < n; b++) {
+                chains[b] = { b };
+                chainOf[b] = b;
+            }
+            for (const auto& edge : edges) {
+                int from = chainOf[edge.from], to = chainOf[edge.to];
+                if (edge.weight <= 0 || from == to || edge.to == 0 || edge.from == n - 1
+                    || chains[from].back() != edge.from || chains[to].front() != edge.to)
+                    continue;
+                for (int b : chains[to])
+                    chainOf[b] = from;
+                chains[from].insert(chains[from].end(), chains[to].begin(), chains[to].end());
+                chains[to].clear();
+            }
+
+            std::vector<int> order = chains[chainOf[0]];
+            for (int c = 0; c < n; c++) {
+                if (c != chainOf[0] && c != chainOf[n - 1])
+                    order.insert(order.end(), chains[c].begin(), chains[c].end());
+            }
+            if (chainOf[n - 1] != chainOf[0])
+                order.insert(order.end(), chains[chainOf[n - 1]].begin(), chains[chainOf[n - 1]].end());
+            return order;
+        }
+
+        void Layout::emit(const std::vector<int>& order, std::vector<Quadruple>& out) {
+            int n = (int)_blocks.size();
+            std::vector<int> next(n, -1);
+            for (int i = 0; i + 1 < n; i++)
+                next[order[i]] = order[i + 1];
+
+            // 不再顺序执行到的后继需要标号
+            std::vector<std::string> label(n);
+            std::vector<bool> newLabel(n, false);
+            for (int b = 0; b < n; b++) {
+                if (_quads[_blocks[b].first].getOperation() == QuadOpr::LAB)
+                    label[b] = _quads[_blocks[b].first].getX();
+            }
+            for (int b = 0; b < n; b++) {
+                int f = _fall[b];
+                if (f != -1 && f != next[b] && label[f].empty()) {
+                    label[f] = "@" + std::to_string(_nextLabel++);
+                    newLabel[f] = true;
+                }
+            }
+
+            auto add = [&](Quadruple quad, const Quadruple& from) {
+                quad.setLine(from.getLine());
+                quad.setCount(from.getCount());
+                out.push_back(std::move(quad));
+            };
+            for (int b : order) {
+                const auto& block = _blocks[b];
+                const auto& end = last(b);
+                if (newLabel[b])
+                    add(Quadruple(QuadOpr::LAB, label[b]), _quads[block.first]);
+                out.insert(out.end(), _quads.begin() + block.first, _quads.begin() + block.last);
+
+                // 之后的位置是否只能由跳转到达
+                bool jumped = true;
+                if (end.getOperation() == QuadOpr::GOTO && _target[b] == next[b])
+                    jumped = false;
+                else if (isTerminator(end.getOperation()))
+                    out.push_back(end);
+                else if (isBranch(end.getOperation()) && _target[b] != -1 && _target[b] == next[b]
+                         && _fall[b] != -1 && _fall[b] != next[b]) {
+                    auto opr = end.getOperation() == QuadOpr::BZ ? QuadOpr::BNZ : QuadOpr::BZ;
+                    Quadruple inverted(opr, label[_fall[b]], end.getY(), end.getR());
+                    inverted.setTaken(end.getCount() - std::min(end.getTaken(), end.getCount()));
+                    add(std::move(inverted), end);
+                    jumped = false;
+                } else {
+                    out.push_back(end);
+                    if (_fall[b] != -1 && _fall[b] != next[b])
+                        add(Quadruple(QuadOpr::GOTO, label[_fall[b]]), end);
+                    else
+                        jumped = false;
+                }
+
+                if (!jumped || next[b] == -1)
+                    continue;
+                int from = depthBefore(block.last + 1), to = depthBefore(_blocks[next[b]].first);
+                if (from > to)
+                    out.emplace_back(QuadOpr::POP, "$" + std::to_string(from - to));
+                for (int k = from; k < to; k++)
+                    out.emplace_back(QuadOpr::PUSH, "$0");
+            }
+        }
+
+        void Layout::run(std::vector<Quadruple>& out) {
+            if (!buildGraph() || _blocks.size() < 3) {
+                out.insert(out.end(), _quads.begin() + _fun.begin, _quads.begin() + _fun.end);
+                return;
+            }
+            bool profiled = std::any_of(_quads.begin() + _fun.begin, _quads.begin() + _fun.end,
+                                        [](const Quadruple& quad) { return quad.getCount() > 0; });
+            auto order = placeChains(profiled ? profiledEdges() : staticEdges());
+            // 最后一块顺序执行到函数末尾时必须仍在最后
+            int n = (int)_blocks.size();
+            if (order.back() != n - 1 && !terminates(n - 1)) {
+                out.insert(out.end(), _quads.begin() + _fun.begin, _quads.begin() + _fun.end);
+                return;
+            }
+            emit(order, out);
+        }
+    }
+
+    void LayoutPass::runOnQuads(std::vector<Quadruple>& quads) {
+        QuadProgram program;
+        if (analyseFrames(quads, program))
+            return;
+
+        int nextLabel = 0;
+        for (const auto& quad : quads) {
+            if (quad.getOperation() == QuadOpr::LAB)
+                nextLabel = std::max(nextLabel, std::stoi(quad.getX().substr(1)) + 1);
+        }
+
+        std::vector<Quadruple> out;
+        out.reserve(quads.size());
+        out.insert(out.end(), quads.begin(), quads.begin() + program.start.end);
+        for (const auto& fun : program.functions) {
+            // FUNC
+            out.push_back(quads[fun.begin - 1]);
+            Layout(quads, fun, nextLabel).run(out);
+        }
+        quads.swap(out);
+    }
+}
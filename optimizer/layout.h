@@ -0,0 +1,21 @@
+#pragma once
+
+#include "optimizer/pass.h"
+
+namespace c0 {
+
+    // 基本块布局
+    // Analyser 按源代码的顺序生成基本块，if 的 then 块总在前面，循环中常走的路径也可能要跳转。
+    // 按边的权重从大到小把基本块连成链（Pettis-Hansen），链中的块依次放置，权重大的边尽量成为顺序执行：
+    // 有剖析数据（--profile-use）时权重为边的执行次数；没有时按循环嵌套深度估计块的频率，
+    // 条件跳转回到循环开头的一边、不离开循环的一边和不直接返回的一边更可能执行
+    // 放置后后继正好是跳转目标时把 BZ/BNZ 取反，跳到下一块的 GOTO 删除，原来顺序执行但不再相邻的块补上 GOTO；
+    // 不可达的位置补 PUSH/POP 使栈深度仍然可以顺序求出
+    class LayoutPass final : public Pass {
+    public:
+        std::string name() const override { return "layout"; }
+        Level level() const override { return QuadLevel; }
+
+        void runOnQuads(std::vector<Quadruple>&) override;
+    };
+}
@@ -0,0 +1,496 @@
+#include "loop.h"
+#include "native/quad_frame.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace c0 {
+    namespace {
+        // 完全展开的循环最多执行的次数
+        constexpr std::int64_t maxUnrollTrips = 16;
+        // 完全展开后最多的四元式数
+        constexpr std::size_t maxUnrolledQuads = 160;
+        // 一个循环中最多削弱的不同的 i * k
+        constexpr std::size_t maxReduced = 4;
+
+        bool isRelation(QuadOpr opr) {
+            return opr == QuadOpr::EQU || opr == QuadOpr::NE || opr == QuadOpr::LT
+                || opr == QuadOpr::LE || opr == QuadOpr::GT || opr == QuadOpr::GE;
+        }
+
+        std::optional<std::int32_t> immediateOf(const std::string& opr) {
+            auto parsed = QuadOperand::parse(opr);
+            if (parsed.kind != QuadOperand::Immediate)
+                return {};
+            return parsed.value;
+        }
+
+        std::optional<std::int32_t> slotOf(const std::string& opr) {
+            auto parsed = QuadOperand::parse(opr);
+            if (parsed.kind != QuadOperand::Slot)
+                return {};
+            return parsed.value;
+        }
+
+        // C0 的 int 是 32 位补码，溢出时回绕
+        std::int32_t wrap(std::int64_t v) {
+            return (std::int32_t)(std::uint32_t)v;
+        }
+
+        std::vector<std::string> jumpTargets(const Quadruple& quad) {
+            switch (quad.getOperation()) {
+                case QuadOpr::GOTO:
+                case QuadOpr::BZ:
+                case QuadOpr::BNZ:
+                    return { quad.getX() };
+                case QuadOpr::SWT:
+                    return switchLabels(quad.getR());
+                default:
+                    return {};
+            }
+        }
+
+        // 写入的栈帧槽
+        std::optional<std::int32_t> writtenSlot(const Quadruple& quad) {
+            switch (quad.getOperation()) {
+                case QuadOpr::ASN: case QuadOpr::NEG: case QuadOpr::ADD:
+                case QuadOpr::SUB: case QuadOpr::MUL: case QuadOpr::DIV:
+                    return slotOf(quad.getR());
+                case QuadOpr::SCN:
+                    return slotOf(quad.getX());
+                default:
+                    return {};
+            }
+        }
+
+        // 用 read 改写读的操作数
+        template <typename F>
+        Quadruple mapReads(Quadruple quad, F read) {
+            switch (quad.getOperation()) {
+                case QuadOpr::ADD: case QuadOpr::SUB: case QuadOpr::MUL: case QuadOpr::DIV:
+                case QuadOpr::EQU: case QuadOpr::NE: case QuadOpr::LT:
+                case QuadOpr::LE: case QuadOpr::GT: case QuadOpr::GE:
+                    quad.setY(read(quad.getY()));
+                    quad.setX(read(quad.getX()));
+                    break;
+                case QuadOpr::ASN: case QuadOpr::NEG: case QuadOpr::PUSH:
+                case QuadOpr::PRT: case QuadOpr::RET: case QuadOpr::SWT:
+                    quad.setX(read(quad.getX()));
+                    break;
+                default:
+                    break;
+            }
+            return quad;
+        }
+
+        // 新生成的四元式沿用 from 的行号和次数
+        Quadruple derived(Quadruple quad, const Quadruple& from) {
+            quad.setLine(from.getLine());
+            quad.setCount(from.getCount());
+            return quad;
+        }
+
+        // 循环中各部分的下标
+        class Loop {
+        public:
+            // LAB @begin @continue @end
+            std::size_t header;
+            // LAB @continue
+            std::size_t latch;
+            // GOTO @begin
+            std::size_t backEdge;
+            // LAB @end
+            std::size_t exit;
+        };
+
+        // 归纳变量每次增加 step，在下标为 update 的四元式中赋值
+        class Induction {
+        public:
+            std::int32_t step;
+            std::size_t update;
+        };
+
+        // 一个函数的函数体（不含 FUNC）中的循环
+        class LoopOptimizer {
+        public:
+            LoopOptimizer(std::vector<Quadruple>& quads, const QuadFunction& fun, int& nextLabel)
+                : _quads(quads), _depth(fun.depth), _paramSize(fun.paramSize), _nextLabel(nextLabel) {}
+
+            // 只改动 header 及之后的四元式，header 之前的下标和栈深度不变
+            void run(std::size_t header);
+            // 处理完所有循环之后，压入强度削弱的新槽
+            void finish();
+
+        private:
+            std::vector<Quadruple>& _quads;
+            // 改动之前每条四元式执行前的栈深度
+            const std::vector<int>& _depth;
+            int _paramSize;
+            int& _nextLabel;
+            // 强度削弱的新槽数
+            std::int32_t _extraSlots = 0;
+
+            std::string newLabel() { return "@" + std::to_string(_nextLabel++); }
+
+            std::optional<Loop> findLoop(std::size_t header) const;
+            bool isClosed(const Loop&) const;
+            std::optional<Induction> induction(const Loop&, std::int32_t var) const;
+            std::optional<std::int32_t> initialValue(std::size_t header, std::int32_t var) const;
+            bool unroll(const Loop&);
+            bool reduce(const Loop&);
+        };
+
+        std::optional<Loop> LoopOptimizer::findLoop(std::size_t header) const {
+            const auto& head = _quads[header];
+            if (head.getOperation() != QuadOpr::LAB || head.getY().empty() || head.getR().empty()
+                || head.getY() == head.getX())
+                return {};
+
+            Loop loop = { header, 0, 0, 0 };
+            for (std::size_t i = header + 1; i < _quads.size(); i++) {
+                if (_quads[i].getOperation() != QuadOpr::LAB)
+                    continue;
+                if (_quads[i].getX() == head.getY() && loop.latch == 0)
+                    loop.latch = i;
+                else if (_quads[i].getX() == head.getR() && loop.latch != 0) {
+                    loop.exit = i;
+                    break;
+                }
+            }
+            if (loop.exit == 0)
+                return {};
+            // 条件中有临时变量时 GOTO 之后补有 PUSH
+            for (loop.backEdge = loop.exit - 1; loop.backEdge > loop.latch
+                 && _quads[loop.backEdge].getOperation() == QuadOpr::PUSH; loop.backEdge--)
+                ;
+            const auto& back = _quads[loop.backEdge];
+            if (back.getOperation() != QuadOpr::GOTO || back.getX() != head.getX())
+                return {};
+            return loop;
+        }
+
+        // 循环中的跳转只回到开头、跳到 @end 或者跳到循环中的标号，函数中其它地方不跳进循环，也不跳到 @end
+        bool LoopOptimizer::isClosed(const Loop& loop) const {
+            const auto& head = _quads[loop.header];
+            std::unordered_set<std::string> inner;
+            for (std::size_t i = loop.header + 1; i < loop.exit; i++) {
+                if (_quads[i].getOperation() == QuadOpr::LAB)
+                    inner.insert(_quads[i].getX());
+            }
+            for (std::size_t i = loop.header + 1; i < loop.exit; i++) {
+                for (const auto& target : jumpTargets(_quads[i])) {
+                    if (target == head.getX() ? i != loop.backEdge : target != head.getR() && inner.count(target) == 0)
+                        return false;
+                }
+            }
+
+            for (std::size_t i = 0; i < _quads.size(); i++) {
+                if (i == loop.header + 1)
+                    i = loop.exit;
+                for (const auto& target : jumpTargets(_quads[i])) {
+                    if (target == head.getX() || target == head.getR() || inner.count(target))
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        // var 在循环中只在更新部分赋值一次，形如 var = var + $s 或 var = var - $s
+        std::optional<Induction> LoopOptimizer::induction(const Loop& loop, std::int32_t var) const {
+            std::optional<std::size_t> write;
+            for (std::size_t i = loop.header + 1; i < loop.exit; i++) {
+                if (writtenSlot(_quads[i]) != var)
+                    continue;
+                if (write.has_value())
+                    return {};
+                write = i;
+            }
+            if (!write.has_value() || write.value() <= loop.latch || write.value() >= loop.backEdge)
+                return {};
+            // 更新部分顺序执行，每次回到开头之前执行一次
+            for (std::size_t i = loop.latch + 1; i < loop.backEdge; i++) {
+                auto opr = _quads[i].getOperation();
+                if (opr == QuadOpr::LAB || opr == QuadOpr::RET || !jumpTargets(_quads[i]).empty())
+                    return {};
+            }
+
+            auto step = [&](const Quadruple& quad) -> std::optional<std::int32_t> {
+                auto x = immediateOf(quad.getX()), y = immediateOf(quad.getY());
+                if (quad.getOperation() == QuadOpr::ADD && slotOf(quad.getX()) == var && y.has_value())
+                    return y;
+                if (quad.getOperation() == QuadOpr::ADD && slotOf(quad.getY()) == var && x.has_value())
+                    return x;
+                if (quad.getOperation() == QuadOpr::SUB && slotOf(quad.getX()) == var && y.has_value())
+                    return wrap(-(std::int64_t)y.value());
+                return {};
+            };
+            // var = var + $s，或者 t = var + $s; var = t
+            const auto& quad = _quads[write.value()];
+            auto s = step(quad);
+            if (!s.has_value() && quad.getOperation() == QuadOpr::ASN && write.value() > loop.latch + 1
+                && _quads[write.value() - 1].getR() == quad.getX())
+                s = step(_quads[write.value() - 1]);
+            if (!s.has_value() || s.value() == 0)
+                return {};
+            return Induction{ s.value(), write.value() };
+        }
+
+        // 循环之前顺序执行的部分中对 var 的最后一次赋值是立即数
+        std::optional<std::int32_t> LoopOptimizer::initialValue(std::size_t header, std::int32_t var) const {
+            for (std::size_t i = header; i > 0; i--) {
+                const auto& quad = _quads[i - 1];
+                auto opr = quad.getOperation();
+                if (opr == QuadOpr::LAB || opr == QuadOpr::RET || !jumpTargets(quad).empty())
+                    return {};
+                if (opr == QuadOpr::PUSH && _depth[i - 1] == var)
+                    return immediateOf(quad.getX());
+                if (writtenSlot(quad) == var)
+                    return opr == QuadOpr::ASN ? immediateOf(quad.getX()) : std::nullopt;
+            }
+            return {};
+        }
+
+        // LAB @begin; REL i $n; BZ @end; {body}; LAB @continue; {update}; GOTO @begin; LAB @end
+        // 展开为 trips 份 {body}; LAB; {update}，读 i 的地方换成每一份中 i 的值
+        bool LoopOptimizer::unroll(const Loop& loop) {
+            const auto& head = _quads[loop.header];
+            const auto& cond = _quads[loop.header + 1];
+            const auto& branch = _quads[loop.header + 2];
+            if (!isRelation(cond.getOperation()) || branch.getOperation() != QuadOpr::BZ || branch.getX() != head.getR())
+                return false;
+            for (std::size_t i = loop.header + 3; i < loop.exit; i++) {
+                for (const auto& target : jumpTargets(_quads[i])) {
+                    if (target == head.getR())
+                        return false;
+                }
+            }
+
+            // 比较的一边是归纳变量，另一边是立即数
+            bool varFirst = slotOf(cond.getX()).has_value();
+            auto var = slotOf(varFirst ? cond.getX() : cond.getY());
+            auto bound = immediateOf(varFirst ? cond.getY() : cond.getX());
+            if (!var.has_value() || !bound.has_value() || var.value() < 0 || var.value() >= _depth[loop.header])
+                return false;
+            auto iv = induction(loop, var.value());
+            auto init = initialValue(loop.header, var.value());
+            if (!iv.has_value() || !init.has_value())
+                return false;
+
+            std::vector<std::int32_t> values;
+            for (std::int32_t v = init.value(); ; v = wrap((std::int64_t)v + iv->step)) {
+                std::int64_t x = varFirst ? v : bound.value(), y = varFirst ? bound.value() : v;
+                bool holds = false;
+                switch (cond.getOperation()) {
+                    case QuadOpr::EQU: holds = x == y; break;
+                    case QuadOpr::NE: holds = x != y; break;
+                    case QuadOpr::LT: holds = x < y; break;
+                    case QuadOpr::LE: holds = x <= y; break;
+                    case QuadOpr::GT: holds = x > y; break;
+                    default: holds = x >= y; break;
+                }
+                if (!holds)
+                    break;
+                if ((std::int64_t)values.size() == maxUnrollTrips)
+                    return false;
+                values.push_back(v);
+            }
+            std::size_t bodyBegin = loop.header + 3;
+            if ((loop.backEdge - bodyBegin) * values.size() > maxUnrolledQuads)
+                return false;
+
+            // 没有跳转到的标号（没有 continue 时的 @continue）不再复制
+            std::unordered_set<std::string> targets;
+            for (std::size_t i = bodyBegin; i < loop.backEdge; i++) {
+                for (const auto& target : jumpTargets(_quads[i]))
+                    targets.insert(target);
+            }
+
+            std::vector<Quadruple> out;
+            out.reserve((loop.backEdge - bodyBegin) * values.size());
+            for (auto value : values) {
+                std::unordered_map<std::string, std::string> labels;
+                for (std::size_t i = bodyBegin; i < loop.backEdge; i++) {
+                    if (_quads[i].getOperation() == QuadOpr::LAB)
+                        labels.emplace(_quads[i].getX(), newLabel());
+                }
+                auto rename = [&](const std::string& label) {
+                    auto it = labels.find(label);
+                    return it == labels.end() ? label : it->second;
+                };
+
+                for (std::size_t i = bodyBegin; i < loop.backEdge; i++) {
+                    if (_quads[i].getOperation() == QuadOpr::LAB && targets.count(_quads[i].getX()) == 0
+                        && _quads[i].getY().empty())
+                        continue;
+                    auto quad = mapReads(_quads[i], [&](const std::string& opr) {
+                        return slotOf(opr) == var ? "$" + std::to_string(value) : opr;
+                    });
+                    switch (quad.getOperation()) {
+                        case QuadOpr::LAB:
+                            quad.setY(rename(quad.getY()));
+                            quad.setR(rename(quad.getR()));
+                            [[fallthrough]];
+                        case QuadOpr::GOTO:
+                        case QuadOpr::BZ:
+                        case QuadOpr::BNZ:
+                            quad.setX(rename(quad.getX()));
+                            break;
+                        case QuadOpr::SWT: {
+                            auto targets = switchLabels(quad.getR());
+                            for (auto& target : targets)
+                                target = rename(target);
+                            quad.setR(joinLabels(targets));
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+                    quad.setCount(quad.getCount() / values.size());
+                    quad.setTaken(quad.getTaken() / values.size());
+                    out.push_back(std::move(quad));
+                    if (i == iv->update)
+                        value = wrap((std::int64_t)value + iv->step);
+                }
+            }
+
+            _quads.erase(_quads.begin() + loop.header, _quads.begin() + loop.exit + 1);
+            _quads.insert(_quads.begin() + loop.header, out.begin(), out.end());
+            return true;
+        }
+
+        // 循环中的 MUL i $k 换成读新的槽 j，循环前 MUL i $k j，i 增加 s 之后 ADD j $(s * k) j
+        // j 在函数开头压入，处理完整个函数之前先记为 -1、-2 ……，见 finish
+        bool LoopOptimizer::reduce(const Loop& loop) {
+            class Reduced {
+            public:
+                std::int32_t var;
+                std::int32_t factor;
+                Induction iv;
+                std::string slot;
+            };
+            std::vector<Reduced> reduced;
+            // 四元式下标 -> reduced 的下标
+            std::unordered_map<std::size_t, std::size_t> uses;
+            std::unordered_map<std::int32_t, std::optional<Induction>> inductions;
+            int depth = _depth[loop.header];
+
+            for (std::size_t i = loop.header + 1; i < loop.exit; i++) {
+                const auto& quad = _quads[i];
+                if (quad.getOperation() != QuadOpr::MUL)
+                    continue;
+                bool varFirst = slotOf(quad.getX()).has_value();
+                auto var = slotOf(varFirst ? quad.getX() : quad.getY());
+                auto factor = immediateOf(varFirst ? quad.getY() : quad.getX());
+                if (!var.has_value() || !factor.has_value() || var.value() < 0 || var.value() >= depth
+                    || (factor.value() >= -1 && factor.value() <= 1))
+                    continue;
+                auto it = inductions.find(var.value());
+                if (it == inductions.end())
+                    it = inductions.emplace(var.value(), induction(loop, var.value())).first;
+                if (!it->second.has_value())
+                    continue;
+
+                std::size_t k = 0;
+                for (; k < reduced.size() && (reduced[k].var != var.value() || reduced[k].factor != factor.value()); k++)
+                    ;
+                if (k == reduced.size()) {
+                    if (reduced.size() == maxReduced)
+                        continue;
+                    reduced.push_back({ var.value(), factor.value(), it->second.value(),
+                                        std::to_string(-++_extraSlots) });
+                }
+                uses[i] = k;
+            }
+            if (reduced.empty())
+                return false;
+
+            std::vector<Quadruple> out;
+            const auto& entry = _quads[loop.header];
+            for (const auto& r : reduced)
+                out.push_back(derived(Quadruple(QuadOpr::MUL, std::to_string(r.var), "$" + std::to_string(r.factor),
+                                                r.slot), entry));
+            for (std::size_t i = loop.header; i <= loop.exit; i++) {
+                auto use = uses.find(i);
+                if (use != uses.end())
+                    out.push_back(derived(Quadruple(QuadOpr::ASN, reduced[use->second].slot, "", _quads[i].getR()),
+                                          _quads[i]));
+                else
+                    out.push_back(_quads[i]);
+                for (const auto& r : reduced) {
+                    if (r.iv.update == i)
+                        out.push_back(derived(Quadruple(QuadOpr::ADD, r.slot,
+                            "$" + std::to_string(wrap((std::int64_t)r.iv.step * r.factor)), r.slot), _quads[i]));
+                }
+            }
+
+            _quads.erase(_quads.begin() + loop.header, _quads.begin() + loop.exit + 1);
+            _quads.insert(_quads.begin() + loop.header, out.begin(), out.end());
+            return true;
+        }
+
+        void LoopOptimizer::run(std::size_t header) {
+            auto loop = findLoop(header);
+            if (!loop.has_value() || !isClosed(loop.value()))
+                return;
+            if (!unroll(loop.value()))
+                reduce(loop.value());
+        }
+
+        // 强度削弱的新槽 j 在函数开头、参数之后压入，整个函数中都存在：
+        // 在循环前压入时，layout 把循环的条件移到循环之后会使跳转两端之间的栈深度低于跳转处，线性扫描无法分配寄存器
+        void LoopOptimizer::finish() {
+            if (_extraSlots == 0)
+                return;
+            int paramSize = _paramSize;
+            auto shift = [&](const std::string& opr) {
+                auto slot = slotOf(opr);
+                if (!slot.has_value() || (slot.value() >= 0 && slot.value() < paramSize))
+                    return opr;
+                if (slot.value() < 0)
+                    return std::to_string(paramSize - slot.value() - 1);
+                return (opr[0] == '#' ? "#" : "") + std::to_string(slot.value() + _extraSlots);
+            };
+            for (auto& quad : _quads) {
+                quad.setX(shift(quad.getX()));
+                quad.setY(shift(quad.getY()));
+                quad.setR(shift(quad.getR()));
+            }
+            std::vector<Quadruple> pushes(_extraSlots, derived(Quadruple(QuadOpr::PUSH, "$0"), _quads.front()));
+            _quads.insert(_quads.begin(), pushes.begin(), pushes.end());
+            _extraSlots = 0;
+        }
+    }
+
+    void LoopPass::runOnQuads(std::vector<Quadruple>& quads) {
+        QuadProgram program;
+        if (analyseFrames(quads, program))
+            return;
+
+        int nextLabel = 0;
+        for (const auto& quad : quads) {
+            if (quad.getOperation() == QuadOpr::LAB)
+                nextLabel = std::max(nextLabel, std::stoi(quad.getX().substr(1)) + 1);
+        }
+
+        std::vector<Quadruple> out;
+        out.reserve(quads.size());
+        out.insert(out.end(), quads.begin(), quads.begin() + program.start.end);
+        for (const auto& fun : program.functions) {
+            // FUNC
+            out.push_back(quads[fun.begin - 1]);
+            std::vector<Quadruple> body(quads.begin() + fun.begin, quads.begin() + fun.end);
+            LoopOptimizer optimizer(body, fun, nextLabel);
+            // 从后往前处理，内层的循环先于外层
+            for (std::size_t i = body.size(); i > 0; i--) {
+                if (body[i - 1].getOperation() == QuadOpr::LAB && !body[i - 1].getY().empty())
+                    optimizer.run(i - 1);
+            }
+            optimizer.finish();
+            out.insert(out.end(), body.begin(), body.end());
+        }
+        quads.swap(out);
+    }
+}
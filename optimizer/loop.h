@@ -0,0 +1,23 @@
+#pragma once
+
+#include "optimizer/pass.h"
+
+namespace c0 {
+
+    // 计数循环的展开和强度削弱
+    // Analyser 在循环开头的 LAB 上记下 continue 和 break 的标号（LAB @begin @continue @end），
+    // for 循环的更新部分在 LAB @continue 和回到开头的 GOTO 之间。归纳变量 i 是循环之前就有的局部变量，
+    // 在循环中只在更新部分赋值一次，形如 i = i + $s 或 i = i - $s
+    // 循环以 REL i $n; BZ @end 开头、由 i 的初值（循环之前的 ASN $a）算出的执行次数很少且展开后不大时完全展开，
+    // 每份循环体中读 i 的地方换成这一次的值，交给之后的 fold 折叠；
+    // 否则把循环中的 MUL i $k 换成读新的栈帧槽 j：循环之前求出 j = i * k，更新部分 i 增加 s 之后 j 增加 s * k，
+    // j 在函数开头压入，参数之后的槽依次后移
+    // 只处理没有从外面跳进循环中的标号、跳出循环只经过 @end 的循环，layout 之后循环开头的标号不再有这些信息
+    class LoopPass final : public Pass {
+    public:
+        std::string name() const override { return "loop"; }
+        Level level() const override { return QuadLevel; }
+
+        void runOnQuads(std::vector<Quadruple>&) override;
+    };
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "instruction/quadruple.h"
+#include "instruction/instruction.h"
+
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 一个优化 pass
+    // quad 级的 pass 在 Analyser 之后、Generator 之前对整个四元式序列进行改写
+    // code 级的 pass 在 Generator 之后对每个函数（包括 .start）的指令序列分别改写
+    class Pass {
+    public:
+        enum Level {
+            QuadLevel,
+            CodeLevel
+        };
+
+        virtual ~Pass() = default;
+
+        virtual std::string name() const = 0;
+        virtual Level level() const = 0;
+
+        virtual void runOnQuads(std::vector<Quadruple>&) {}
+        // funcId is -1 for the .start section
+        virtual void runOnFunction(int funcId, std::vector<Instruction>&) { (void)funcId; }
+    };
+}
@@ -0,0 +1,185 @@
+#include "pass_manager.h"
+#include "fold.h"
+#include "inline.h"
+#include "layout.h"
+#include "loop.h"
+#include "peephole.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace c0 {
+    using PassFactory = std::function<std::unique_ptr<Pass>()>;
+
+    // 所有可用的 pass，新增 pass 时在这里注册
+    const std::vector<std::pair<std::string, PassFactory>>& passRegistry() {
+        static const std::vector<std::pair<std::string, PassFactory>> registry = {
+            { "fold", [] { return std::make_unique<FoldPass>(); } },
+            { "inline", [] { return std::make_unique<InlinePass>(); } },
+            { "layout", [] { return std::make_unique<LayoutPass>(); } },
+            { "loop", [] { return std::make_unique<LoopPass>(); } },
+            { "peephole", [] { return std::make_unique<PeepholePass>(); } },
+        };
+        return registry;
+    }
+
+    std::vector<std::string> PassManager::pipeline(int optLevel) {
+        switch (optLevel) {
+            case 0:
+                return {};
+            case 1:
+                return { "fold", "peephole" };
+            default:
+                // loop 展开后再 fold 一次，折叠换成立即数的归纳变量
+                return { "fold", "inline", "loop", "fold", "layout", "peephole" };
+        }
+    }
+
+    std::vector<std::string> PassManager::availablePasses() {
+        std::vector<std::string> names;
+        for (const auto& entry : passRegistry())
+            names.push_back(entry.first);
+        return names;
+    }
+
+    std::unique_ptr<Pass> PassManager::createPass(const std::string& name) {
+        for (const auto& entry : passRegistry()) {
+            if (entry.first == name)
+                return entry.second();
+        }
+        return nullptr;
+    }
+
+    bool PassManager::addPass(const std::string& name) {
+        auto pass = createPass(name);
+        if (!pass)
+            return false;
+        _passes.push_back(std::move(pass));
+        return true;
+    }
+
+    std::optional<std::string> PassManager::addPasses(const std::string& names) {
+        std::stringstream ss(names);
+        std::string name;
+        while (std::getline(ss, name, ',')) {
+            if (name.empty())
+                continue;
+            if (!addPass(name))
+                return name;
+        }
+        return {};
+    }
+
+    void PassManager::addPipeline(int optLevel) {
+        for (const auto& name : pipeline(optLevel))
+            addPass(name);
+    }
+
+    inline double millisSince(std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    void PassManager::runOnQuads(std::vector<Quadruple>& quads) {
+        for (auto& pass : _passes) {
+            if (pass->level() != Pass::QuadLevel)
+                continue;
+
+            PassStat stat(pass->name(), Pass::QuadLevel);
+            stat.sizeBefore = quads.size();
+            auto begin = std::chrono::steady_clock::now();
+            pass->runOnQuads(quads);
+            stat.millis = millisSince(begin);
+            stat.sizeAfter = quads.size();
+            _stats.push_back(std::move(stat));
+        }
+    }
+
+    void PassManager::runOnCode(byteCode& code) {
+        for (auto& pass : _passes) {
+            if (pass->level() != Pass::CodeLevel)
+                continue;
+
+            PassStat stat(pass->name(), Pass::CodeLevel);
+            double millis = 0;
+            auto runOn = [&](int funcId, std::vector<Instruction>& seq) {
+                std::size_t before = seq.size();
+                auto begin = std::chrono::steady_clock::now();
+                pass->runOnFunction(funcId, seq);
+                millis += millisSince(begin);
+                stat.sizeBefore += before;
+                stat.sizeAfter += seq.size();
+                stat.functions.emplace_back(funcId, before, seq.size());
+            };
+
+            runOn(-1, code.start);
+            for (int i = 0; i < (int)code.instructions.size(); i++)
+                runOn(i, code.instructions[i]);
+            stat.millis = millis;
+            _stats.push_back(std::move(stat));
+        }
+    }
+
+    void PassManager::runOnFunction(int funcId, std::vector<Instruction>& seq) {
+        // pass 本身没有共享状态，锁只保护统计数据，各线程的函数体可以同时优化
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_functionStats.empty()) {
+                for (auto& pass : _passes) {
+                    if (pass->level() != Pass::CodeLevel)
+                        continue;
+                    _functionStats.push_back(_stats.size());
+                    _stats.emplace_back(pass->name(), Pass::CodeLevel);
+                }
+            }
+        }
+
+        std::size_t k = 0;
+        for (auto& pass : _passes) {
+            if (pass->level() != Pass::CodeLevel)
+                continue;
+
+            std::size_t before = seq.size();
+            auto begin = std::chrono::steady_clock::now();
+            pass->runOnFunction(funcId, seq);
+            double millis = millisSince(begin);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto& stat = _stats[_functionStats[k++]];
+            stat.millis += millis;
+            stat.sizeBefore += before;
+            stat.sizeAfter += seq.size();
+            stat.functions.emplace_back(funcId, before, seq.size());
+        }
+    }
+
+    void PassManager::report(std::ostream& out) const {
+        out << std::left << std::setw(16) << "pass" << std::setw(8) << "level"
+            << std::right << std::setw(12) << "time(ms)" << std::setw(10) << "before"
+            << std::setw(10) << "after" << std::setw(10) << "removed" << "\n";
+
+        double total = 0;
+        for (const auto& stat : _stats) {
+            total += stat.millis;
+            out << std::left << std::setw(16) << stat.name
+                << std::setw(8) << (stat.level == Pass::QuadLevel ? "quad" : "code")
+                << std::right << std::setw(12) << std::fixed << std::setprecision(3) << stat.millis
+                << std::setw(10) << stat.sizeBefore << std::setw(10) << stat.sizeAfter
+                << std::setw(10) << stat.removed() << "\n";
+
+            // 只列出有变化的函数
+            for (const auto& func : stat.functions) {
+                if (func.before == func.after)
+                    continue;
+                std::string id = func.funcId < 0 ? ".start" : ".F" + std::to_string(func.funcId);
+                out << "  " << std::left << std::setw(14) << id << std::setw(8) << ""
+                    << std::right << std::setw(12) << "" << std::setw(10) << func.before
+                    << std::setw(10) << func.after << std::setw(10) << (long)func.before - (long)func.after << "\n";
+            }
+        }
+        out << std::left << std::setw(16) << "total" << std::setw(8) << ""
+            << std::right << std::setw(12) << std::fixed << std::setprecision(3) << total << "\n";
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "optimizer/pass.h"
+#include "generater/generator.h"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 每个 pass 一次运行的统计信息
+    class PassStat {
+    public:
+        // funcId is -1 for the .start section
+        class FunctionDelta {
+        public:
+            int funcId;
+            std::size_t before;
+            std::size_t after;
+
+            FunctionDelta(int funcId, std::size_t before, std::size_t after)
+                : funcId(funcId), before(before), after(after) {}
+        };
+
+        std::string name;
+        Pass::Level level;
+        double millis;
+        // quads for quad-level passes, instructions for code-level passes
+        std::size_t sizeBefore;
+        std::size_t sizeAfter;
+        std::vector<FunctionDelta> functions;
+
+        PassStat(std::string name, Pass::Level level)
+            : name(std::move(name)), level(level), millis(0), sizeBefore(0), sizeAfter(0), functions({}) {}
+
+        long removed() const { return (long)sizeBefore - (long)sizeAfter; }
+    };
+
+    class PassManager final {
+    public:
+        PassManager() = default;
+        PassManager(PassManager&&) = delete;
+        PassManager(const PassManager&) = delete;
+        PassManager& operator=(PassManager) = delete;
+
+        // -O0/-O1/-O2 对应的 pass 序列
+        static std::vector<std::string> pipeline(int optLevel);
+        static std::vector<std::string> availablePasses();
+        static std::unique_ptr<Pass> createPass(const std::string& name);
+
+        // return false if there is no pass called name
+        bool addPass(const std::string& name);
+        // comma separated pass names, return the first unknown name if any
+        std::optional<std::string> addPasses(const std::string& names);
+        void addPipeline(int optLevel);
+
+        void runOnQuads(std::vector<Quadruple>&);
+        void runOnCode(byteCode&);
+        // 对单个函数运行 code 级的 pass，统计信息按 pass 累计，用于流式输出，可以在多个线程中调用
+        void runOnFunction(int funcId, std::vector<Instruction>&);
+
+        const std::vector<PassStat>& stats() const { return _stats; }
+        void report(std::ostream&) const;
+
+    private:
+        std::vector<std::unique_ptr<Pass>> _passes;
+        std::vector<PassStat> _stats;
+        // runOnFunction 中每个 pass 对应的 _stats 下标
+        std::vector<std::size_t> _functionStats;
+        std::mutex _mutex;
+    };
+}
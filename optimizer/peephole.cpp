@@ -0,0 +1,303 @@
+#include "peephole.h"
+
+#include <unordered_map>
+
+namespace c0 {
+    inline bool isJump(opCode op) {
+        return op >= opCode::jmp && op <= opCode::jle;
+    }
+
+    inline bool isCondJump(opCode op) {
+        return op > opCode::jmp && op <= opCode::jle;
+    }
+
+    // 一次匹配的上下文
+    class Window {
+    public:
+        std::vector<Instruction>& seq;
+        std::vector<bool>& killed;
+        const std::vector<bool>& targets;
+        const std::unordered_map<int, int>& localRefs;
+        int funcId;
+        std::size_t at;
+
+        Window(std::vector<Instruction>& seq, std::vector<bool>& killed, const std::vector<bool>& targets,
+               const std::unordered_map<int, int>& localRefs, int funcId, std::size_t at)
+            : seq(seq), killed(killed), targets(targets), localRefs(localRefs), funcId(funcId), at(at) {}
+
+        const Instruction& operator[](std::size_t i) const { return seq[at + i]; }
+
+        // 跳转目标处的指令，目标已被删除或越界时返回空
+        const Instruction* jumpTarget(std::size_t i) const {
+            auto target = (std::size_t)seq[at + i].getX();
+            if (target >= seq.size() || killed[target])
+                return nullptr;
+            return &seq[target];
+        }
+    };
+
+    using OpMatcher = bool (*)(const Instruction&);
+    using Guard = bool (*)(const Window&);
+    using Rewrite = std::vector<Instruction> (*)(Window&);
+
+    class Rule {
+    public:
+        const char* name;
+        std::vector<OpMatcher> pattern;
+        Guard guard;
+        Rewrite rewrite;
+    };
+
+    template<opCode op>
+    bool is(const Instruction& ins) { return ins.getOpr() == op; }
+
+    bool any(const Instruction&) { return true; }
+    bool condJump(const Instruction& ins) { return isCondJump(ins.getOpr()); }
+    bool jump(const Instruction& ins) { return isJump(ins.getOpr()); }
+    bool terminator(const Instruction& ins) {
+        return ins.getOpr() == opCode::jmp || ins.getOpr() == opCode::ret || ins.getOpr() == opCode::iRet;
+    }
+
+    // 指令对操作数栈的影响 <pop, push>，call 的影响和被调用函数有关，返回 -1
+    std::pair<int, int> stackEffect(const Instruction& ins) {
+        switch (ins.getOpr()) {
+            case opCode::biPush: case opCode::iPush:
+            case opCode::loadC: case opCode::loadA:
+            case opCode::iScan: case opCode::cScan:
+                return {0, 1};
+            case opCode::pop1:
+            case opCode::iPrint: case opCode::cPrint: case opCode::sPrint:
+            case opCode::je: case opCode::jne: case opCode::jl:
+            case opCode::jge: case opCode::jg: case opCode::jle:
+                return {1, 0};
+            case opCode::popN:
+                return {ins.getX(), 0};
+            case opCode::fPrint:
+                return {ins.getY(), 0};
+            case opCode::iLoad: case opCode::iNeg: case opCode::i2c:
+                return {1, 1};
+            case opCode::iStore:
+                return {2, 0};
+            case opCode::iAdd: case opCode::iSub: case opCode::iMul:
+            case opCode::iDiv: case opCode::iCmp:
+                return {2, 1};
+            case opCode::nop: case opCode::jmp: case opCode::printL:
+                return {0, 0};
+            default:
+                return {-1, -1};
+        }
+    }
+
+    // 从 iStore 向前找到压入其目标地址的指令，找不到返回 -1
+    int storeAddress(const Window& w, std::size_t store) {
+        int depth = 1;  // the address lies just below the stored value
+        for (int j = (int)store - 1; j >= 0; j--) {
+            if (w.killed[j])
+                continue;
+            if (w.targets[j + 1] && j + 1 <= (int)store)
+                return -1;
+            auto effect = stackEffect(w.seq[j]);
+            if (effect.first < 0 || isJump(w.seq[j].getOpr()))
+                return -1;
+            if (depth < effect.second)
+                return effect.second == 1 ? j : -1;
+            depth += effect.first - effect.second;
+        }
+        return -1;
+    }
+
+    /*
+     * 规则表
+     * pattern 中的指令必须连续，且除第一条外都不能是跳转目标
+     * rewrite 返回替换整个窗口的指令序列，长度不超过窗口
+     */
+    const std::vector<Rule>& peepholeRules() {
+        static const std::vector<Rule> rules = {
+            // popn 0 =>
+            { "popn-zero", { is<opCode::popN> },
+              [](const Window& w) { return w[0].getX() == 0; },
+              [](Window&) { return std::vector<Instruction>(); } },
+            // popn 1 => pop1
+            { "popn-one", { is<opCode::popN> },
+              [](const Window& w) { return w[0].getX() == 1; },
+              [](Window&) { return std::vector<Instruction>{ Instruction(opCode::pop1) }; } },
+            // popn a; popn b => popn a+b
+            { "popn-merge", { is<opCode::popN>, is<opCode::popN> },
+              nullptr,
+              [](Window& w) { return std::vector<Instruction>{ Instruction(opCode::popN, w[0].getX() + w[1].getX()) }; } },
+            // jmp/ret/iret; x => jmp/ret/iret   (x is not a jump target)
+            { "unreachable", { terminator, any },
+              nullptr,
+              [](Window& w) { return std::vector<Instruction>{ w[0] }; } },
+            // jmp next =>
+            { "jump-next", { is<opCode::jmp> },
+              [](const Window& w) { return w[0].getX() == (int)w.at + 1; },
+              [](Window&) { return std::vector<Instruction>(); } },
+            // jXX next => pop1
+            { "cond-jump-next", { condJump },
+              [](const Window& w) { return w[0].getX() == (int)w.at + 1; },
+              [](Window&) { return std::vector<Instruction>{ Instruction(opCode::pop1) }; } },
+            // jXX L; L: jmp M => jXX M
+            { "jump-chain", { jump },
+              [](const Window& w) {
+                  auto target = w.jumpTarget(0);
+                  return target != nullptr && target->getOpr() == opCode::jmp
+                      && target->getX() != w[0].getX();
+              },
+              [](Window& w) { return std::vector<Instruction>{ Instruction(w[0].getOpr(), w.jumpTarget(0)->getX()) }; } },
+            // jmp L; L: ret/iret => ret/iret
+            { "jump-to-return", { is<opCode::jmp> },
+              [](const Window& w) {
+                  auto target = w.jumpTarget(0);
+                  return target != nullptr
+                      && (target->getOpr() == opCode::ret || target->getOpr() == opCode::iRet);
+              },
+              [](Window& w) { return std::vector<Instruction>{ *w.jumpTarget(0) }; } },
+            // ipush 0; icmp; jXX => jXX
+            { "cmp-zero", { is<opCode::iPush>, is<opCode::iCmp>, condJump },
+              [](const Window& w) { return w[0].getX() == 0; },
+              [](Window& w) { return std::vector<Instruction>{ w[2] }; } },
+            // ipush 0; iadd/isub =>     ipush 1; imul/idiv =>
+            { "identity", { is<opCode::iPush>, any },
+              [](const Window& w) {
+                  auto op = w[1].getOpr();
+                  return (w[0].getX() == 0 && (op == opCode::iAdd || op == opCode::iSub))
+                      || (w[0].getX() == 1 && (op == opCode::iMul || op == opCode::iDiv));
+              },
+              [](Window&) { return std::vector<Instruction>(); } },
+            // ineg; ineg =>
+            { "neg-neg", { is<opCode::iNeg>, is<opCode::iNeg> },
+              nullptr,
+              [](Window&) { return std::vector<Instruction>(); } },
+            // ipush/loada/loadc; pop1 =>
+            { "push-pop", { any, is<opCode::pop1> },
+              [](const Window& w) {
+                  auto op = w[0].getOpr();
+                  return op == opCode::iPush || op == opCode::biPush || op == opCode::loadA || op == opCode::loadC;
+              },
+              [](Window&) { return std::vector<Instruction>(); } },
+            // loada 0, s; <expr>; istore; loada 0, s; iload => <expr>
+            // 只用于局部变量，且 s 在函数中没有其它引用
+            { "store-reload", { is<opCode::iStore>, is<opCode::loadA>, is<opCode::iLoad> },
+              [](const Window& w) {
+                  if (w.funcId < 0 || w[1].getX() != 0)
+                      return false;
+                  auto refs = w.localRefs.find(w[1].getY());
+                  if (refs == w.localRefs.end() || refs->second != 2)
+                      return false;
+                  int addr = storeAddress(w, w.at);
+                  return addr >= 0 && w.seq[addr].getOpr() == opCode::loadA
+                      && w.seq[addr].getX() == 0 && w.seq[addr].getY() == w[1].getY();
+              },
+              [](Window& w) {
+                  w.killed[storeAddress(w, w.at)] = true;
+                  return std::vector<Instruction>();
+              } },
+        };
+        return rules;
+    }
+
+    std::vector<bool> jumpTargets(const std::vector<Instruction>& seq) {
+        std::vector<bool> targets(seq.size() + 1, false);
+        for (const auto& ins : seq) {
+            if (isJump(ins.getOpr()) && ins.getX() >= 0 && ins.getX() <= (int)seq.size())
+                targets[ins.getX()] = true;
+        }
+        return targets;
+    }
+
+    // tableswitch 之后的 jmp 表，表项的个数和位置都不能改变
+    std::vector<bool> tableEntries(const std::vector<Instruction>& seq) {
+        std::vector<bool> entries(seq.size() + 1, false);
+        for (std::size_t i = 0; i < seq.size(); i++) {
+            if (seq[i].getOpr() != opCode::tableSwitch)
+                continue;
+            for (std::size_t k = i + 1; k <= i + 1 + seq[i].getY() && k < seq.size(); k++)
+                entries[k] = true;
+        }
+        return entries;
+    }
+
+    bool matches(const Rule& rule, const Window& w) {
+        std::size_t len = rule.pattern.size();
+        if (w.at + len > w.seq.size())
+            return false;
+        for (std::size_t i = 0; i < len; i++) {
+            if (w.killed[w.at + i] || !rule.pattern[i](w[i]))
+                return false;
+            if (i > 0 && w.targets[w.at + i])
+                return false;
+        }
+        return rule.guard == nullptr || rule.guard(w);
+    }
+
+    // 删除被标记的指令，并把跳转目标映射到新的下标
+    void compact(std::vector<Instruction>& seq, const std::vector<bool>& killed) {
+        std::vector<int> newIndex(seq.size() + 1);
+        int n = 0;
+        for (std::size_t i = 0; i < seq.size(); i++) {
+            newIndex[i] = n;
+            if (!killed[i])
+                n++;
+        }
+        newIndex[seq.size()] = n;
+
+        std::vector<Instruction> result;
+        result.reserve(n);
+        for (std::size_t i = 0; i < seq.size(); i++) {
+            if (killed[i])
+                continue;
+            result.push_back(seq[i]);
+            auto& ins = result.back();
+            if (isJump(ins.getOpr()) && ins.getX() >= 0 && ins.getX() <= (int)seq.size())
+                ins.setX(newIndex[ins.getX()]);
+        }
+        seq.swap(result);
+    }
+
+    void PeepholePass::runOnFunction(int funcId, std::vector<Instruction>& seq) {
+        const auto& rules = peepholeRules();
+        bool changed = true;
+
+        while (changed) {
+            changed = false;
+            auto targets = jumpTargets(seq);
+            auto entries = tableEntries(seq);
+            // 表项都当作跳转目标，不会被之前的窗口删除
+            for (std::size_t i = 0; i < seq.size(); i++)
+                targets[i] = targets[i] || entries[i];
+            std::vector<bool> killed(seq.size(), false);
+
+            std::unordered_map<int, int> localRefs;
+            for (const auto& ins : seq) {
+                if (ins.getOpr() == opCode::loadA && ins.getX() == 0)
+                    localRefs[ins.getY()]++;
+            }
+
+            for (std::size_t i = 0; i < seq.size(); i++) {
+                if (entries[i])
+                    continue;
+                Window w(seq, killed, targets, localRefs, funcId, i);
+                for (const auto& rule : rules) {
+                    if (!matches(rule, w))
+                        continue;
+
+                    auto replacement = rule.rewrite(w);
+                    std::size_t len = rule.pattern.size();
+                    for (std::size_t k = 0; k < len; k++) {
+                        if (k < replacement.size())
+                            seq[i + k] = replacement[k];
+                        else
+                            killed[i + k] = true;
+                    }
+                    i += len - 1;
+                    changed = true;
+                    break;
+                }
+            }
+
+            if (changed)
+                compact(seq, killed);
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "optimizer/pass.h"
+
+namespace c0 {
+
+    // 窥孔优化
+    // 在 backfillLabel 之后对每个函数的指令序列按规则表反复改写直到不动点，
+    // 每轮结束时压缩序列并重新计算跳转目标
+    class PeepholePass final : public Pass {
+    public:
+        std::string name() const override { return "peephole"; }
+        Level level() const override { return CodeLevel; }
+
+        void runOnFunction(int funcId, std::vector<Instruction>&) override;
+    };
+}
@@ -0,0 +1,174 @@
+#include "profile_data.h"
+
+#include <sstream>
+
+namespace c0 {
+
+    namespace {
+        // .start 和每个函数的函数体
+        class FunctionRange {
+        public:
+            std::string name;
+            std::size_t begin;
+            std::size_t end;
+        };
+
+        std::vector<FunctionRange> functionRanges(const std::vector<Quadruple>& quads) {
+            std::vector<FunctionRange> ranges;
+            std::size_t i = 0;
+            for (; i < quads.size() && quads[i].getOperation() != QuadOpr::FUNC; i++)
+                ;
+            ranges.push_back({ ".start", 0, i });
+            while (i < quads.size()) {
+                FunctionRange range = { quads[i].getX().substr(1), i + 1, i + 1 };
+                for (i++; i < quads.size() && quads[i].getOperation() != QuadOpr::FUNC; i++)
+                    ;
+                range.end = i;
+                ranges.push_back(std::move(range));
+            }
+            return ranges;
+        }
+
+        bool isBranch(const Quadruple& quad) {
+            return quad.getOperation() == QuadOpr::BZ || quad.getOperation() == QuadOpr::BNZ;
+        }
+    }
+
+    std::vector<QuadBlock> quadBlocks(const std::vector<Quadruple>& quads, std::size_t begin, std::size_t end) {
+        std::vector<QuadBlock> blocks;
+        bool leader = true;
+        for (std::size_t i = begin; i < end; i++) {
+            auto opr = quads[i].getOperation();
+            if (leader || opr == QuadOpr::LAB)
+                blocks.push_back({ i, i });
+            blocks.back().last = i;
+            leader = opr == QuadOpr::GOTO || opr == QuadOpr::BZ || opr == QuadOpr::BNZ || opr == QuadOpr::SWT
+                  || opr == QuadOpr::RET;
+        }
+        return blocks;
+    }
+
+    ProfileData ProfileData::collect(const std::vector<Quadruple>& quads,
+                                     const std::vector<std::vector<std::uint32_t>>& offsets,
+                                     const Counter& executed, const Counter& taken) {
+        ProfileData data;
+        auto ranges = functionRanges(quads);
+        for (std::size_t f = 0; f < ranges.size() && f < offsets.size(); f++) {
+            const auto& range = ranges[f];
+            int funcId = (int)f - 1;
+            auto offset = [&](std::size_t i) { return (std::size_t)offsets[f][i - range.begin]; };
+
+            auto& fun = data.functions[range.name];
+            auto blocks = quadBlocks(quads, range.begin, range.end);
+            for (std::uint32_t b = 0; b < blocks.size(); b++) {
+                Block block;
+                block.count = executed(funcId, offset(blocks[b].first));
+                if (isBranch(quads[blocks[b].last])) {
+                    block.branch = true;
+                    block.taken = taken(funcId, offset(blocks[b].last));
+                }
+                fun.blocks.push_back(block);
+                for (std::size_t i = blocks[b].first; i <= blocks[b].last; i++) {
+                    if (quads[i].getOperation() == QuadOpr::CAL)
+                        fun.calls.push_back({ b, quads[i].getX().substr(1), executed(funcId, offset(i)) });
+                }
+            }
+        }
+        return data;
+    }
+
+    void ProfileData::write(std::ostream& out) const {
+        out << "c0-profile 1\n";
+        for (const auto& it : functions) {
+            const auto& fun = it.second;
+            out << "function " << it.first << ' ' << fun.blocks.size() << '\n';
+            for (std::size_t b = 0; b < fun.blocks.size(); b++) {
+                out << "block " << b << ' ' << fun.blocks[b].count;
+                if (fun.blocks[b].branch)
+                    out << " taken " << fun.blocks[b].taken;
+                out << '\n';
+            }
+            for (const auto& call : fun.calls)
+                out << "call " << call.block << ' ' << call.callee << ' ' << call.count << '\n';
+        }
+    }
+
+    std::optional<std::string> ProfileData::read(std::istream& in) {
+        functions.clear();
+        std::string line, word;
+        if (!std::getline(in, line) || line != "c0-profile 1")
+            return std::string("not a c0 profile");
+
+        Function* fun = nullptr;
+        for (int number = 2; std::getline(in, line); number++) {
+            std::istringstream ss(line);
+            if (!(ss >> word))
+                continue;
+            auto bad = [&] { return "line " + std::to_string(number) + ": " + line; };
+
+            if (word == "function") {
+                std::string name;
+                std::size_t count;
+                if (!(ss >> name >> count))
+                    return bad();
+                fun = &functions[name];
+                fun->blocks.assign(count, Block());
+            } else if (word == "block") {
+                std::size_t index;
+                Block block;
+                if (fun == nullptr || !(ss >> index >> block.count) || index >= fun->blocks.size())
+                    return bad();
+                if (ss >> word) {
+                    if (word != "taken" || !(ss >> block.taken))
+                        return bad();
+                    block.branch = true;
+                }
+                fun->blocks[index] = block;
+            } else if (word == "call") {
+                CallSite call;
+                if (fun == nullptr || !(ss >> call.block >> call.callee >> call.count)
+                    || call.block >= fun->blocks.size())
+                    return bad();
+                fun->calls.push_back(std::move(call));
+            } else
+                return bad();
+        }
+        return {};
+    }
+
+    std::vector<std::string> ProfileData::annotate(std::vector<Quadruple>& quads) const {
+        std::vector<std::string> mismatched;
+        for (const auto& range : functionRanges(quads)) {
+            auto it = functions.find(range.name);
+            if (it == functions.end())
+                continue;
+            const auto& fun = it->second;
+            auto blocks = quadBlocks(quads, range.begin, range.end);
+            if (blocks.size() != fun.blocks.size()) {
+                mismatched.push_back(range.name);
+                continue;
+            }
+
+            std::size_t call = 0;
+            for (std::uint32_t b = 0; b < blocks.size(); b++) {
+                for (std::size_t i = blocks[b].first; i <= blocks[b].last; i++)
+                    quads[i].setCount(fun.blocks[b].count);
+                if (fun.blocks[b].branch && isBranch(quads[blocks[b].last]))
+                    quads[blocks[b].last].setTaken(fun.blocks[b].taken);
+
+                // 调用点按顺序对应，被调用的函数不同时保留块的次数
+                for (; call < fun.calls.size() && fun.calls[call].block < b; call++)
+                    ;
+                for (std::size_t i = blocks[b].first; i <= blocks[b].last; i++) {
+                    if (quads[i].getOperation() != QuadOpr::CAL || call >= fun.calls.size()
+                        || fun.calls[call].block != b)
+                        continue;
+                    if (fun.calls[call].callee == quads[i].getX().substr(1))
+                        quads[i].setCount(fun.calls[call].count);
+                    call++;
+                }
+            }
+        }
+        return mismatched;
+    }
+}
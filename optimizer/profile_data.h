@@ -0,0 +1,78 @@
+#pragma once
+
+#include "instruction/quadruple.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 四元式的基本块 quads[first, last]
+    // 块从函数体的第一条四元式、LAB 以及 GOTO/BZ/BNZ/RET 之后的四元式开始
+    class QuadBlock {
+    public:
+        std::size_t first;
+        std::size_t last;
+    };
+
+    // 函数体 quads[begin, end)（不含 FUNC）的基本块
+    std::vector<QuadBlock> quadBlocks(const std::vector<Quadruple>& quads, std::size_t begin, std::size_t end);
+
+    // 剖析数据，由 run --profile-generate 写出，-O2 --profile-use 读入后标在四元式上供 quad 级的 pass 使用
+    // 以函数名和函数内基本块的序号为键，基本块由 Analyser 生成的、还没有经过任何 pass 的四元式划分，
+    // 源代码的改动只要不改变一个函数的基本块数，这个函数的剖析数据仍然可以使用
+    // 文本格式，每行一项：
+    //   c0-profile 1
+    //   function <name> <blocks>            .start 的名字为 .start
+    //   block <index> <count> [taken <n>]   以 BZ/BNZ 结束的块还有跳转的次数
+    //   call <block> <callee> <count>       同一块中的调用点按出现的顺序
+    class ProfileData {
+    public:
+        class Block {
+        public:
+            std::uint64_t count = 0;
+            std::uint64_t taken = 0;
+            bool branch = false;
+        };
+
+        class CallSite {
+        public:
+            std::uint32_t block;
+            std::string callee;
+            std::uint64_t count;
+        };
+
+        class Function {
+        public:
+            std::vector<Block> blocks;
+            std::vector<CallSite> calls;
+        };
+
+        std::map<std::string, Function> functions;
+
+        // funcId 为 -1 时是 .start，返回第 index 条指令执行或跳转的次数
+        using Counter = std::function<std::uint64_t(int funcId, std::size_t index)>;
+
+        // 由一次执行的指令计数得到剖析数据
+        // quads 为生成字节码的四元式，offsets[0] 为 .start、offsets[i + 1] 为函数 i 中每条四元式生成的第一条指令的下标，
+        // 见 Generator::setQuadOffsets
+        static ProfileData collect(const std::vector<Quadruple>& quads,
+                                   const std::vector<std::vector<std::uint32_t>>& offsets,
+                                   const Counter& executed, const Counter& taken);
+
+        void write(std::ostream&) const;
+        // 出错时返回错误信息
+        std::optional<std::string> read(std::istream&);
+
+        // 给 Analyser 生成的四元式标上执行次数，见 Quadruple::getCount
+        // 返回因为基本块数和剖析数据不一致（源代码改动过）而跳过的函数
+        std::vector<std::string> annotate(std::vector<Quadruple>&) const;
+    };
+}
@@ -0,0 +1,221 @@
+/* sigaltstack */
+#define _XOPEN_SOURCE 700
+
+#include "c0rt.h"
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 生成的代码中的 .start 和 main */
+void c0_start(void);
+int32_t c0f_main(void);
+
+/*
+ * 输入输出缓冲
+ * 输出写入 c0rt_out，满了、阻塞地读入之前、出错和退出时整块写出；整数不经过 printf 直接格式化。
+ * 输入用 read() 一次读入已有的一大块，在缓冲区上解析整数。没有 unistd.h 时退化为 stdio。
+ */
+#define C0RT_BUFFER_SIZE (1 << 16)
+
+static char c0rt_out[C0RT_BUFFER_SIZE];
+static size_t c0rt_out_size;
+static char c0rt_in[C0RT_BUFFER_SIZE];
+static size_t c0rt_in_pos, c0rt_in_end;
+
+#if defined(__unix__)
+#include <errno.h>
+#include <unistd.h>
+
+/* 只调用 write()，信号处理函数中也可以使用 */
+static void c0rt_flush(void) {
+    size_t done = 0;
+    while (done < c0rt_out_size) {
+        ssize_t n = write(1, c0rt_out + done, c0rt_out_size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+    c0rt_out_size = 0;
+}
+
+static size_t c0rt_read(char* buffer, size_t size) {
+    ssize_t n;
+    do
+        n = read(0, buffer, size);
+    while (n < 0 && errno == EINTR);
+    return n > 0 ? (size_t)n : 0;
+}
+#else
+static void c0rt_flush(void) {
+    fwrite(c0rt_out, 1, c0rt_out_size, stdout);
+    fflush(stdout);
+    c0rt_out_size = 0;
+}
+
+static size_t c0rt_read(char* buffer, size_t size) {
+    int c = getchar();
+    (void)size;
+    if (c == EOF)
+        return 0;
+    buffer[0] = (char)c;
+    return 1;
+}
+#endif
+
+static void c0rt_write(const char* s, size_t n) {
+    if (n > C0RT_BUFFER_SIZE - c0rt_out_size)
+        c0rt_flush();
+    if (n >= C0RT_BUFFER_SIZE) {
+        size_t k;
+        for (k = 0; k < n; k += C0RT_BUFFER_SIZE / 2) {
+            size_t chunk = n - k < C0RT_BUFFER_SIZE / 2 ? n - k : C0RT_BUFFER_SIZE / 2;
+            memcpy(c0rt_out, s + k, chunk);
+            c0rt_out_size = chunk;
+            c0rt_flush();
+        }
+        return;
+    }
+    memcpy(c0rt_out + c0rt_out_size, s, n);
+    c0rt_out_size += n;
+}
+
+/* 下一个输入字符，到达末尾时为 EOF；缓冲区读空时先写出输出，使提示先于等待输出 */
+static int c0rt_peek(void) {
+    if (c0rt_in_pos == c0rt_in_end) {
+        c0rt_flush();
+        c0rt_in_pos = 0;
+        c0rt_in_end = c0rt_read(c0rt_in, sizeof(c0rt_in));
+        if (c0rt_in_end == 0)
+            return EOF;
+    }
+    return (unsigned char)c0rt_in[c0rt_in_pos];
+}
+
+C0RT_NORETURN static void c0rt_error(const char* message, const char* detail) {
+    c0rt_flush();
+    if (detail)
+        fprintf(stderr, "Runtime error: function %s %s\n", detail, message);
+    else
+        fprintf(stderr, "Runtime error: %s\n", message);
+    exit(3);
+}
+
+void c0rt_print_int(int32_t value) {
+    char digits[10];
+    int n = 0;
+    uint32_t v = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    /* 符号和 10 位数字 */
+    if (C0RT_BUFFER_SIZE - c0rt_out_size < 11)
+        c0rt_flush();
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (value < 0)
+        c0rt_out[c0rt_out_size++] = '-';
+    while (n > 0)
+        c0rt_out[c0rt_out_size++] = digits[--n];
+}
+
+void c0rt_print_char(int32_t value) {
+    if (c0rt_out_size == C0RT_BUFFER_SIZE)
+        c0rt_flush();
+    c0rt_out[c0rt_out_size++] = (char)value;
+}
+
+void c0rt_print_string(const char* s) {
+    c0rt_write(s, strlen(s));
+}
+
+void c0rt_print_line(void) {
+    c0rt_print_char('\n');
+}
+
+void c0rt_print_format(const char* format, ...) {
+    const char* p;
+    va_list args;
+    va_start(args, format);
+    while ((p = strchr(format, '%')) != NULL) {
+        c0rt_write(format, (size_t)(p - format));
+        if (p[1] == 'd')
+            c0rt_print_int(va_arg(args, int32_t));
+        else
+            c0rt_print_char('%');
+        format = p[1] ? p + 2 : p + 1;
+    }
+    c0rt_print_string(format);
+    va_end(args);
+}
+
+/* 和 std::istream >> int32_t 一样跳过空白，读入超出范围或者没有数字时出错 */
+int32_t c0rt_scan_int(void) {
+    int c = c0rt_peek(), negative = 0, digits = 0;
+    long long value = 0;
+    for (; c == ' ' || (c >= '\t' && c <= '\r'); c = c0rt_peek())
+        c0rt_in_pos++;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        c0rt_in_pos++;
+        c = c0rt_peek();
+    }
+    for (; c >= '0' && c <= '9'; c = c0rt_peek()) {
+        value = value * 10 + (c - '0');
+        if (value > 2147483648LL)
+            c0rt_error("invalid input", NULL);
+        c0rt_in_pos++;
+        digits++;
+    }
+    if (digits == 0 || (!negative && value > 2147483647LL))
+        c0rt_error("invalid input", NULL);
+    return (int32_t)(negative ? -value : value);
+}
+
+void c0rt_division_by_zero(void) {
+    c0rt_error("division by zero", NULL);
+}
+
+void c0rt_fall_off(const char* name) {
+    c0rt_error("ends without return", name);
+}
+
+#if defined(__unix__)
+/* 递归太深耗尽栈时报告 stack overflow，信号处理函数在备用栈上执行 */
+static void c0rt_segv(int sig) {
+    static const char message[] = "Runtime error: stack overflow\n";
+    (void)sig;
+    c0rt_flush();
+    if (write(2, message, sizeof(message) - 1) < 0)
+        _exit(3);
+    _exit(3);
+}
+
+static void c0rt_install_handler(void) {
+    static char stack[1 << 16];
+    stack_t ss;
+    struct sigaction sa;
+    ss.ss_sp = stack;
+    ss.ss_size = sizeof(stack);
+    ss.ss_flags = 0;
+    if (sigaltstack(&ss, NULL) != 0)
+        return;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = c0rt_segv;
+    sa.sa_flags = SA_ONSTACK;
+    sigaction(SIGSEGV, &sa, NULL);
+}
+#else
+static void c0rt_install_handler(void) {}
+#endif
+
+int main(void) {
+    c0rt_install_handler();
+    c0_start();
+    c0f_main();
+    c0rt_flush();
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef C0RT_H
+#define C0RT_H
+
+/*
+ * cc0 -S native 生成的汇编和 cc0 -S c 生成的 C 代码使用的运行时
+ * 输出和 cc0 run 相同；出错时在 stderr 输出 "Runtime error: ..."，退出码为 3
+ */
+
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define C0RT_NORETURN __attribute__((noreturn))
+#else
+#define C0RT_NORETURN
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void c0rt_print_int(int32_t value);
+void c0rt_print_char(int32_t value);
+void c0rt_print_string(const char* s);
+void c0rt_print_line(void);
+/* format 中的 %d 依次换成之后的 int32_t 参数，%% 输出 %，同虚拟机的 fprint */
+void c0rt_print_format(const char* format, ...);
+int32_t c0rt_scan_int(void);
+
+C0RT_NORETURN void c0rt_division_by_zero(void);
+/* 函数执行到末尾没有返回 */
+C0RT_NORETURN void c0rt_fall_off(const char* name);
+
+/*
+ * cc0 -S c 生成的代码中的算术，和虚拟机一样按 32 位补码回绕
+ * 经过 uint32_t 运算避免有符号溢出；转回 int32_t 时 GCC、Clang 和 MSVC 都按补码截断
+ */
+static inline int32_t c0rt_add(int32_t x, int32_t y) {
+    return (int32_t)((uint32_t)x + (uint32_t)y);
+}
+
+static inline int32_t c0rt_sub(int32_t x, int32_t y) {
+    return (int32_t)((uint32_t)x - (uint32_t)y);
+}
+
+static inline int32_t c0rt_mul(int32_t x, int32_t y) {
+    return (int32_t)((uint32_t)x * (uint32_t)y);
+}
+
+static inline int32_t c0rt_neg(int32_t x) {
+    return (int32_t)(0u - (uint32_t)x);
+}
+
+/* 除数为 0 时出错，除数为 -1 时取负，INT32_MIN / -1 得到 INT32_MIN */
+static inline int32_t c0rt_div(int32_t x, int32_t y) {
+    if (y == 0)
+        c0rt_division_by_zero();
+    if (y == -1)
+        return c0rt_neg(x);
+    return x / y;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
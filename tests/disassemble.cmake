@@ -0,0 +1,19 @@
+# 比较 -s 的输出和 -c 后 --disassemble 的输出
+# 参数：CC0 为编译器，SOURCE 为 c0 源文件，OPTIONS 为分号分隔的编译选项，WORK 为临时目录
+get_filename_component(name "${SOURCE}" NAME_WE)
+string(MAKE_C_IDENTIFIER "${name}${OPTIONS}" tag)
+set(text "${WORK}/${tag}.s0")
+set(object "${WORK}/${tag}.o0")
+set(disassembled "${WORK}/${tag}.dis.s0")
+
+foreach(step "-s;${SOURCE};-o;${text}" "-c;${SOURCE};-o;${object}" "--disassemble;${object};-o;${disassembled}")
+	execute_process(COMMAND "${CC0}" ${OPTIONS} ${step} RESULT_VARIABLE result)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "cc0 ${OPTIONS} ${step} failed: ${result}")
+	endif()
+endforeach()
+
+execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${text}" "${disassembled}" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "${disassembled} differs from ${text}")
+endif()
@@ -0,0 +1,16 @@
+# 用 cc0 run 执行 INPUT，比较标准输出和 EXPECTED
+# 参数：CC0 为编译器，INPUT 为 c0 源文件或目标文件，OPTIONS 为分号分隔的选项，EXPECTED 为预期输出，
+# STDIN 不为空时作为标准输入
+if(STDIN)
+	set(stdin INPUT_FILE "${STDIN}")
+endif()
+execute_process(COMMAND "${CC0}" run ${OPTIONS} "${INPUT}" ${stdin}
+                OUTPUT_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "cc0 run ${OPTIONS} ${INPUT} failed: ${result}")
+endif()
+
+file(READ "${EXPECTED}" expected)
+if(NOT output STREQUAL expected)
+	message(FATAL_ERROR "cc0 run ${OPTIONS} ${INPUT} printed\n${output}\nexpected\n${expected}")
+endif()
@@ -114,7 +114,7 @@ namespace c0 {
 					case '\"':
 						current_state = DFAState::STRING_STATE;
 						break;
-					case ';':   case ',':
+					case ';':   case ',':   case ':':
                     case '+':   case '-':   case '*':
 					case '(':   case ')':   case '{':   case '}':
 						current_state = DFAState::SINGLE_SIGN_STATE;
@@ -289,6 +289,8 @@ namespace c0 {
                         return makeTk(TokenType::SEMICOLON, ';');
                     case ',':
                         return makeTk(TokenType::COMMA, ',');
+                    case ':':
+                        return makeTk(TokenType::COLON, ':');
                     case '+':
                         return makeTk(TokenType::PLUS_SIGN, '+');
                     case '-':
@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+ * 解释器的分派方式
+ * 支持 GCC/Clang 的 labels as values 时使用 direct-threaded 分派：解码后的每条指令记录处理代码的地址，
+ * 每条指令执行完直接跳到下一条指令的处理代码；否则退化为 switch 分派。
+ * 定义 C0VM_NO_COMPUTED_GOTO 可以强制使用 switch。
+ */
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(C0VM_NO_COMPUTED_GOTO)
+#define C0VM_THREADED 1
+#else
+#define C0VM_THREADED 0
+#endif
+
+#include <cstdint>
+
+namespace c0 {
+    // 32 位整数运算按补码回绕
+    inline std::int32_t wrap(std::uint32_t value) {
+        return (std::int32_t)value;
+    }
+}
@@ -0,0 +1,138 @@
+#include "io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace c0 {
+
+    void OutputBuffer::putInt(std::int32_t value) {
+        // 符号和 10 位数字
+        if (capacity - _size < 11)
+            drain();
+        char digits[10];
+        int n = 0;
+        std::uint32_t v = value < 0 ? 0u - (std::uint32_t)value : (std::uint32_t)value;
+        do {
+            digits[n++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        if (value < 0)
+            _buffer[_size++] = '-';
+        while (n > 0)
+            _buffer[_size++] = digits[--n];
+    }
+
+    void OutputBuffer::write(const char* data, std::size_t n) {
+        if (n > capacity - _size)
+            drain();
+        if (n >= capacity) {
+            _out.write(data, (std::streamsize)n);
+            return;
+        }
+        std::memcpy(_buffer.get() + _size, data, n);
+        _size += n;
+    }
+
+    bool OutputBuffer::putFormat(const std::string& format, const std::int32_t* args, int n) {
+        int used = 0;
+        std::size_t from = 0;
+        for (std::size_t k = format.find('%'); k != std::string::npos; k = format.find('%', from)) {
+            write(format.data() + from, k - from);
+            if (k + 1 < format.size() && format[k + 1] == 'd') {
+                if (used == n)
+                    return false;
+                putInt(args[used++]);
+            } else
+                putChar('%');
+            from = std::min(k + 2, format.size());
+        }
+        write(format.data() + from, format.size() - from);
+        return true;
+    }
+
+    void OutputBuffer::drain() {
+        if (_size > 0)
+            _out.write(_buffer.get(), (std::streamsize)_size);
+        _size = 0;
+    }
+
+    void OutputBuffer::flush() {
+        drain();
+        _out.flush();
+    }
+
+    InputBuffer::InputBuffer(std::istream& in, OutputBuffer* tie)
+        : _in(in), _tie(tie), _fd(-1), _buffer(new char[capacity]), _pos(0), _end(0) {
+#if defined(__unix__)
+        if (&in == &std::cin)
+            _fd = STDIN_FILENO;
+#endif
+    }
+
+    bool InputBuffer::fill() {
+        if (_tie)
+            _tie->flush();
+        _pos = _end = 0;
+#if defined(__unix__)
+        if (_fd >= 0) {
+            ssize_t n;
+            do
+                n = ::read(_fd, _buffer.get(), capacity);
+            while (n < 0 && errno == EINTR);
+            if (n <= 0)
+                return false;
+            _end = (std::size_t)n;
+            return true;
+        }
+#endif
+        auto* buf = _in.rdbuf();
+        if (buf == nullptr)
+            return false;
+        // 没有已经缓冲的字符时只等待一个，不等缓冲区填满
+        std::streamsize avail = buf->in_avail();
+        std::streamsize n = buf->sgetn(_buffer.get(), avail > 0 ? std::min(avail, (std::streamsize)capacity) : 1);
+        if (n <= 0)
+            return false;
+        _end = (std::size_t)n;
+        return true;
+    }
+
+    std::optional<std::int32_t> InputBuffer::getInt() {
+        int c = peek();
+        // 空白同 C locale 的 isspace
+        for (; c == ' ' || (c >= '\t' && c <= '\r'); c = peek())
+            _pos++;
+        bool negative = false;
+        if (c == '-' || c == '+') {
+            negative = c == '-';
+            _pos++;
+            c = peek();
+        }
+        std::uint64_t limit = negative ? 2147483648u : 2147483647u, value = 0;
+        int digits = 0;
+        for (; c >= '0' && c <= '9'; c = peek()) {
+            value = value * 10 + (std::uint64_t)(c - '0');
+            if (value > limit)
+                return {};
+            _pos++;
+            digits++;
+        }
+        if (digits == 0)
+            return {};
+        return negative ? (std::int32_t)(0u - (std::uint32_t)value) : (std::int32_t)value;
+    }
+
+    std::optional<char> InputBuffer::getChar() {
+        int c = peek();
+        if (c < 0)
+            return {};
+        _pos++;
+        return (char)c;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace c0 {
+
+    // 解释器和 JIT 的输出缓冲
+    // 整数不经过 locale 直接格式化到缓冲区中，缓冲区满、阻塞地读入之前和执行结束时整块写到 ostream
+    class OutputBuffer final {
+    public:
+        static constexpr std::size_t capacity = 1 << 16;
+
+        explicit OutputBuffer(std::ostream& out) : _out(out), _buffer(new char[capacity]), _size(0) {}
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+        ~OutputBuffer() { flush(); }
+
+        void putChar(char c) {
+            if (_size == capacity)
+                drain();
+            _buffer[_size++] = c;
+        }
+        void putInt(std::int32_t value);
+        void write(const char* data, std::size_t n);
+        void write(const std::string& s) { write(s.data(), s.size()); }
+        // fprint：format 中的 %d 依次换成 args 中的 n 个值，%% 输出 %，值不够时返回 false
+        bool putFormat(const std::string& format, const std::int32_t* args, int n);
+
+        // 写出缓冲区中的内容并刷新 ostream
+        void flush();
+
+    private:
+        std::ostream& _out;
+        std::unique_ptr<char[]> _buffer;
+        std::size_t _size;
+
+        // 写出缓冲区中的内容，不刷新 ostream
+        void drain();
+    };
+
+    // 离开作用域时 flush，解释器出错返回时也写出之前的输出
+    class FlushGuard final {
+    public:
+        explicit FlushGuard(OutputBuffer& out) : _out(out) {}
+        ~FlushGuard() { _out.flush(); }
+
+    private:
+        OutputBuffer& _out;
+    };
+
+    // 解释器和 JIT 的输入缓冲
+    // std::cin 在 Unix 上直接用 read() 读标准输入，一次读入已有的一大块而不等缓冲区填满；
+    // 其它 istream 从它的 streambuf 读入已经缓冲的字符。整数在缓冲区上解析，规则同 std::istream >> std::int32_t
+    // 缓冲区读空、需要阻塞地读入时先 flush tie，使提示先于等待输出
+    class InputBuffer final {
+    public:
+        static constexpr std::size_t capacity = 1 << 16;
+
+        InputBuffer(std::istream& in, OutputBuffer* tie);
+        InputBuffer(const InputBuffer&) = delete;
+        InputBuffer& operator=(const InputBuffer&) = delete;
+
+        // 跳过空白读入一个整数，没有数字、超出范围或者到达末尾时返回空
+        std::optional<std::int32_t> getInt();
+        // 读入一个字符，不跳过空白
+        std::optional<char> getChar();
+
+    private:
+        std::istream& _in;
+        OutputBuffer* _tie;
+        // 标准输入的文件描述符，不直接读文件时为 -1
+        int _fd;
+        std::unique_ptr<char[]> _buffer;
+        std::size_t _pos;
+        std::size_t _end;
+
+        // 下一个字符，到达末尾时为 -1
+        int peek() {
+            if (_pos == _end && !fill())
+                return -1;
+            return (unsigned char)_buffer[_pos];
+        }
+        bool fill();
+    };
+}
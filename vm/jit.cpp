@@ -0,0 +1,693 @@
+#include "jit.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define C0VM_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define C0VM_JIT 0
+#endif
+
+namespace c0 {
+
+    // 本地代码的返回值
+    enum JitStatus : int {
+        jitOk = 0,
+        // 错误信息在 Jit::_error 中
+        jitError,
+        jitDivisionByZero,
+        jitInvalidAddress,
+        jitStackOverflow,
+        jitFallOff,
+    };
+
+    // 生成的代码调用的运行时函数
+    // 本地函数和它们的参数都是 (JitContext*, ...)，返回 JitStatus
+    class JitRuntime {
+    public:
+        static int interpret(JitContext* context, std::int32_t* fp, const void*, int funcId) {
+            auto err = context->jit->_interpreter(funcId, fp);
+            if (!err)
+                return jitOk;
+            context->jit->_error = std::move(err);
+            return jitError;
+        }
+
+        static int printInt(JitContext* context, std::int32_t value) {
+            context->jit->_out.putInt(value);
+            return jitOk;
+        }
+
+        static int printChar(JitContext* context, std::int32_t value) {
+            context->jit->_out.putChar((char)value);
+            return jitOk;
+        }
+
+        static int printString(JitContext* context, std::int32_t index) {
+            const auto& constants = context->jit->_constants;
+            if (index < 0 || index >= (std::int32_t)constants.size()) {
+                context->jit->_error = "invalid constant index";
+                return jitError;
+            }
+            context->jit->_out.write(constants[index]);
+            return jitOk;
+        }
+
+        static int printFormat(JitContext* context, std::int32_t index, const std::int32_t* args, std::int32_t n) {
+            if (!context->jit->_out.putFormat(context->jit->_constants[index], args, n)) {
+                context->jit->_error = "too few fprint arguments";
+                return jitError;
+            }
+            return jitOk;
+        }
+
+        static int printLine(JitContext* context) {
+            context->jit->_out.putChar('\n');
+            return jitOk;
+        }
+
+        static int scanInt(JitContext* context, std::int32_t* out) {
+            auto value = context->jit->_in.getInt();
+            if (!value) {
+                context->jit->_error = "invalid input";
+                return jitError;
+            }
+            *out = value.value();
+            return jitOk;
+        }
+
+        static int scanChar(JitContext* context, std::int32_t* out) {
+            auto c = context->jit->_in.getChar();
+            if (!c) {
+                context->jit->_error = "invalid input";
+                return jitError;
+            }
+            *out = (unsigned char)c.value();
+            return jitOk;
+        }
+    };
+
+    using NativeEntry = int (*)(JitContext*, std::int32_t*, const void*, int);
+
+#if C0VM_JIT
+    namespace {
+        enum Register {
+            rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+            r8, r9, r10, r11, r12, r13, r14, r15,
+        };
+
+        // 条件码，和 0x70/0x0f 0x80 系列跳转的低 4 位相同
+        enum Condition {
+            condE = 0x4, condNE = 0x5, condBE = 0x6, condA = 0x7,
+            condL = 0xc, condGE = 0xd, condLE = 0xe, condG = 0xf,
+            condB = 0x2, condAE = 0x3,
+        };
+
+        // 只实现模板用到的指令
+        class Assembler {
+        public:
+            std::vector<u1> code;
+
+            int newLabel() {
+                _labels.push_back(-1);
+                return (int)_labels.size() - 1;
+            }
+
+            void bind(int label) { _labels[label] = (int)code.size(); }
+            int offset(int label) const { return _labels[label]; }
+
+            void jmp(int label) {
+                byte(0xe9);
+                fixup(label);
+            }
+
+            // lea reg, [rip + label]
+            void leaLabel(int reg, int label) {
+                rex(true, reg, 0);
+                byte(0x8d);
+                byte((u1)(0x05 | (reg & 7) << 3));
+                fixup(label);
+            }
+
+            void jcc(int cond, int label) {
+                byte(0x0f);
+                byte(0x80 | cond);
+                fixup(label);
+            }
+
+            // 回填 rel32
+            void finish() {
+                for (const auto& f : _fixups) {
+                    std::int32_t rel = _labels[f.second] - (f.first + 4);
+                    std::memcpy(&code[f.first], &rel, 4);
+                }
+                _fixups.clear();
+            }
+
+            void byte(u1 b) { code.push_back(b); }
+
+            void dword(std::int32_t v) {
+                for (int i = 0; i < 4; i++)
+                    byte((u1)((std::uint32_t)v >> (8 * i)));
+            }
+
+            void qword(std::uint64_t v) {
+                for (int i = 0; i < 8; i++)
+                    byte((u1)(v >> (8 * i)));
+            }
+
+            // op reg, [base + disp]
+            void mem(std::initializer_list<u1> opcode, bool wide, int reg, int base, std::int32_t disp) {
+                rex(wide, reg, base);
+                for (auto b : opcode)
+                    byte(b);
+                bool small = disp >= -128 && disp <= 127;
+                byte((u1)((small ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7)));
+                if ((base & 7) == rsp)
+                    byte(0x24);
+                if (small)
+                    byte((u1)disp);
+                else
+                    dword(disp);
+            }
+
+            // op reg, rm
+            void regs(std::initializer_list<u1> opcode, bool wide, int reg, int rm) {
+                rex(wide, reg, rm);
+                for (auto b : opcode)
+                    byte(b);
+                byte((u1)(0xc0 | (reg & 7) << 3 | (rm & 7)));
+            }
+
+            // op reg, [rbx + rax * 4]
+            void indexed(u1 opcode, int reg) {
+                byte(opcode);
+                byte((u1)(0x04 | (reg & 7) << 3));
+                byte(0x83);
+            }
+
+            void push(int reg) {
+                if (reg >= 8)
+                    byte(0x41);
+                byte((u1)(0x50 | (reg & 7)));
+            }
+
+            void pop(int reg) {
+                if (reg >= 8)
+                    byte(0x41);
+                byte((u1)(0x58 | (reg & 7)));
+            }
+
+            void movImm64(int reg, std::uint64_t value) {
+                byte((u1)(0x48 | (reg >= 8 ? 1 : 0)));
+                byte((u1)(0xb8 | (reg & 7)));
+                qword(value);
+            }
+
+            void movImm32(int reg, std::int32_t value) {
+                if (reg >= 8)
+                    byte(0x41);
+                byte((u1)(0xb8 | (reg & 7)));
+                dword(value);
+            }
+
+            void callAbsolute(const void* target) {
+                movImm64(rax, (std::uint64_t)(std::uintptr_t)target);
+                regs({ 0xff }, false, 2, rax);
+            }
+
+        private:
+            std::vector<int> _labels;
+            std::vector<std::pair<int, int>> _fixups;
+
+            void rex(bool wide, int reg, int rm) {
+                u1 prefix = (u1)(0x40 | (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0));
+                if (prefix != 0x40)
+                    byte(prefix);
+            }
+
+            void fixup(int label) {
+                _fixups.emplace_back((int)code.size(), label);
+                dword(0);
+            }
+        };
+
+        int jumpCondition(opCode op) {
+            switch (op) {
+                case opCode::je:
+                    return condE;
+                case opCode::jne:
+                    return condNE;
+                case opCode::jl:
+                    return condL;
+                case opCode::jge:
+                    return condGE;
+                case opCode::jg:
+                    return condG;
+                default:
+                    return condLE;
+            }
+        }
+
+        // 栈上的槽中是否是 loada 压入的已知地址
+        class KnownAddress {
+        public:
+            enum Kind { None, Local, Global };
+            Kind kind;
+            std::int32_t offset;
+        };
+
+        // 把一个函数翻译成机器码
+        class Compiler {
+        public:
+            Compiler(const std::vector<CallSignature>& functions, int paramSize)
+                : _functions(functions), _paramSize(paramSize) {}
+
+            bool compile(const std::vector<Instruction>& code, std::vector<u1>& out, std::vector<std::int32_t>& resume);
+
+        private:
+            const std::vector<CallSignature>& _functions;
+            int _paramSize;
+            Assembler _as;
+            int _exit = 0;
+            int _divisionByZero = 0;
+            int _invalidAddress = 0;
+
+            static std::int32_t slot(int k) { return 4 * k; }
+
+            void load(int reg, int k) { _as.mem({ 0x8b }, false, reg, r12, slot(k)); }
+            void store(int k, int reg) { _as.mem({ 0x89 }, false, reg, r12, slot(k)); }
+
+            void storeImm(int k, std::int32_t value) {
+                _as.mem({ 0xc7 }, false, 0, r12, slot(k));
+                _as.dword(value);
+            }
+
+            // ecx = fp + n，即 fp 之上第 n 个槽的地址值
+            void frameIndex(int reg, int n) { _as.mem({ 0x8d }, false, reg, r13, n); }
+
+            // 地址 eax 不小于 fp + depth 时报错
+            void checkAddress(int depth) {
+                frameIndex(rcx, depth);
+                _as.regs({ 0x39 }, false, rcx, rax);
+                _as.jcc(condAE, _invalidAddress);
+            }
+
+            void callRuntime(const void* target) {
+                _as.callAbsolute(target);
+                _as.regs({ 0x85 }, false, rax, rax);
+                _as.jcc(condNE, _exit);
+            }
+
+            void setContextArg() { _as.regs({ 0x89 }, true, r14, rdi); }
+        };
+
+        bool Compiler::compile(const std::vector<Instruction>& code, std::vector<u1>& out,
+                               std::vector<std::int32_t>& resume) {
+            std::vector<int> depth;
+            std::vector<bool> target;
+            if (stackDepths(code, _paramSize, _functions, "", depth, target))
+                return false;
+
+            int n = (int)code.size();
+            // 本地代码返回后调用者按 returnsValue 恢复栈顶，ret 和 iret 混用时无法确定
+            bool ret = false, iret = false;
+            for (const auto& ins : code) {
+                ret |= ins.getOpr() == opCode::ret;
+                iret |= ins.getOpr() == opCode::iRet;
+            }
+            if (ret && iret)
+                return false;
+
+            int frameSize = frameOf(code, depth, _paramSize).max_stack + 1;
+
+            std::vector<int> labels(n + 1);
+            for (auto& label : labels)
+                label = _as.newLabel();
+            _exit = _as.newLabel();
+            _divisionByZero = _as.newLabel();
+            _invalidAddress = _as.newLabel();
+            int overflow = _as.newLabel(), body = _as.newLabel();
+
+            // 参数：rdi = context, rsi = fp, rdx = 恢复执行的地址
+            // 保存：rbx = 栈底，r12 = fp，r13 = fp 的下标，r14 = context，r15 = 恢复执行的地址
+            _as.push(rbx);
+            _as.push(r12);
+            _as.push(r13);
+            _as.push(r14);
+            _as.push(r15);
+            _as.regs({ 0x89 }, true, rdi, r14);
+            _as.regs({ 0x89 }, true, rsi, r12);
+            _as.regs({ 0x89 }, true, rdx, r15);
+            _as.mem({ 0x8b }, true, rbx, r14, offsetof(JitContext, stack));
+            _as.regs({ 0x89 }, true, r12, r13);
+            _as.regs({ 0x29 }, true, rbx, r13);
+            _as.regs({ 0xc1 }, true, 7, r13);
+            _as.byte(2);
+            _as.mem({ 0xff }, false, 0, r14, offsetof(JitContext, depth));
+            _as.mem({ 0x8d }, true, rax, r12, slot(frameSize));
+            _as.mem({ 0x3b }, true, rax, r14, offsetof(JitContext, limit));
+            _as.jcc(condA, overflow);
+            _as.regs({ 0x85 }, true, r15, r15);
+            _as.jcc(condE, body);
+            _as.regs({ 0xff }, false, 4, r15);
+            _as.bind(body);
+
+            std::vector<KnownAddress> known;
+            for (int i = 0; i < n; i++) {
+                _as.bind(labels[i]);
+                if (target[i])
+                    known.clear();
+                int d = depth[i];
+                if (d < 0)
+                    continue;
+                known.resize(d, { KnownAddress::None, 0 });
+
+                const auto& ins = code[i];
+                bool fuseNext = i + 1 < n && !target[i + 1];
+                int pops, pushes;
+                stackEffect(ins, _functions, pops, pushes);
+                switch (ins.getOpr()) {
+                    case opCode::nop: case opCode::pop1: case opCode::popN:
+                        break;
+                    case opCode::biPush: case opCode::iPush: case opCode::loadC:
+                        storeImm(d, ins.getX());
+                        break;
+                    case opCode::loadA: {
+                        std::int32_t o = ins.getY();
+                        bool local = ins.getX() == 0;
+                        // 只有栈帧内已经压入的槽可以直接访问，其它地址留到执行时检查
+                        bool inFrame = local && o >= 0 && o < d;
+                        if (fuseNext && code[i + 1].getOpr() == opCode::iLoad && inFrame) {
+                            // loada; iload
+                            load(rax, o);
+                            store(d, rax);
+                            _as.bind(labels[++i]);
+                            break;
+                        }
+                        if (local) {
+                            frameIndex(rax, o);
+                            store(d, rax);
+                        } else
+                            storeImm(d, o);
+                        known.push_back({ inFrame ? KnownAddress::Local : local ? KnownAddress::None : KnownAddress::Global, o });
+                        break;
+                    }
+                    case opCode::iLoad:
+                        if (known[d - 1].kind == KnownAddress::Local && known[d - 1].offset < d)
+                            load(rax, known[d - 1].offset);
+                        else {
+                            load(rax, d - 1);
+                            checkAddress(d);
+                            _as.indexed(0x8b, rax);
+                        }
+                        store(d - 1, rax);
+                        break;
+                    case opCode::iStore:
+                        if (known[d - 2].kind == KnownAddress::Local && known[d - 2].offset < d) {
+                            std::int32_t o = known[d - 2].offset;
+                            load(rax, d - 1);
+                            store(o, rax);
+                            if (o < d - 2)
+                                known[o].kind = KnownAddress::None;
+                        } else {
+                            load(rax, d - 2);
+                            checkAddress(d);
+                            load(rcx, d - 1);
+                            _as.indexed(0x89, rcx);
+                            known.clear();
+                        }
+                        break;
+                    case opCode::iAdd: case opCode::iSub: case opCode::iMul:
+                        load(rax, d - 2);
+                        if (ins.getOpr() == opCode::iAdd)
+                            _as.mem({ 0x03 }, false, rax, r12, slot(d - 1));
+                        else if (ins.getOpr() == opCode::iSub)
+                            _as.mem({ 0x2b }, false, rax, r12, slot(d - 1));
+                        else
+                            _as.mem({ 0x0f, 0xaf }, false, rax, r12, slot(d - 1));
+                        store(d - 2, rax);
+                        break;
+                    case opCode::iDiv: {
+                        int divide = _as.newLabel(), done = _as.newLabel();
+                        load(rcx, d - 1);
+                        _as.regs({ 0x85 }, false, rcx, rcx);
+                        _as.jcc(condE, _divisionByZero);
+                        load(rax, d - 2);
+                        // INT_MIN / -1 溢出，取负
+                        _as.regs({ 0x81 }, false, 7, rcx);
+                        _as.dword(-1);
+                        _as.jcc(condNE, divide);
+                        _as.regs({ 0xf7 }, false, 3, rax);
+                        _as.jmp(done);
+                        _as.bind(divide);
+                        _as.byte(0x99);
+                        _as.regs({ 0xf7 }, false, 7, rcx);
+                        _as.bind(done);
+                        store(d - 2, rax);
+                        break;
+                    }
+                    case opCode::iNeg:
+                        _as.mem({ 0xf7 }, false, 3, r12, slot(d - 1));
+                        break;
+                    case opCode::i2c:
+                        _as.mem({ 0x81 }, false, 4, r12, slot(d - 1));
+                        _as.dword(0xff);
+                        break;
+                    case opCode::iCmp:
+                        load(rax, d - 2);
+                        _as.mem({ 0x3b }, false, rax, r12, slot(d - 1));
+                        if (fuseNext && isJumpInstruction(code[i + 1].getOpr()) && code[i + 1].getOpr() != opCode::jmp) {
+                            // icmp; jXX
+                            _as.jcc(jumpCondition(code[i + 1].getOpr()), labels[code[i + 1].getX()]);
+                            _as.bind(labels[++i]);
+                            break;
+                        }
+                        _as.regs({ 0x0f, 0x9f }, false, 0, rax);
+                        _as.regs({ 0x0f, 0x9c }, false, 0, rcx);
+                        _as.regs({ 0x0f, 0xb6 }, false, rax, rax);
+                        _as.regs({ 0x0f, 0xb6 }, false, rcx, rcx);
+                        _as.regs({ 0x29 }, false, rcx, rax);
+                        store(d - 2, rax);
+                        break;
+                    case opCode::jmp:
+                        _as.jmp(labels[ins.getX()]);
+                        break;
+                    case opCode::je: case opCode::jne: case opCode::jl:
+                    case opCode::jge: case opCode::jg: case opCode::jle:
+                        _as.mem({ 0x81 }, false, 7, r12, slot(d - 1));
+                        _as.dword(0);
+                        _as.jcc(jumpCondition(ins.getOpr()), labels[ins.getX()]);
+                        break;
+                    case opCode::tableSwitch: {
+                        // 表中的 jmp 都编译成 5 字节的 jmp rel32，第 k 条的地址为第一条的地址 + 5k
+                        int count = ins.getY();
+                        load(rax, d - 1);
+                        _as.regs({ 0x81 }, false, 5, rax);
+                        _as.dword(ins.getX());
+                        _as.regs({ 0x81 }, false, 7, rax);
+                        _as.dword(count);
+                        _as.jcc(condAE, labels[i + 1 + count]);
+                        _as.leaLabel(rcx, labels[i + 1]);
+                        // lea rax, [rax + rax * 4]
+                        _as.byte(0x48);
+                        _as.byte(0x8d);
+                        _as.byte(0x04);
+                        _as.byte(0x80);
+                        _as.regs({ 0x01 }, true, rax, rcx);
+                        _as.regs({ 0xff }, false, 4, rcx);
+                        break;
+                    }
+                    case opCode::call: {
+                        int f = ins.getX();
+                        int slow = _as.newLabel(), done = _as.newLabel();
+                        setContextArg();
+                        _as.mem({ 0x8d }, true, rsi, r12, slot(d - _functions[f].paramSize));
+                        _as.regs({ 0x31 }, false, rdx, rdx);
+                        _as.movImm32(rcx, f);
+                        _as.mem({ 0x81 }, false, 7, r14, offsetof(JitContext, depth));
+                        _as.dword(Jit::maxDepth);
+                        _as.jcc(condGE, slow);
+                        _as.mem({ 0x8b }, true, rax, r14, offsetof(JitContext, entries));
+                        _as.mem({ 0xff }, false, 2, rax, 8 * f);
+                        _as.jmp(done);
+                        _as.bind(slow);
+                        _as.callAbsolute((const void*)&JitRuntime::interpret);
+                        _as.bind(done);
+                        _as.regs({ 0x85 }, false, rax, rax);
+                        _as.jcc(condNE, _exit);
+                        // 被调用者可能通过地址改写调用者的栈帧
+                        known.clear();
+                        break;
+                    }
+                    case opCode::ret:
+                        _as.regs({ 0x31 }, false, rax, rax);
+                        _as.jmp(_exit);
+                        break;
+                    case opCode::iRet:
+                        load(rax, d - 1);
+                        store(0, rax);
+                        _as.regs({ 0x31 }, false, rax, rax);
+                        _as.jmp(_exit);
+                        break;
+                    case opCode::iPrint: case opCode::cPrint: case opCode::sPrint:
+                        setContextArg();
+                        load(rsi, d - 1);
+                        callRuntime(ins.getOpr() == opCode::iPrint ? (const void*)&JitRuntime::printInt
+                                    : ins.getOpr() == opCode::cPrint ? (const void*)&JitRuntime::printChar
+                                    : (const void*)&JitRuntime::printString);
+                        break;
+                    // 参数在栈帧中从 d - n 开始
+                    case opCode::fPrint:
+                        setContextArg();
+                        _as.movImm32(rsi, ins.getX());
+                        _as.mem({ 0x8d }, true, rdx, r12, slot(d - ins.getY()));
+                        _as.movImm32(rcx, ins.getY());
+                        callRuntime((const void*)&JitRuntime::printFormat);
+                        break;
+                    case opCode::printL:
+                        setContextArg();
+                        callRuntime((const void*)&JitRuntime::printLine);
+                        break;
+                    case opCode::iScan: case opCode::cScan:
+                        setContextArg();
+                        _as.mem({ 0x8d }, true, rsi, r12, slot(d));
+                        callRuntime(ins.getOpr() == opCode::iScan ? (const void*)&JitRuntime::scanInt
+                                    : (const void*)&JitRuntime::scanChar);
+                        break;
+                    default:
+                        return false;
+                }
+                // 结果槽中不再是已知的地址，只有 loada 压入已知地址
+                if (ins.getOpr() != opCode::loadA) {
+                    known.resize(d - pops, { KnownAddress::None, 0 });
+                    known.resize(d - pops + pushes, { KnownAddress::None, 0 });
+                }
+            }
+
+            // 执行到末尾
+            _as.bind(labels[n]);
+            _as.movImm32(rax, jitFallOff);
+            _as.jmp(_exit);
+            _as.bind(overflow);
+            _as.movImm32(rax, jitStackOverflow);
+            _as.jmp(_exit);
+            _as.bind(_divisionByZero);
+            _as.movImm32(rax, jitDivisionByZero);
+            _as.jmp(_exit);
+            _as.bind(_invalidAddress);
+            _as.movImm32(rax, jitInvalidAddress);
+            _as.bind(_exit);
+            _as.mem({ 0xff }, false, 1, r14, offsetof(JitContext, depth));
+            _as.pop(r15);
+            _as.pop(r14);
+            _as.pop(r13);
+            _as.pop(r12);
+            _as.pop(rbx);
+            _as.byte(0xc3);
+            _as.finish();
+
+            resume.assign(n + 1, -1);
+            for (int i = 0; i <= n; i++) {
+                if (target[i] && depth[i] >= 0)
+                    resume[i] = _as.offset(labels[i]);
+            }
+            out = std::move(_as.code);
+            return true;
+        }
+    }
+#endif
+
+    Jit::Jit(std::vector<std::int32_t>& stack, std::vector<CallSignature> functions,
+             const std::vector<std::string>& constants, InputBuffer& in, OutputBuffer& out, Interpreter interpreter)
+        : _functions(std::move(functions)), _constants(constants), _in(in), _out(out),
+          _interpreter(std::move(interpreter)), _native({}), _entries({}), _context(), _error() {
+        _native.resize(_functions.size(), { nullptr, 0, {} });
+        _entries.resize(_functions.size(), (const void*)&JitRuntime::interpret);
+        _context.stack = stack.data();
+        _context.limit = stack.data() + stack.size();
+        _context.entries = _entries.data();
+        _context.depth = 0;
+        _context.jit = this;
+    }
+
+    Jit::~Jit() {
+#if C0VM_JIT
+        for (auto& native : _native) {
+            if (native.code)
+                munmap(native.code, native.mapped);
+        }
+#endif
+    }
+
+    bool Jit::supported() {
+        return C0VM_JIT;
+    }
+
+    bool Jit::compile(int funcId, const std::vector<Instruction>& code) {
+#if C0VM_JIT
+        if (compiled(funcId))
+            return true;
+        std::vector<u1> machineCode;
+        std::vector<std::int32_t> resume;
+        Compiler compiler(_functions, _functions[funcId].paramSize);
+        if (!compiler.compile(code, machineCode, resume))
+            return false;
+
+        // 写入后改为只读可执行
+        std::size_t page = (std::size_t)sysconf(_SC_PAGESIZE);
+        std::size_t size = (machineCode.size() + page - 1) / page * page;
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return false;
+        std::memcpy(memory, machineCode.data(), machineCode.size());
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return false;
+        }
+        _native[funcId] = { memory, size, std::move(resume) };
+        _entries[funcId] = memory;
+        return true;
+#else
+        (void)funcId;
+        (void)code;
+        return false;
+#endif
+    }
+
+    std::size_t Jit::compiledFunctions() const {
+        std::size_t count = 0;
+        for (const auto& native : _native)
+            count += native.code != nullptr;
+        return count;
+    }
+
+    const void* Jit::resumePoint(int funcId, int index) const {
+        const auto& native = _native[funcId];
+        if (!native.code || index < 0 || index >= (int)native.resume.size() || native.resume[index] < 0)
+            return nullptr;
+        return (const u1*)native.code + native.resume[index];
+    }
+
+    std::optional<std::string> Jit::run(int funcId, std::int32_t* fp, const void* resume) {
+        auto entry = (NativeEntry)_entries[funcId];
+        _error.reset();
+        switch (entry(&_context, fp, resume, funcId)) {
+            case jitOk:
+                return {};
+            case jitDivisionByZero:
+                return std::string("division by zero");
+            case jitInvalidAddress:
+                return std::string("invalid address");
+            case jitStackOverflow:
+                return std::string("stack overflow");
+            case jitFallOff:
+                return "function ends without return";
+            default:
+                return _error ? _error : std::string("native code failed");
+        }
+    }
+}
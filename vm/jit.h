@@ -0,0 +1,91 @@
+#pragma once
+
+#include "stack_depth.h"
+#include "io.h"
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    class Jit;
+
+    // 生成的代码通过它访问运行时，成员的偏移写死在生成的代码中
+    class JitContext {
+    public:
+        std::int32_t* stack;
+        std::int32_t* limit;
+        // 每个函数的入口，没有编译的函数指向回到解释器的入口
+        const void** entries;
+        // 正在执行的本地代码的嵌套层数
+        std::int32_t depth;
+        Jit* jit;
+    };
+
+    // x86-64 Linux 上的模板 JIT
+    // 每条字节码指令翻译成一段固定的机器码，操作数仍然放在 VM 的栈上；
+    // 每条指令处的栈深度在编译时已知，所以栈顶不需要寄存器，直接按 fp 的偏移寻址。
+    // 本地代码和解释器共用同一个栈，因此可以在任意跳转目标处从解释器进入本地代码。
+    // 输出输入、除零和地址检查调用运行时的函数或者返回错误码，由调用者转成错误信息。
+    class Jit final {
+    public:
+        // 本地代码调用没有编译的函数时，由它在解释器中执行，fp 指向参数
+        using Interpreter = std::function<std::optional<std::string>(int funcId, std::int32_t* fp)>;
+
+        // 本地代码的嵌套层数上限，超过后调用回到解释器，避免耗尽机器栈
+        static constexpr std::int32_t maxDepth = 1 << 16;
+
+        Jit(std::vector<std::int32_t>& stack, std::vector<CallSignature> functions,
+            const std::vector<std::string>& constants, InputBuffer& in, OutputBuffer& out, Interpreter interpreter);
+        Jit(Jit&&) = delete;
+        Jit(const Jit&) = delete;
+        Jit& operator=(Jit) = delete;
+        ~Jit();
+
+        // 当前平台是否支持
+        static bool supported();
+
+        // 编译函数，失败时函数留在解释器中执行
+        bool compile(int funcId, const std::vector<Instruction>& code);
+        bool compiled(int funcId) const { return _native[funcId].code != nullptr; }
+        std::size_t compiledFunctions() const;
+
+        // 从第 index 条字节码指令开始执行函数的本地代码的地址，只有跳转目标可以进入
+        const void* resumePoint(int funcId, int index) const;
+
+        // 执行函数的本地代码直到它返回，fp 指向参数；resume 为空时从头执行
+        // 有返回值时返回值在 fp[0]
+        std::optional<std::string> run(int funcId, std::int32_t* fp, const void* resume = nullptr);
+
+        // 本地代码嵌套太深时应当在解释器中执行调用
+        bool tooDeep() const { return _context.depth >= maxDepth; }
+
+    private:
+        class NativeFunction {
+        public:
+            void* code;
+            std::size_t mapped;
+            // 每条字节码指令对应的本地代码偏移，不是跳转目标的为 -1
+            std::vector<std::int32_t> resume;
+        };
+
+        std::vector<CallSignature> _functions;
+        const std::vector<std::string>& _constants;
+        // 和解释器共用的输入输出缓冲
+        InputBuffer& _in;
+        OutputBuffer& _out;
+        Interpreter _interpreter;
+        std::vector<NativeFunction> _native;
+        std::vector<const void*> _entries;
+        JitContext _context;
+        // 运行时函数报告的错误
+        std::optional<std::string> _error;
+
+        friend class JitRuntime;
+    };
+}
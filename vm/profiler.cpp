@@ -0,0 +1,191 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <tuple>
+
+namespace c0 {
+
+    Profiler::Profiler(std::vector<std::string> names, std::vector<std::vector<opCode>> code, std::size_t stride)
+        : _names(), _code(std::move(code)), _stride(stride), _counts(), _lines(), _functions(names.size() + 1), _nodes(), _stack(),
+          _active(names.size() + 1, 0) {
+        _names.push_back(".start");
+        for (auto& name : names)
+            _names.push_back(std::move(name));
+        for (const auto& ops : _code)
+            _counts.emplace_back(ops.size() * _stride);
+        _nodes.push_back({ -2, -1, {}, std::chrono::nanoseconds(0) });
+    }
+
+    void Profiler::enter(int funcId) {
+        int parent = _stack.empty() ? 0 : _stack.back().node;
+        int node = parent;
+        // 直接递归留在同一个结点，深递归不会让树和折叠栈变得很大
+        if (_stack.empty() || _stack.back().funcId != funcId) {
+            auto& children = _nodes[parent].children;
+            auto it = std::find_if(children.begin(), children.end(),
+                                   [&](const std::pair<int, int>& child) { return child.first == funcId; });
+            if (it != children.end())
+                node = it->second;
+            else {
+                node = (int)_nodes.size();
+                _nodes[parent].children.emplace_back(funcId, node);
+                _nodes.push_back({ funcId, parent, {}, std::chrono::nanoseconds(0) });
+            }
+        }
+        ++_functions[funcId + 1].calls;
+        _stack.push_back({ funcId, node, Clock::now(), std::chrono::nanoseconds(0), _active[funcId + 1]++ > 0 });
+    }
+
+    void Profiler::leave() {
+        if (_stack.empty())
+            return;
+        auto top = _stack.back();
+        _stack.pop_back();
+        auto inclusive = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - top.start);
+        auto& fun = _functions[top.funcId + 1];
+        fun.exclusive += inclusive - top.children;
+        if (!top.nested)
+            fun.inclusive += inclusive;
+        --_active[top.funcId + 1];
+        _nodes[top.node].exclusive += inclusive - top.children;
+        if (!_stack.empty())
+            _stack.back().children += inclusive;
+    }
+
+    void Profiler::finish() {
+        while (!_stack.empty())
+            leave();
+    }
+
+    namespace {
+        double milliseconds(std::chrono::nanoseconds t) {
+            return (double)t.count() / 1e6;
+        }
+
+        double percent(std::uint64_t part, std::uint64_t total) {
+            return total == 0 ? 0 : 100.0 * (double)part / (double)total;
+        }
+
+        // 剖析时不融合超级指令，条件跳转只有这些
+        bool isConditionalJump(opCode op) {
+            switch (op) {
+                case opCode::je: case opCode::jne: case opCode::jl:
+                case opCode::jge: case opCode::jg: case opCode::jle:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    }
+
+    void Profiler::report(std::ostream& out, const std::function<std::string(opCode)>& opName) const {
+        char line[256];
+        // 解释器内部附加的指令没有名字，不计入
+        std::vector<std::uint64_t> ops(256, 0), instructions(_code.size(), 0);
+        for (std::size_t i = 0; i < _code.size(); i++) {
+            for (std::size_t j = 0; j < _code[i].size(); j++) {
+                if (opName(_code[i][j]).empty())
+                    continue;
+                ops[_code[i][j]] += executed((int)i - 1, j);
+                instructions[i] += executed((int)i - 1, j);
+            }
+        }
+        std::uint64_t total = 0;
+        std::vector<int> order;
+        for (int op = 0; op < 256; op++) {
+            if (ops[op] > 0) {
+                total += ops[op];
+                order.push_back(op);
+            }
+        }
+
+        out << "== instructions ==\n";
+        std::snprintf(line, sizeof(line), "%-12s %14s %8s\n", "opcode", "count", "%");
+        out << line;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return ops[a] > ops[b]; });
+        for (int op : order) {
+            std::snprintf(line, sizeof(line), "%-12s %14llu %7.2f%%\n", opName((opCode)op).c_str(),
+                          (unsigned long long)ops[op], percent(ops[op], total));
+            out << line;
+        }
+        std::snprintf(line, sizeof(line), "%-12s %14llu\n", "total", (unsigned long long)total);
+        out << line;
+
+        out << "\n== functions ==\n";
+        std::snprintf(line, sizeof(line), "%-20s %10s %12s %12s %14s\n", "function", "calls",
+                      "incl (ms)", "excl (ms)", "instructions");
+        out << line;
+        order.clear();
+        for (int i = 0; i < (int)_functions.size(); i++) {
+            if (_functions[i].calls > 0)
+                order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b) { return _functions[a].exclusive > _functions[b].exclusive; });
+        for (int i : order) {
+            const auto& fun = _functions[i];
+            std::snprintf(line, sizeof(line), "%-20s %10llu %12.3f %12.3f %14llu\n", _names[i].c_str(),
+                          (unsigned long long)fun.calls, milliseconds(fun.inclusive), milliseconds(fun.exclusive),
+                          (unsigned long long)instructions[i]);
+            out << line;
+        }
+
+        out << "\n== branches ==\n";
+        std::snprintf(line, sizeof(line), "%-20s %8s %14s %14s %8s\n", "function", "index", "taken", "not taken",
+                      "taken %");
+        out << line;
+        for (std::size_t i = 0; i < _code.size(); i++) {
+            for (std::size_t j = 0; j < _code[i].size(); j++) {
+                auto count = executed((int)i - 1, j), jumps = taken((int)i - 1, j);
+                if (!isConditionalJump(_code[i][j]) || count == 0)
+                    continue;
+                std::snprintf(line, sizeof(line), "%-20s %8zu %14llu %14llu %7.2f%%\n", _names[i].c_str(), j,
+                              (unsigned long long)jumps, (unsigned long long)(count - jumps), percent(jumps, count));
+                out << line;
+            }
+        }
+
+        if (_lines.empty())
+            return;
+        // <函数, 行号, 指令数>
+        std::vector<std::tuple<std::size_t, std::uint32_t, std::uint64_t>> lines;
+        for (std::size_t i = 0; i < _code.size() && i < _lines.size(); i++) {
+            std::map<std::uint32_t, std::uint64_t> counts;
+            for (std::size_t j = 0; j < _code[i].size() && j < _lines[i].size(); j++) {
+                if (_lines[i][j] != 0 && !opName(_code[i][j]).empty())
+                    counts[_lines[i][j]] += executed((int)i - 1, j);
+            }
+            for (const auto& it : counts) {
+                if (it.second > 0)
+                    lines.emplace_back(i, it.first, it.second);
+            }
+        }
+        std::stable_sort(lines.begin(), lines.end(),
+                         [](const auto& a, const auto& b) { return std::get<2>(a) > std::get<2>(b); });
+        out << "\n== lines ==\n";
+        std::snprintf(line, sizeof(line), "%-20s %8s %14s %8s\n", "function", "line", "instructions", "%");
+        out << line;
+        for (const auto& it : lines) {
+            std::snprintf(line, sizeof(line), "%-20s %8u %14llu %7.2f%%\n", _names[std::get<0>(it)].c_str(),
+                          (unsigned)std::get<1>(it), (unsigned long long)std::get<2>(it),
+                          percent(std::get<2>(it), total));
+            out << line;
+        }
+    }
+
+    void Profiler::collapsedStacks(std::ostream& out) const {
+        for (std::size_t i = 1; i < _nodes.size(); i++) {
+            if (_nodes[i].exclusive.count() <= 0)
+                continue;
+            std::vector<int> path;
+            for (int node = (int)i; node > 0; node = _nodes[node].parent)
+                path.push_back(_nodes[node].funcId);
+            std::string stack;
+            for (auto it = path.rbegin(); it != path.rend(); ++it)
+                stack += (stack.empty() ? "" : ";") + name(*it);
+            out << stack << ' ' << _nodes[i].exclusive.count() << '\n';
+        }
+    }
+}
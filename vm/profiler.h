@@ -0,0 +1,88 @@
+#pragma once
+
+#include "instruction/instruction.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 解释器的剖析数据：每条指令执行的次数（由此得到每种操作码和每个函数执行的指令数），
+    // 每个函数的调用次数和包含/不包含被调用者的时间，每个条件跳转的跳转/不跳转次数，
+    // 有行号表时每个源代码行执行的指令数，以及调用上下文树（输出 flamegraph 使用的折叠栈）
+    // 由 VM 在剖析模式下更新，见 VM 的构造函数
+    class Profiler {
+    public:
+        // names[i] 为函数 i 的名字，code[0] 为 .start 的操作码，code[i + 1] 为函数 i 的
+        // 第 j 条指令执行的次数在 counts(funcId)[j * stride]，条件跳转跳转的次数在 counts(funcId)[j * stride + 1]；
+        // stride 取解释器中指令的大小，解释器由指令地址加上固定的偏移直接得到计数器，不需要做除法
+        Profiler(std::vector<std::string> names, std::vector<std::vector<opCode>> code, std::size_t stride);
+
+        class FunctionProfile {
+        public:
+            std::uint64_t calls = 0;
+            // 递归调用只计最外层的包含时间
+            std::chrono::nanoseconds inclusive{ 0 };
+            std::chrono::nanoseconds exclusive{ 0 };
+        };
+
+        // funcId 为 -1 表示 .start
+        // 函数的计数器，解释器直接更新
+        std::uint64_t* counts(int funcId) { return _counts[funcId + 1].data(); }
+        std::uint64_t executed(int funcId, std::size_t index) const { return _counts[funcId + 1][index * _stride]; }
+        std::uint64_t taken(int funcId, std::size_t index) const { return _counts[funcId + 1][index * _stride + 1]; }
+        void enter(int funcId);
+        void leave();
+        // 执行出错时结束所有还没有返回的调用
+        void finish();
+
+        // 以下的下标 0 为 .start，i + 1 为函数 i
+        const std::vector<FunctionProfile>& functions() const { return _functions; }
+        // 每条指令的源代码行号，0 为未知；设置后报告中增加按行统计的指令数
+        void setLines(std::vector<std::vector<std::uint32_t>> lines) { _lines = std::move(lines); }
+
+        // 文本报告，opName 给出操作码的名字
+        void report(std::ostream& out, const std::function<std::string(opCode)>& opName) const;
+        // 每行为 "main;f;g 不包含被调用者的纳秒数"，直接递归合并为一层
+        void collapsedStacks(std::ostream& out) const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // 调用上下文树的结点，0 为根
+        class Node {
+        public:
+            int funcId;
+            int parent;
+            std::vector<std::pair<int, int>> children;
+            std::chrono::nanoseconds exclusive{ 0 };
+        };
+
+        class Activation {
+        public:
+            int funcId;
+            int node;
+            Clock::time_point start;
+            std::chrono::nanoseconds children{ 0 };
+            // 同一个函数的外层调用还没有返回
+            bool nested;
+        };
+
+        std::vector<std::string> _names;
+        std::vector<std::vector<opCode>> _code;
+        std::size_t _stride;
+        std::vector<std::vector<std::uint64_t>> _counts;
+        std::vector<std::vector<std::uint32_t>> _lines;
+        std::vector<FunctionProfile> _functions;
+        std::vector<Node> _nodes;
+        std::vector<Activation> _stack;
+        // 每个函数正在执行的调用数
+        std::vector<int> _active;
+
+        const std::string& name(int funcId) const { return _names[funcId + 1]; }
+    };
+}
@@ -0,0 +1,415 @@
+#include "register_vm.h"
+#include "dispatch.h"
+
+namespace c0 {
+
+    namespace {
+        // 抽象解释中栈上的一个值
+        class Value {
+        public:
+            enum Kind {
+                // 已经在自己的槽中
+                Reg,
+                Imm,
+                // 局部变量 v 的值，局部变量在使用前不会被改写
+                Local,
+                LocalAddr,
+                GlobalAddr,
+            };
+
+            Kind kind;
+            std::int32_t v;
+        };
+
+        // 同 superinstructions.cpp 中的条件掩码
+        u1 branchMask(opCode op) {
+            switch (op) {
+                case opCode::je:
+                    return 0b010;
+                case opCode::jne:
+                    return 0b101;
+                case opCode::jl:
+                    return 0b001;
+                case opCode::jge:
+                    return 0b110;
+                case opCode::jg:
+                    return 0b100;
+                default:
+                    return 0b011;
+            }
+        }
+
+        class Translator {
+        public:
+            Translator(const std::vector<CallSignature>& functions, bool isStart, std::vector<RegInstruction>& out)
+                : _functions(functions), _isStart(isStart), _out(out), _stack({}), _def(-1), _barrier(0),
+                  _frameSize(0) {}
+
+            std::optional<std::string> run(const std::vector<Instruction>& code, int initialDepth,
+                                           const std::string& where, int& endDepth, int& frameSize);
+
+        private:
+            const std::vector<CallSignature>& _functions;
+            bool _isStart;
+            std::vector<RegInstruction>& _out;
+            std::vector<Value> _stack;
+            // 最后一条指令写入栈顶的槽时为其下标，可以直接改写它的目的寄存器
+            int _def;
+            // 跳转目标处的指令下标，之前的指令不能改写
+            int _barrier;
+            int _frameSize;
+
+            int top() const { return (int)_stack.size() - 1; }
+
+            void emit(const RegInstruction& ins) {
+                _out.push_back(ins);
+                _def = -1;
+            }
+
+            // 发出写入 slot 的指令，结果作为新的栈顶
+            void emitDef(const RegInstruction& ins) {
+                _out.push_back(ins);
+                _def = (int)_out.size() - 1;
+                push({ Value::Reg, ins.a });
+            }
+
+            void push(Value value) {
+                _stack.push_back(value);
+                if ((int)_stack.size() > _frameSize)
+                    _frameSize = (int)_stack.size();
+            }
+
+            void pop(int n = 1) {
+                _stack.resize(_stack.size() - n);
+            }
+
+            void useLocal(int offset) {
+                if (offset + 1 > _frameSize)
+                    _frameSize = offset + 1;
+            }
+
+            bool canRetarget(int slot) const {
+                return _def >= 0 && _def == (int)_out.size() - 1 && _def >= _barrier
+                    && _out[_def].a == slot && _stack[slot].kind == Value::Reg;
+            }
+
+            // 把 slot 的值写入它自己的槽
+            void materialize(int slot) {
+                Value& value = _stack[slot];
+                switch (value.kind) {
+                    case Value::Reg:
+                        return;
+                    case Value::Imm:
+                        emit(RegInstruction(regLoadImm, slot, value.v));
+                        break;
+                    case Value::Local:
+                        if (value.v != slot)
+                            emit(RegInstruction(regMove, slot, value.v));
+                        break;
+                    case Value::LocalAddr:
+                        emit(RegInstruction(regLoadAddr, slot, value.v));
+                        break;
+                    case Value::GlobalAddr:
+                        emit(RegInstruction(regLoadImm, slot, value.v));
+                        break;
+                }
+                value = { Value::Reg, slot };
+            }
+
+            void materializeAll() {
+                for (int i = 0; i < (int)_stack.size(); i++)
+                    materialize(i);
+            }
+
+            // 取得保存 slot 的值的寄存器
+            int reg(int slot) {
+                if (_stack[slot].kind == Value::Local)
+                    return _stack[slot].v;
+                materialize(slot);
+                return slot;
+            }
+
+            void translate(const Instruction& ins);
+            void arithmetic(opCode op);
+            void store();
+            void branch(const Instruction& ins);
+        };
+
+        void Translator::arithmetic(opCode op) {
+            int d = top() - 1;
+            Value lhs = _stack[d], rhs = _stack[d + 1];
+            RegOp regOp = op == opCode::iAdd ? regAdd : op == opCode::iSub ? regSub
+                        : op == opCode::iMul ? regMul : op == opCode::iDiv ? regDiv : regCmp;
+
+            if (lhs.kind == Value::Imm && rhs.kind == Value::Imm && op != opCode::iDiv) {
+                std::int32_t result;
+                if (op == opCode::iAdd)
+                    result = wrap((std::uint32_t)lhs.v + (std::uint32_t)rhs.v);
+                else if (op == opCode::iSub)
+                    result = wrap((std::uint32_t)lhs.v - (std::uint32_t)rhs.v);
+                else if (op == opCode::iMul)
+                    result = wrap((std::uint32_t)lhs.v * (std::uint32_t)rhs.v);
+                else
+                    result = (lhs.v > rhs.v) - (lhs.v < rhs.v);
+                pop(2);
+                push({ Value::Imm, result });
+                return;
+            }
+
+            if (rhs.kind == Value::Imm && op != opCode::iDiv) {
+                int r = reg(d);
+                pop(2);
+                if (op == opCode::iSub)
+                    emitDef(RegInstruction(regAddImm, d, r, wrap(0u - (std::uint32_t)rhs.v)));
+                else
+                    emitDef(RegInstruction(op == opCode::iAdd ? regAddImm : op == opCode::iMul ? regMulImm : regCmpImm,
+                                           d, r, rhs.v));
+                return;
+            }
+            if (lhs.kind == Value::Imm && (op == opCode::iAdd || op == opCode::iMul)) {
+                int r = reg(d + 1);
+                pop(2);
+                emitDef(RegInstruction(op == opCode::iAdd ? regAddImm : regMulImm, d, r, lhs.v));
+                return;
+            }
+
+            int b = reg(d), c = reg(d + 1);
+            pop(2);
+            emitDef(RegInstruction(regOp, d, b, c));
+        }
+
+        void Translator::store() {
+            int d = top() - 1;
+            Value addr = _stack[d], value = _stack[d + 1];
+
+            if (addr.kind == Value::LocalAddr) {
+                int o = addr.v;
+                useLocal(o);
+                // 还没有读出的旧值先写入各自的槽
+                for (int i = 0; i < d; i++) {
+                    if (_stack[i].kind == Value::Local && _stack[i].v == o)
+                        materialize(i);
+                }
+                if (value.kind == Value::Reg && canRetarget(d + 1))
+                    _out.back().a = o;
+                else if (value.kind == Value::Imm)
+                    emit(RegInstruction(regLoadImm, o, value.v));
+                else if (value.kind == Value::Local) {
+                    if (value.v != o)
+                        emit(RegInstruction(regMove, o, value.v));
+                } else if (value.kind == Value::Reg)
+                    emit(RegInstruction(regMove, o, d + 1));
+                else if (value.kind == Value::LocalAddr)
+                    emit(RegInstruction(regLoadAddr, o, value.v));
+                else
+                    emit(RegInstruction(regLoadImm, o, value.v));
+                _def = -1;
+                pop(2);
+                if (o < (int)_stack.size())
+                    _stack[o] = { Value::Reg, o };
+                return;
+            }
+
+            if (addr.kind == Value::GlobalAddr) {
+                int r = reg(d + 1);
+                pop(2);
+                emit(RegInstruction(regStoreGlobal, addr.v, r));
+                return;
+            }
+
+            // 地址在运行时才知道，栈上的值全部写回
+            materializeAll();
+            pop(2);
+            emit(RegInstruction(regStore, d, d + 1));
+        }
+
+        void Translator::branch(const Instruction& ins) {
+            int s = top();
+            RegInstruction fused(regBranchImm, ins.getX(), 0, 0);
+            fused.cond = branchMask(ins.getOpr());
+            if (canRetarget(s) && (_out.back().op == regCmp || _out.back().op == regCmpImm)) {
+                // icmp; jXX 合并成比较跳转
+                fused.op = _out.back().op == regCmp ? regBranch : regBranchImm;
+                fused.b = _out.back().b;
+                fused.c = _out.back().c;
+                _out.pop_back();
+            } else
+                fused.b = reg(s);
+            pop();
+            materializeAll();
+            emit(fused);
+        }
+
+        void Translator::translate(const Instruction& ins) {
+            int d = (int)_stack.size();
+            switch (ins.getOpr()) {
+                case opCode::nop:
+                    break;
+                case opCode::biPush: case opCode::iPush: case opCode::loadC:
+                    push({ Value::Imm, ins.getX() });
+                    break;
+                case opCode::pop1:
+                    pop();
+                    break;
+                case opCode::popN:
+                    pop(ins.getX());
+                    break;
+                case opCode::loadA:
+                    if (ins.getX() == 1 && !_isStart)
+                        push({ Value::GlobalAddr, ins.getY() });
+                    else
+                        push({ Value::LocalAddr, ins.getY() });
+                    break;
+                case opCode::iLoad: {
+                    Value addr = _stack[top()];
+                    pop();
+                    if (addr.kind == Value::LocalAddr) {
+                        useLocal(addr.v);
+                        if (addr.v < top() + 1) {
+                            materialize(addr.v);
+                            push({ Value::Local, addr.v });
+                        } else
+                            emitDef(RegInstruction(regMove, top() + 1, addr.v));
+                    } else if (addr.kind == Value::GlobalAddr)
+                        emitDef(RegInstruction(regLoadGlobal, top() + 1, addr.v));
+                    else {
+                        push(addr);
+                        int r = reg(top());
+                        pop();
+                        materializeAll();
+                        emitDef(RegInstruction(regLoad, top() + 1, r));
+                    }
+                    break;
+                }
+                case opCode::iStore:
+                    store();
+                    break;
+                case opCode::iAdd: case opCode::iSub: case opCode::iMul: case opCode::iDiv: case opCode::iCmp:
+                    arithmetic(ins.getOpr());
+                    break;
+                case opCode::iNeg: case opCode::i2c: {
+                    Value value = _stack[top()];
+                    if (value.kind == Value::Imm) {
+                        _stack[top()].v = ins.getOpr() == opCode::iNeg ? wrap(0u - (std::uint32_t)value.v) : value.v & 0xff;
+                        break;
+                    }
+                    int r = reg(top());
+                    pop();
+                    emitDef(RegInstruction(ins.getOpr() == opCode::iNeg ? regNeg : regI2c, d - 1, r));
+                    break;
+                }
+                case opCode::jmp:
+                    materializeAll();
+                    emit(RegInstruction(regJump, ins.getX()));
+                    break;
+                case opCode::je: case opCode::jne: case opCode::jl:
+                case opCode::jge: case opCode::jg: case opCode::jle:
+                    branch(ins);
+                    break;
+                // 表中的 jmp 都是跳转目标，各自翻译成一条 regJump，和 regSwitch 紧挨着
+                case opCode::tableSwitch: {
+                    int r = reg(top());
+                    pop();
+                    materializeAll();
+                    emit(RegInstruction(regSwitch, ins.getY(), r, ins.getX()));
+                    break;
+                }
+                case opCode::call: {
+                    const auto& fun = _functions[ins.getX()];
+                    materializeAll();
+                    pop(fun.paramSize);
+                    emit(RegInstruction(regCall, ins.getX(), d - fun.paramSize));
+                    if (fun.returnsValue)
+                        push({ Value::Reg, d - fun.paramSize });
+                    break;
+                }
+                case opCode::ret:
+                    emit(RegInstruction(regRet));
+                    break;
+                case opCode::iRet: {
+                    int r = reg(top());
+                    pop();
+                    emit(RegInstruction(regRetValue, r));
+                    break;
+                }
+                case opCode::iPrint: case opCode::cPrint: case opCode::sPrint: {
+                    int r = reg(top());
+                    pop();
+                    emit(RegInstruction(ins.getOpr() == opCode::iPrint ? regPrintInt
+                                        : ins.getOpr() == opCode::cPrint ? regPrintChar : regPrintString, r));
+                    break;
+                }
+                // 参数依次写入各自的槽
+                case opCode::fPrint:
+                    for (int k = d - ins.getY(); k < d; k++)
+                        materialize(k);
+                    pop(ins.getY());
+                    emit(RegInstruction(regPrintFormat, ins.getX(), d - ins.getY(), ins.getY()));
+                    break;
+                case opCode::printL:
+                    emit(RegInstruction(regPrintLine));
+                    break;
+                case opCode::iScan: case opCode::cScan:
+                    emitDef(RegInstruction(ins.getOpr() == opCode::iScan ? regScanInt : regScanChar, d));
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        std::optional<std::string> Translator::run(const std::vector<Instruction>& code, int initialDepth,
+                                                   const std::string& where, int& endDepth, int& frameSize) {
+            int n = (int)code.size();
+
+            // 先求出每条指令处的栈深度，-1 表示不可达
+            std::vector<int> depth;
+            std::vector<bool> target;
+            if (auto err = stackDepths(code, initialDepth, _functions, where, depth, target))
+                return err;
+
+            std::vector<int> index(n + 1);
+            // 当作从不可达处进入第一条指令，栈初始化为参数
+            bool reachable = false;
+            for (int i = 0; i <= n; i++) {
+                if (target[i] || !reachable) {
+                    if (reachable)
+                        materializeAll();
+                    _stack.assign(depth[i] < 0 ? 0 : depth[i], { Value::Reg, 0 });
+                    for (int k = 0; k < (int)_stack.size(); k++)
+                        _stack[k].v = k;
+                    _barrier = (int)_out.size();
+                    _def = -1;
+                }
+                index[i] = (int)_out.size();
+                reachable = depth[i] >= 0;
+                if (i == n || !reachable)
+                    continue;
+                translate(code[i]);
+                reachable = !isTerminator(code[i].getOpr());
+            }
+            // 执行到末尾时栈上的值要留给之后的代码，.start 中的全局变量就是这样
+            if (reachable)
+                materializeAll();
+            endDepth = (int)_stack.size();
+
+            // 跳转目标换成相对当前指令的偏移
+            for (std::size_t k = 0; k < _out.size(); k++) {
+                auto& ins = _out[k];
+                if (ins.op == regJump || ins.op == regBranch || ins.op == regBranchImm)
+                    ins.a = index[ins.a] - (int)k;
+            }
+            if (initialDepth > _frameSize)
+                _frameSize = initialDepth;
+            frameSize = _frameSize;
+            return {};
+        }
+    }
+
+    std::optional<std::string> translateToRegisters(const std::vector<Instruction>& code, int funcId,
+                                                    const std::vector<CallSignature>& functions,
+                                                    RegFunction& out, int& endDepth) {
+        std::string where = funcId < 0 ? ".start" : ".F" + std::to_string(funcId);
+        Translator translator(functions, funcId < 0, out.code);
+        return translator.run(code, funcId < 0 ? 0 : out.paramSize, where, endDepth, out.frameSize);
+    }
+}
@@ -0,0 +1,320 @@
+#include "register_vm.h"
+#include "dispatch.h"
+
+#include <array>
+
+namespace c0 {
+
+    RegisterVM::RegisterVM(const byteCode& code, std::istream& in, std::ostream& out, std::size_t stackSize)
+        : _constants({}), _start(), _startDepth(0), _functions({}), _signatures(callSignatures(code)), _halt({}),
+          _loadError(),
+          _loaded(0), _decoded(0), _dispatches(0),
+          _output(out), _input(in, &_output), _stack(stackSize), _frames({}), _threaded(false) {
+        for (const auto& constant : code.constants)
+            _constants.push_back(constant.second);
+
+        for (std::size_t i = 0; i < code.functions.size(); i++) {
+            RegFunction f;
+            const auto& fun = code.functions[i];
+            if (fun.name_index >= 0 && fun.name_index < (int)_constants.size())
+                f.name = _constants[fun.name_index];
+            f.paramSize = fun.params_size;
+            f.frameSize = 0;
+            _functions.push_back(std::move(f));
+        }
+
+        // 翻译时要用到被调用函数的参数个数和是否有返回值，所以先检查全部函数
+        _loadError = checkCode(code.start, -1, _functions.size(), _constants.size());
+        for (int i = 0; i < (int)_functions.size() && !_loadError; i++)
+            _loadError = checkCode(code.instructions[i], i, _functions.size(), _constants.size());
+        if (_loadError)
+            return;
+
+        _start.paramSize = 0;
+        _loadError = translateToRegisters(code.start, -1, _signatures, _start, _startDepth);
+        _loaded += code.start.size();
+        _decoded += _start.code.size();
+        _start.code.emplace_back(regHalt);
+        for (int i = 0; i < (int)_functions.size() && !_loadError; i++) {
+            int endDepth;
+            _loadError = translateToRegisters(code.instructions[i], i, _signatures, _functions[i], endDepth);
+            _loaded += code.instructions[i].size();
+            _decoded += _functions[i].code.size();
+            _functions[i].code.emplace_back(regFallOff, i);
+        }
+        _halt.emplace_back(regHalt);
+    }
+
+    std::optional<std::string> RegisterVM::Run() {
+        if (_loadError)
+            return _loadError;
+        FlushGuard flush(_output);
+
+        _frames.clear();
+        _dispatches = 0;
+        if ((std::size_t)_start.frameSize > _stack.size())
+            return std::string("stack overflow");
+        if (auto err = execute(_start.code.data(), 0))
+            return err;
+
+        int mainId = -1;
+        for (int i = 0; i < (int)_functions.size(); i++) {
+            if (_functions[i].name == "main")
+                mainId = i;
+        }
+        if (mainId < 0)
+            return std::string("no main function");
+
+        const auto& main = _functions[mainId];
+        std::int32_t fp = _startDepth - main.paramSize;
+        if ((std::size_t)fp + main.frameSize > _stack.size())
+            return std::string("stack overflow");
+        _frames.push_back({ _halt.data(), 0 });
+        return execute(main.code.data(), fp);
+    }
+
+#if C0VM_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+    std::optional<std::string> RegisterVM::execute(const RegInstruction* ip, std::int32_t fp) {
+        std::int32_t* stack = _stack.data();
+        std::int32_t* r = stack + fp;
+        const std::uint32_t size = (std::uint32_t)_stack.size();
+
+#ifdef C0VM_COUNT_DISPATCH
+#define COUNT_DISPATCH() (++_dispatches)
+#else
+#define COUNT_DISPATCH() ((void)0)
+#endif
+#define CHECK_ADDR(addr) do { if ((std::uint32_t)(addr) >= size) return std::string("invalid address"); } while (0)
+
+#if C0VM_THREADED
+        static_assert(regOpCount <= 256, "RegOp must fit in a byte");
+        std::array<const void*, regOpCount> labels = {
+            &&op_regMove, &&op_regLoadImm, &&op_regLoadAddr, &&op_regLoadGlobal, &&op_regStoreGlobal,
+            &&op_regLoad, &&op_regStore,
+            &&op_regAdd, &&op_regSub, &&op_regMul, &&op_regDiv, &&op_regCmp,
+            &&op_regAddImm, &&op_regMulImm, &&op_regCmpImm,
+            &&op_regNeg, &&op_regI2c,
+            &&op_regJump, &&op_regBranch, &&op_regBranchImm, &&op_regSwitch,
+            &&op_regCall, &&op_regRet, &&op_regRetValue,
+            &&op_regPrintInt, &&op_regPrintChar, &&op_regPrintString, &&op_regPrintFormat,
+            &&op_regPrintLine,
+            &&op_regScanInt, &&op_regScanChar,
+            &&op_regHalt, &&op_regFallOff,
+        };
+
+        // 第一次执行时填入每条指令的处理代码地址
+        if (!_threaded) {
+            for (auto& ins : _start.code)
+                ins.handler = labels[ins.op];
+            for (auto& fun : _functions) {
+                for (auto& ins : fun.code)
+                    ins.handler = labels[ins.op];
+            }
+            for (auto& ins : _halt)
+                ins.handler = labels[ins.op];
+            _threaded = true;
+        }
+
+#define TARGET(name) op_##name:
+#define DISPATCH() do { COUNT_DISPATCH(); goto *ip->handler; } while (0)
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+        DISPATCH();
+#else
+#define TARGET(name) case name:
+#define DISPATCH() continue
+// 不能用 do-while 包装，否则 continue 只会结束 do-while
+#define NEXT() { ++ip; continue; }
+        for (;;) {
+            COUNT_DISPATCH();
+            switch (ip->op) {
+#endif
+
+        TARGET(regMove)
+            r[ip->a] = r[ip->b];
+            NEXT();
+        TARGET(regLoadImm)
+            r[ip->a] = ip->b;
+            NEXT();
+        TARGET(regLoadAddr)
+            r[ip->a] = fp + ip->b;
+            NEXT();
+        TARGET(regLoadGlobal)
+            CHECK_ADDR(ip->b);
+            r[ip->a] = stack[ip->b];
+            NEXT();
+        TARGET(regStoreGlobal)
+            CHECK_ADDR(ip->a);
+            stack[ip->a] = r[ip->b];
+            NEXT();
+        TARGET(regLoad)
+            CHECK_ADDR(r[ip->b]);
+            r[ip->a] = stack[r[ip->b]];
+            NEXT();
+        TARGET(regStore)
+            CHECK_ADDR(r[ip->a]);
+            stack[r[ip->a]] = r[ip->b];
+            NEXT();
+
+        TARGET(regAdd)
+            r[ip->a] = wrap((std::uint32_t)r[ip->b] + (std::uint32_t)r[ip->c]);
+            NEXT();
+        TARGET(regSub)
+            r[ip->a] = wrap((std::uint32_t)r[ip->b] - (std::uint32_t)r[ip->c]);
+            NEXT();
+        TARGET(regMul)
+            r[ip->a] = wrap((std::uint32_t)r[ip->b] * (std::uint32_t)r[ip->c]);
+            NEXT();
+        TARGET(regDiv) {
+            std::int32_t lhs = r[ip->b], rhs = r[ip->c];
+            if (rhs == 0)
+                return std::string("division by zero");
+            // INT_MIN / -1 溢出
+            r[ip->a] = rhs == -1 ? wrap(0u - (std::uint32_t)lhs) : lhs / rhs;
+            NEXT();
+        }
+        TARGET(regCmp) {
+            std::int32_t lhs = r[ip->b], rhs = r[ip->c];
+            r[ip->a] = (lhs > rhs) - (lhs < rhs);
+            NEXT();
+        }
+        TARGET(regAddImm)
+            r[ip->a] = wrap((std::uint32_t)r[ip->b] + (std::uint32_t)ip->c);
+            NEXT();
+        TARGET(regMulImm)
+            r[ip->a] = wrap((std::uint32_t)r[ip->b] * (std::uint32_t)ip->c);
+            NEXT();
+        TARGET(regCmpImm) {
+            std::int32_t lhs = r[ip->b];
+            r[ip->a] = (lhs > ip->c) - (lhs < ip->c);
+            NEXT();
+        }
+        TARGET(regNeg)
+            r[ip->a] = wrap(0u - (std::uint32_t)r[ip->b]);
+            NEXT();
+        TARGET(regI2c)
+            r[ip->a] = r[ip->b] & 0xff;
+            NEXT();
+
+        TARGET(regJump)
+            ip += ip->a;
+            DISPATCH();
+        TARGET(regBranch) {
+            std::int32_t lhs = r[ip->b], rhs = r[ip->c];
+            int result = (lhs > rhs) - (lhs < rhs);
+            if (ip->cond >> (result + 1) & 1) {
+                ip += ip->a;
+                DISPATCH();
+            }
+            NEXT();
+        }
+        TARGET(regBranchImm) {
+            std::int32_t lhs = r[ip->b];
+            int result = (lhs > ip->c) - (lhs < ip->c);
+            if (ip->cond >> (result + 1) & 1) {
+                ip += ip->a;
+                DISPATCH();
+            }
+            NEXT();
+        }
+
+        TARGET(regSwitch) {
+            std::uint32_t k = (std::uint32_t)r[ip->b] - (std::uint32_t)ip->c;
+            ip += 1 + (k < (std::uint32_t)ip->a ? k : (std::uint32_t)ip->a);
+            DISPATCH();
+        }
+
+        TARGET(regCall) {
+            const auto& fun = _functions[ip->a];
+            std::int32_t callee = fp + ip->b;
+            if ((std::size_t)callee + fun.frameSize > _stack.size() || _frames.size() >= _stack.size())
+                return std::string("stack overflow");
+            _frames.push_back({ ip + 1, fp });
+            fp = callee;
+            r = stack + fp;
+            ip = fun.code.data();
+            DISPATCH();
+        }
+        TARGET(regRet) {
+            if (_frames.empty())
+                return std::string("return outside of function");
+            auto frame = _frames.back();
+            _frames.pop_back();
+            ip = frame.returnIp;
+            fp = frame.fp;
+            r = stack + fp;
+            DISPATCH();
+        }
+        TARGET(regRetValue) {
+            if (_frames.empty())
+                return std::string("return outside of function");
+            // 返回值放在调用者的参数起始处
+            r[0] = r[ip->a];
+            auto frame = _frames.back();
+            _frames.pop_back();
+            ip = frame.returnIp;
+            fp = frame.fp;
+            r = stack + fp;
+            DISPATCH();
+        }
+
+        TARGET(regPrintInt)
+            _output.putInt(r[ip->a]);
+            NEXT();
+        TARGET(regPrintChar)
+            _output.putChar((char)r[ip->a]);
+            NEXT();
+        TARGET(regPrintString) {
+            std::int32_t index = r[ip->a];
+            if (index < 0 || index >= (std::int32_t)_constants.size())
+                return std::string("invalid constant index");
+            _output.write(_constants[index]);
+            NEXT();
+        }
+        TARGET(regPrintFormat)
+            if (!_output.putFormat(_constants[ip->a], r + ip->b, ip->c))
+                return std::string("too few fprint arguments");
+            NEXT();
+        TARGET(regPrintLine)
+            _output.putChar('\n');
+            NEXT();
+        TARGET(regScanInt) {
+            auto value = _input.getInt();
+            if (!value)
+                return std::string("invalid input");
+            r[ip->a] = value.value();
+            NEXT();
+        }
+        TARGET(regScanChar) {
+            auto c = _input.getChar();
+            if (!c)
+                return std::string("invalid input");
+            r[ip->a] = (unsigned char)c.value();
+            NEXT();
+        }
+
+        TARGET(regHalt)
+            return {};
+        TARGET(regFallOff)
+            return "function " + _functions[ip->a].name + " ends without return";
+
+#if !C0VM_THREADED
+            default:
+                return "unknown register opcode " + std::to_string((int)ip->op);
+            }
+        }
+#endif
+    }
+#undef CHECK_ADDR
+#undef COUNT_DISPATCH
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+
+#if C0VM_THREADED
+#pragma GCC diagnostic pop
+#endif
+}
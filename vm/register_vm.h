@@ -0,0 +1,146 @@
+#pragma once
+
+#include "vm.h"
+#include "stack_depth.h"
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 寄存器形式的指令
+    // 寄存器就是栈帧中的槽，r 表示 fp + r；栈式字节码中深度为 d 的栈顶在寄存器 d
+    enum RegOp : u1 {
+        // r[a] = r[b]
+        regMove,
+        // r[a] = b
+        regLoadImm,
+        // r[a] = fp + b，即局部变量 b 的地址
+        regLoadAddr,
+        // r[a] = stack[b]，全局变量
+        regLoadGlobal,
+        // stack[a] = r[b]
+        regStoreGlobal,
+        // r[a] = stack[r[b]]
+        regLoad,
+        // stack[r[a]] = r[b]
+        regStore,
+        // r[a] = r[b] op r[c]
+        regAdd,
+        regSub,
+        regMul,
+        regDiv,
+        regCmp,
+        // r[a] = r[b] op c
+        regAddImm,
+        regMulImm,
+        regCmpImm,
+        // r[a] = op r[b]
+        regNeg,
+        regI2c,
+        // 跳转到相对本条指令偏移为 a 的指令
+        regJump,
+        // r[b] 和 r[c] 比较，cond 为条件掩码，满足时同 regJump 跳转
+        regBranch,
+        // r[b] 和 c 比较
+        regBranchImm,
+        // 之后紧跟 a + 1 条 regJump，r[b] - c 为 k（0 <= k < a）时执行第 k 条，否则执行最后一条
+        regSwitch,
+        // 调用函数 a，参数从 r[b] 开始，返回值在 r[b]
+        regCall,
+        regRet,
+        // 返回 r[a]
+        regRetValue,
+        regPrintInt,
+        regPrintChar,
+        // 输出常量 r[a]
+        regPrintString,
+        // 输出常量 a，其中的 %d 依次换成 r[b] 开始的 c 个值，见 printFormat
+        regPrintFormat,
+        regPrintLine,
+        // r[a] = 输入
+        regScanInt,
+        regScanChar,
+        // 执行结束
+        regHalt,
+        // 函数执行到末尾没有返回，a 为函数编号
+        regFallOff,
+        regOpCount
+    };
+
+    class RegInstruction {
+    public:
+        RegOp op;
+        u1 cond;
+        std::int32_t a;
+        std::int32_t b;
+        std::int32_t c;
+        const void* handler;
+
+        RegInstruction(RegOp op, std::int32_t a = 0, std::int32_t b = 0, std::int32_t c = 0)
+            : op(op), cond(0), a(a), b(b), c(c), handler(nullptr) {}
+    };
+
+    class RegFunction {
+    public:
+        std::string name;
+        int paramSize;
+        // 用到的寄存器个数，调用时据此检查栈溢出
+        int frameSize;
+        std::vector<RegInstruction> code;
+    };
+
+    // 用抽象解释得到每条指令处的栈深度，把栈式字节码翻译成三地址的寄存器形式
+    // 栈顶的立即数、局部变量和地址在被使用时才写入寄存器，大多数 push/pop 因此消失
+    // funcId 为 -1 即 .start 时 fp 为 0，全局变量就是局部变量
+    // 出错时返回错误信息；成功时 endDepth 为执行到末尾时的栈深度
+    std::optional<std::string> translateToRegisters(const std::vector<Instruction>& code, int funcId,
+                                                    const std::vector<CallSignature>& functions,
+                                                    RegFunction& out, int& endDepth);
+
+    // 寄存器形式的解释器，接口和 VM 相同
+    class RegisterVM final {
+    public:
+        RegisterVM(const byteCode& code, std::istream& in, std::ostream& out, std::size_t stackSize = 1 << 20);
+        RegisterVM(RegisterVM&&) = delete;
+        RegisterVM(const RegisterVM&) = delete;
+        RegisterVM& operator=(RegisterVM) = delete;
+
+        std::optional<std::string> Run();
+
+        std::size_t loadedInstructions() const { return _loaded; }
+        std::size_t decodedInstructions() const { return _decoded; }
+        std::uint64_t dispatches() const { return _dispatches; }
+
+    private:
+        class Frame {
+        public:
+            const RegInstruction* returnIp;
+            std::int32_t fp;
+        };
+
+        std::vector<std::string> _constants;
+        RegFunction _start;
+        // .start 执行完后的栈深度，main 的栈帧从这里开始
+        int _startDepth;
+        std::vector<RegFunction> _functions;
+        std::vector<CallSignature> _signatures;
+        std::vector<RegInstruction> _halt;
+        std::optional<std::string> _loadError;
+        std::size_t _loaded;
+        std::size_t _decoded;
+        std::uint64_t _dispatches;
+
+        OutputBuffer _output;
+        InputBuffer _input;
+        std::vector<std::int32_t> _stack;
+        std::vector<Frame> _frames;
+        bool _threaded;
+
+        std::optional<std::string> execute(const RegInstruction* ip, std::int32_t fp);
+    };
+}
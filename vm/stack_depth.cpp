@@ -0,0 +1,152 @@
+#include "stack_depth.h"
+
+namespace c0 {
+
+    std::vector<CallSignature> callSignatures(const byteCode& code) {
+        std::vector<CallSignature> signatures;
+        for (std::size_t i = 0; i < code.functions.size(); i++) {
+            CallSignature signature = { code.functions[i].params_size, false };
+            if (i < code.instructions.size()) {
+                for (const auto& ins : code.instructions[i])
+                    signature.returnsValue |= ins.getOpr() == opCode::iRet;
+            }
+            signatures.push_back(signature);
+        }
+        return signatures;
+    }
+
+    bool isTerminator(opCode op) {
+        return op == opCode::jmp || op == opCode::tableSwitch || op == opCode::ret || op == opCode::iRet;
+    }
+
+    bool isJumpInstruction(opCode op) {
+        return op == opCode::jmp || op == opCode::je || op == opCode::jne || op == opCode::jl
+            || op == opCode::jge || op == opCode::jg || op == opCode::jle;
+    }
+
+    // 指令的出栈和入栈数
+    void stackEffect(const Instruction& ins, const std::vector<CallSignature>& functions, int& pops, int& pushes) {
+        pops = 0;
+        pushes = 0;
+        switch (ins.getOpr()) {
+            case opCode::biPush: case opCode::iPush: case opCode::loadC: case opCode::loadA:
+            case opCode::iScan: case opCode::cScan:
+                pushes = 1;
+                break;
+            case opCode::pop1: case opCode::iPrint: case opCode::cPrint: case opCode::sPrint:
+            case opCode::je: case opCode::jne: case opCode::jl:
+            case opCode::jge: case opCode::jg: case opCode::jle: case opCode::tableSwitch:
+            case opCode::iRet:
+                pops = 1;
+                break;
+            case opCode::popN:
+                pops = ins.getX();
+                break;
+            case opCode::fPrint:
+                pops = ins.getY();
+                break;
+            case opCode::iLoad: case opCode::iNeg: case opCode::i2c:
+                pops = pushes = 1;
+                break;
+            case opCode::iStore:
+                pops = 2;
+                break;
+            case opCode::iAdd: case opCode::iSub: case opCode::iMul: case opCode::iDiv: case opCode::iCmp:
+                pops = 2;
+                pushes = 1;
+                break;
+            case opCode::call:
+                pops = functions[ins.getX()].paramSize;
+                pushes = functions[ins.getX()].returnsValue ? 1 : 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::optional<std::string> stackDepths(const std::vector<Instruction>& code, int initialDepth,
+                                           const std::vector<CallSignature>& functions, const std::string& where,
+                                           std::vector<int>& depth, std::vector<bool>& target) {
+        int n = (int)code.size();
+        depth.assign(n + 1, -1);
+        target.assign(n + 1, false);
+        std::vector<int> work;
+        depth[0] = initialDepth;
+        if (n > 0)
+            work.push_back(0);
+
+        auto reach = [&](int to, int d) -> std::optional<std::string> {
+            if (depth[to] < 0) {
+                depth[to] = d;
+                if (to < n)
+                    work.push_back(to);
+            } else if (depth[to] != d)
+                return where + ": inconsistent stack depth at " + std::to_string(to);
+            return {};
+        };
+        while (!work.empty()) {
+            int i = work.back();
+            work.pop_back();
+            const auto& ins = code[i];
+            int pops, pushes;
+            stackEffect(ins, functions, pops, pushes);
+            if (pops > depth[i])
+                return where + ": stack underflow at " + std::to_string(i);
+            int after = depth[i] - pops + pushes;
+            if (isJumpInstruction(ins.getOpr())) {
+                target[ins.getX()] = true;
+                if (auto err = reach(ins.getX(), after))
+                    return err;
+            }
+            // 表中的每条 jmp 都可能执行
+            if (ins.getOpr() == opCode::tableSwitch) {
+                for (int k = i + 1; k <= i + 1 + ins.getY() && k < n; k++) {
+                    target[k] = true;
+                    if (auto err = reach(k, after))
+                        return err;
+                }
+            }
+            if (!isTerminator(ins.getOpr())) {
+                if (auto err = reach(i + 1, after))
+                    return err;
+            }
+        }
+        return {};
+    }
+
+    frameInfo frameOf(const std::vector<Instruction>& code, const std::vector<int>& depth, int initialDepth) {
+        frameInfo frame = { initialDepth, initialDepth };
+        for (std::size_t i = 0; i < depth.size(); i++) {
+            if (depth[i] > frame.max_stack)
+                frame.max_stack = depth[i];
+            if (i < code.size() && code[i].getOpr() == opCode::loadA && code[i].getX() == 0
+                && code[i].getY() + 1 > frame.locals)
+                frame.locals = code[i].getY() + 1;
+        }
+        // loada 访问还没压入的槽时执行会报错，这里仍然留出它的位置
+        if (frame.locals > frame.max_stack)
+            frame.max_stack = frame.locals;
+        return frame;
+    }
+
+    std::optional<std::string> frameSizes(const byteCode& code, std::vector<frameInfo>& frames) {
+        auto signatures = callSignatures(code);
+        std::vector<int> depth;
+        std::vector<bool> target;
+        frames.clear();
+        frames.reserve(code.instructions.size() + 1);
+        if (auto err = stackDepths(code.start, 0, signatures, ".start", depth, target))
+            return err;
+        frames.push_back(frameOf(code.start, depth, 0));
+        // .start 执行到末尾时留在栈上的都是全局变量
+        if (depth.back() > frames[0].locals)
+            frames[0].locals = depth.back();
+        for (std::size_t i = 0; i < code.instructions.size(); i++) {
+            int params = i < code.functions.size() ? code.functions[i].params_size : 0;
+            if (auto err = stackDepths(code.instructions[i], params, signatures, ".F" + std::to_string(i), depth, target))
+                return err;
+            frames.push_back(frameOf(code.instructions[i], depth, params));
+        }
+        return {};
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "generater/generator.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 调用一个函数时的栈变化：弹出 paramSize 个参数，returnsValue 时压入返回值
+    class CallSignature {
+    public:
+        int paramSize;
+        bool returnsValue;
+    };
+
+    // 函数中有 iret 时认为它有返回值
+    std::vector<CallSignature> callSignatures(const byteCode& code);
+
+    // 指令的出栈和入栈数，call 的函数编号需要事先检查过
+    void stackEffect(const Instruction& ins, const std::vector<CallSignature>& functions, int& pops, int& pushes);
+
+    // 执行后不会到达下一条指令
+    bool isTerminator(opCode op);
+    // jmp 和条件跳转
+    bool isJumpInstruction(opCode op);
+
+    // 从第一条指令的深度 initialDepth 出发求出每条指令执行前的栈深度，不可达的指令为 -1
+    // depth 和 target 的大小为 code.size() + 1，最后一项对应执行到末尾，target[i] 表示 i 是跳转目标
+    // 同一条指令可以从不同深度到达或者栈下溢时返回错误信息
+    std::optional<std::string> stackDepths(const std::vector<Instruction>& code, int initialDepth,
+                                           const std::vector<CallSignature>& functions, const std::string& where,
+                                           std::vector<int>& depth, std::vector<bool>& target);
+
+    // 由 stackDepths 求出的 depth 得到栈帧大小，initialDepth 为参数个数
+    frameInfo frameOf(const std::vector<Instruction>& code, const std::vector<int>& depth, int initialDepth);
+    // .start 和每个函数的栈帧，frames[0] 为 .start，frames[i + 1] 为函数 i
+    // call 的函数编号需要事先检查过，有指令序列的栈深度不一致或者下溢时返回错误信息
+    std::optional<std::string> frameSizes(const byteCode& code, std::vector<frameInfo>& frames);
+}
@@ -0,0 +1,215 @@
+#include "superinstructions.h"
+
+namespace c0 {
+
+    bool isJump(opCode op) {
+        switch ((int)op) {
+            case opCode::jmp: case opCode::je: case opCode::jne: case opCode::jl:
+            case opCode::jge: case opCode::jg: case opCode::jle:
+            case cmpBranch: case cmpImmBranch: case localCmpImmBranch:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // icmp 的结果为 -1/0/1，第 (结果 + 1) 位为 1 时跳转
+    int branchMask(opCode op) {
+        switch (op) {
+            case opCode::je:
+                return 0b010;
+            case opCode::jne:
+                return 0b101;
+            case opCode::jl:
+                return 0b001;
+            case opCode::jge:
+                return 0b110;
+            case opCode::jg:
+                return 0b100;
+            case opCode::jle:
+                return 0b011;
+            default:
+                return 0;
+        }
+    }
+
+    // 指令弹出和压入的槽数，无法确定时返回 false
+    bool stackEffect(const VMInstruction& ins, const std::vector<VMFunction>& functions, int& pops, int& pushes) {
+        pops = 0;
+        pushes = 0;
+        switch ((int)ins.op) {
+            case opCode::nop: case incLocal:
+                return true;
+            case loadLocal2:
+                pushes = 2;
+                return true;
+            case opCode::biPush: case opCode::iPush: case opCode::loadC: case opCode::loadA:
+            case opCode::iScan: case opCode::cScan:
+            case loadLocal: case loadGlobal:
+                pushes = 1;
+                return true;
+            case opCode::pop1: case opCode::iPrint: case opCode::cPrint: case opCode::sPrint:
+            case storeLocal: case storeGlobal:
+                pops = 1;
+                return true;
+            case opCode::popN:
+                pops = ins.x;
+                return true;
+            case opCode::fPrint:
+                pops = ins.y;
+                return true;
+            case opCode::printL:
+                return true;
+            case opCode::iLoad: case opCode::iNeg: case opCode::i2c:
+            case addImm: case mulImm:
+                pops = pushes = 1;
+                return true;
+            case opCode::iStore:
+                pops = 2;
+                return true;
+            case opCode::iAdd: case opCode::iSub: case opCode::iMul: case opCode::iDiv: case opCode::iCmp:
+                pops = 2;
+                pushes = 1;
+                return true;
+            case opCode::call:
+                pops = functions[ins.x].paramSize;
+                pushes = functions[ins.x].returnsValue ? 1 : 0;
+                return true;
+            default:
+                // 跳转和返回
+                return false;
+        }
+    }
+
+    // 删除 keep[i] 为 false 的指令，跳转目标改为原目标之后第一条保留的指令
+    void compact(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin, const std::vector<bool>& keep) {
+        std::vector<int> index(code.size() + 1);
+        int n = 0;
+        for (std::size_t i = 0; i < code.size(); i++) {
+            index[i] = n;
+            if (keep[i]) {
+                origin[n] = origin[i];
+                code[n++] = code[i];
+            }
+        }
+        index[code.size()] = n;
+        code.erase(code.begin() + n, code.end());
+        origin.erase(origin.begin() + n, origin.end());
+        for (auto& ins : code) {
+            if (isJump(ins.op))
+                ins.x = index[ins.x];
+        }
+    }
+
+    std::vector<bool> jumpTargets(const std::vector<VMInstruction>& code) {
+        std::vector<bool> target(code.size() + 1, false);
+        for (const auto& ins : code) {
+            if (isJump(ins.op))
+                target[ins.x] = true;
+        }
+        return target;
+    }
+
+    // loada 和消耗这个地址的 istore 之间是不含跳转的表达式时，去掉 loada，istore 改为直接存入
+    // 地址被去掉后到 istore 为止的栈都比原来少一项，这些指令的 origin 改为 -1
+    void fuseStores(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin,
+                    const std::vector<VMFunction>& functions) {
+        auto target = jumpTargets(code);
+        std::vector<bool> keep(code.size(), true);
+        for (std::size_t i = 0; i < code.size(); i++) {
+            if (code[i].op != opCode::loadA)
+                continue;
+            // depth 为地址之上的槽数
+            int depth = 0;
+            for (std::size_t j = i + 1; j < code.size() && !target[j]; j++) {
+                if (code[j].op == opCode::iStore && depth == 1) {
+                    keep[i] = false;
+                    code[j] = VMInstruction((opCode)(code[i].x == 0 ? storeLocal : storeGlobal), code[i].y, 0);
+                    for (std::size_t k = i + 1; k <= j; k++)
+                        origin[k] = -1;
+                    break;
+                }
+                int pops, pushes;
+                if (!stackEffect(code[j], functions, pops, pushes) || pops > depth)
+                    break;
+                depth += pushes - pops;
+            }
+        }
+        compact(code, origin, keep);
+    }
+
+    bool isPush(const VMInstruction& ins) {
+        return ins.op == opCode::iPush || ins.op == opCode::biPush;
+    }
+
+    void fusePatterns(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin) {
+        auto target = jumpTargets(code);
+        std::vector<bool> keep(code.size(), true);
+        std::size_t n = code.size();
+        for (std::size_t i = 0; i < n; i++) {
+            auto& ins = code[i];
+            bool next = i + 1 < n && !target[i + 1];
+            bool next2 = next && i + 2 < n && !target[i + 2];
+            if (ins.op == opCode::loadA && next && code[i + 1].op == opCode::iLoad) {
+                ins = VMInstruction((opCode)(ins.x == 0 ? loadLocal : loadGlobal), ins.y, 0);
+                keep[++i] = false;
+            } else if (isPush(ins) && next2 && code[i + 1].op == opCode::iCmp && branchMask(code[i + 2].op)) {
+                VMInstruction fused((opCode)cmpImmBranch, code[i + 2].x, ins.x);
+                fused.cond = branchMask(code[i + 2].op);
+                ins = fused;
+                keep[++i] = false;
+                keep[++i] = false;
+            } else if (ins.op == opCode::iCmp && next && branchMask(code[i + 1].op)) {
+                VMInstruction fused((opCode)cmpBranch, code[i + 1].x, 0);
+                fused.cond = branchMask(code[i + 1].op);
+                ins = fused;
+                keep[++i] = false;
+            } else if (isPush(ins) && next
+                       && (code[i + 1].op == opCode::iAdd || code[i + 1].op == opCode::iSub)) {
+                std::int32_t k = code[i + 1].op == opCode::iAdd ? ins.x : (std::int32_t)(0u - (std::uint32_t)ins.x);
+                ins = VMInstruction((opCode)addImm, k, 0);
+                keep[++i] = false;
+            } else if (isPush(ins) && next && code[i + 1].op == opCode::iMul) {
+                ins = VMInstruction((opCode)mulImm, ins.x, 0);
+                keep[++i] = false;
+            }
+        }
+        compact(code, origin, keep);
+    }
+
+    void fuseLocals(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin) {
+        auto target = jumpTargets(code);
+        std::vector<bool> keep(code.size(), true);
+        std::size_t n = code.size();
+        for (std::size_t i = 0; i < n; i++) {
+            auto& ins = code[i];
+            if (ins.op != (opCode)loadLocal)
+                continue;
+            bool next = i + 1 < n && !target[i + 1];
+            bool next2 = next && i + 2 < n && !target[i + 2];
+            if (next2 && code[i + 1].op == (opCode)addImm
+                && code[i + 2].op == (opCode)storeLocal && code[i + 2].x == ins.x) {
+                ins = VMInstruction((opCode)incLocal, ins.x, code[i + 1].x);
+                keep[++i] = false;
+                keep[++i] = false;
+            } else if (next && code[i + 1].op == (opCode)cmpImmBranch) {
+                std::int32_t local = ins.x;
+                ins = code[i + 1];
+                ins.op = (opCode)localCmpImmBranch;
+                ins.z = local;
+                keep[++i] = false;
+            } else if (next && code[i + 1].op == (opCode)loadLocal) {
+                ins = VMInstruction((opCode)loadLocal2, ins.x, code[i + 1].x);
+                keep[++i] = false;
+            }
+        }
+        compact(code, origin, keep);
+    }
+
+    void fuseSuperinstructions(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin,
+                               const std::vector<VMFunction>& functions) {
+        fuseStores(code, origin, functions);
+        fusePatterns(code, origin);
+        fuseLocals(code, origin);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "vm.h"
+
+#include <vector>
+
+namespace c0 {
+
+    // 解释器内部使用的指令，不会出现在目标文件中，编号从 0xe0 开始避开 opCode
+    enum VMOp : u1 {
+        // loada 0/1, x; iload
+        loadLocal = 0xe0,
+        loadGlobal,
+        // loada 0/1, x; ...; istore，弹出栈顶存入 x
+        storeLocal,
+        storeGlobal,
+        // ipush x; iadd/isub
+        addImm,
+        // ipush x; imul
+        mulImm,
+        // icmp; jXX，cond 为条件掩码
+        cmpBranch,
+        // ipush y; icmp; jXX
+        cmpImmBranch,
+
+        // 以下由上面的超级指令再次融合得到
+        // loadLocal x; addImm y; storeLocal x
+        incLocal,
+        // loadLocal z; cmpImmBranch
+        localCmpImmBranch,
+        // loadLocal x; loadLocal y
+        loadLocal2,
+
+        // 执行结束
+        haltOp = 0xfe,
+        // 函数执行到末尾没有返回，x 为函数编号
+        fallOffOp = 0xff,
+    };
+
+    // 跳转目标 x 为指令下标的指令，包括融合后的比较跳转
+    bool isJump(opCode op);
+
+    // 把常见的指令序列融合成超级指令
+    // 序列按执行频率选出：在测试程序上统计相邻执行的指令，最常见的是
+    // loada+iload、loada ... istore、ipush+icmp+jXX、ipush+iadd 和 ipush+imul，
+    // 融合之后最常见的是 i = i + k、和局部变量比较的循环条件以及连续读两个局部变量
+    // 序列中间的指令是跳转目标时不融合；code 中的跳转目标仍是下标，融合后重新对应
+    // origin 和 code 一一对应，为融合后的指令在原字节码中的下标，执行前的栈和原指令不同时为 -1
+    void fuseSuperinstructions(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin,
+                               const std::vector<VMFunction>& functions);
+}
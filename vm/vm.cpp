@@ -0,0 +1,703 @@
+#include "vm.h"
+#include "superinstructions.h"
+#include "dispatch.h"
+#include "stack_depth.h"
+#include "instruction/line_table.h"
+
+#include <algorithm>
+#include <array>
+
+namespace c0 {
+    bool VM::threadedDispatch() {
+        return C0VM_THREADED;
+    }
+
+    bool VM::countsDispatches() {
+#ifdef C0VM_COUNT_DISPATCH
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    VM::VM(const byteCode& code, std::istream& in, std::ostream& out, std::size_t stackSize, bool superinstructions,
+           std::uint32_t jitThreshold, bool profile)
+        : _constants({}), _start({}), _functions({}), _halt({}), _loadError(),
+          _superinstructions(superinstructions && !profile), _loaded(0), _decoded(0), _dispatches(0),
+          _output(out), _input(in, &_output), _stack(stackSize), _frames({}), _sp(0), _threaded(false),
+          _exactFrames(false), _startFrameSize(0),
+          _jit(), _jitThreshold(jitThreshold), _bytecode({}), _hotness({}), _jitFailed({}), _nativeEntries(0),
+          _nesting(0), _profiler() {
+        for (const auto& constant : code.constants)
+            _constants.push_back(constant.second);
+
+        for (const auto& fun : code.functions) {
+            VMFunction f;
+            if (fun.name_index >= 0 && fun.name_index < (int)_constants.size())
+                f.name = _constants[fun.name_index];
+            f.paramSize = fun.params_size;
+            f.returnsValue = false;
+            f.frameSize = 0;
+            _functions.push_back(std::move(f));
+        }
+        for (std::size_t i = 0; i < _functions.size() && i < code.instructions.size(); i++) {
+            for (const auto& ins : code.instructions[i])
+                _functions[i].returnsValue |= ins.getOpr() == opCode::iRet;
+        }
+
+        std::vector<std::int32_t> startOrigin;
+        _loadError = decode(code.start, _start, -1);
+        finish(_start, startOrigin, VMInstruction((opCode)haltOp, 0, 0));
+        for (int i = 0; i < (int)_functions.size() && !_loadError; i++) {
+            _loadError = decode(code.instructions[i], _functions[i].code, i);
+            finish(_functions[i].code, _functions[i].origin, VMInstruction((opCode)fallOffOp, i, 0));
+        }
+        _halt.emplace_back((opCode)haltOp, 0, 0);
+
+        // 解释器执行时不检查栈下溢，栈深度不一致或者下溢的代码在加载时拒绝；
+        // 同一个函数中混用 ret 和 iret 时调用后的栈深度不确定，也拒绝
+        for (std::size_t i = 0; i < _functions.size() && !_loadError; i++) {
+            const auto& seq = code.instructions[i];
+            bool ret = std::any_of(seq.begin(), seq.end(), [](const Instruction& ins) { return ins.getOpr() == opCode::ret; });
+            if (ret && _functions[i].returnsValue)
+                _loadError = ".F" + std::to_string(i) + ": both ret and iret";
+        }
+        std::vector<frameInfo> frames;
+        if (!_loadError)
+            _loadError = frameSizes(code, frames);
+        // 剖析的实例仍然逐次检查压栈
+        if (!profile && !_loadError) {
+            _exactFrames = true;
+            _startFrameSize = frames[0].max_stack;
+            for (std::size_t i = 0; i < _functions.size(); i++)
+                _functions[i].frameSize = frames[i + 1].max_stack;
+        }
+
+        if (profile && !_loadError) {
+            auto ops = [](const std::vector<VMInstruction>& code) {
+                std::vector<opCode> result;
+                for (const auto& ins : code)
+                    result.push_back(ins.op);
+                return result;
+            };
+            std::vector<std::string> names;
+            std::vector<std::vector<opCode>> code = { ops(_start) };
+            for (const auto& fun : _functions) {
+                names.push_back(fun.name);
+                code.push_back(ops(fun.code));
+            }
+            static_assert(sizeof(VMInstruction) % sizeof(std::uint64_t) == 0 && sizeof(VMInstruction) >= 16,
+                          "profile counters are strided by instructions");
+            _profiler = std::make_unique<Profiler>(std::move(names), std::move(code),
+                                                   sizeof(VMInstruction) / sizeof(std::uint64_t));
+        }
+        if (_profiler) {
+            // 不融合超级指令时解释器的指令和字节码一一对应，末尾多一条结束指令
+            bool any = false;
+            auto lines = [&any](const std::vector<Instruction>& seq) {
+                auto table = lineTable(seq);
+                any |= !table.empty();
+                auto result = expandLines(table, seq.size());
+                result.push_back(0);
+                return result;
+            };
+            std::vector<std::vector<std::uint32_t>> table = { lines(code.start) };
+            for (const auto& seq : code.instructions)
+                table.push_back(lines(seq));
+            if (any)
+                _profiler->setLines(std::move(table));
+        }
+
+        if (jitThreshold > 0 && !profile && Jit::supported() && !_loadError) {
+            _bytecode = code.instructions;
+            _hotness.assign(_functions.size(), 0);
+            _jitFailed.assign(_functions.size(), false);
+            _jit = std::make_unique<Jit>(_stack, callSignatures(code), _constants, _input, _output,
+                                         [this](int funcId, std::int32_t* fp) { return callFromNative(funcId, fp); });
+        }
+    }
+
+    // 融合超级指令，跳转目标换成相对当前指令的偏移，执行时不需要函数起始地址
+    void VM::finish(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin,
+                    const VMInstruction& sentinel) {
+        _loaded += code.size();
+        origin.resize(code.size());
+        for (std::size_t i = 0; i < origin.size(); i++)
+            origin[i] = (std::int32_t)i;
+        if (_superinstructions)
+            fuseSuperinstructions(code, origin, _functions);
+        _decoded += code.size();
+        for (std::size_t i = 0; i < code.size(); i++) {
+            if (isJump(code[i].op))
+                code[i].x -= (std::int32_t)i;
+        }
+        code.push_back(sentinel);
+        origin.push_back(-1);
+    }
+
+    bool VM::tierUp(int funcId) {
+        if (_jit->compiled(funcId))
+            return canEnterNative(funcId);
+        if (_jitFailed[funcId])
+            return false;
+        ++_hotness[funcId];
+        if (_hotness[funcId] < _jitThreshold)
+            return false;
+        // 编译失败（例如栈深度不一致）的函数留在解释器中
+        if (!_jit->compile(funcId, _bytecode[funcId])) {
+            _jitFailed[funcId] = true;
+            return false;
+        }
+        return canEnterNative(funcId);
+    }
+
+    bool VM::canEnterNative(int funcId) const {
+        return _jit->compiled(funcId) && !_jit->tooDeep() && _nesting < maxNesting;
+    }
+
+    std::optional<std::string> VM::callFromNative(int funcId, std::int32_t* fp) {
+        if (tierUp(funcId)) {
+            ++_nativeEntries;
+            return _jit->run(funcId, fp);
+        }
+        // 函数返回到 _halt，execute 随之返回
+        const auto& fun = _functions[funcId];
+        std::int32_t base = (std::int32_t)(fp - _stack.data());
+        if (_frames.size() >= _stack.size())
+            return std::string("call stack overflow");
+        if (_exactFrames && (std::size_t)base + fun.frameSize > _stack.size())
+            return std::string("stack overflow");
+        _frames.push_back({ _halt.data(), 0, -1 });
+        _sp = base + fun.paramSize;
+        ++_nesting;
+        auto err = execute(fun.code.data(), base, funcId);
+        --_nesting;
+        return err;
+    }
+
+    std::optional<std::string> checkCode(const std::vector<Instruction>& code, int funcId,
+                                         std::size_t functions, std::size_t constants) {
+        std::string where = funcId < 0 ? ".start" : ".F" + std::to_string(funcId);
+        for (int i = 0; i < (int)code.size(); i++) {
+            const auto& ins = code[i];
+            switch (ins.getOpr()) {
+                case opCode::jmp: case opCode::je: case opCode::jne:
+                case opCode::jl: case opCode::jge: case opCode::jg: case opCode::jle:
+                    if (ins.getX() < 0 || ins.getX() > (int)code.size())
+                        return where + ": jump target " + std::to_string(ins.getX()) + " out of range";
+                    break;
+                case opCode::call:
+                    if (ins.getX() < 0 || ins.getX() >= (int)functions)
+                        return where + ": call to undefined function " + std::to_string(ins.getX());
+                    break;
+                case opCode::loadC:
+                    if (ins.getX() < 0 || ins.getX() >= (int)constants)
+                        return where + ": constant " + std::to_string(ins.getX()) + " out of range";
+                    break;
+                case opCode::fPrint:
+                    if (ins.getX() < 0 || ins.getX() >= (int)constants)
+                        return where + ": constant " + std::to_string(ins.getX()) + " out of range";
+                    if (ins.getY() < 0)
+                        return where + ": negative fprint argument count";
+                    break;
+                case opCode::loadA:
+                    if (ins.getX() != 0 && ins.getX() != 1)
+                        return where + ": unsupported level " + std::to_string(ins.getX());
+                    break;
+                case opCode::popN:
+                    if (ins.getX() < 0)
+                        return where + ": negative popn";
+                    break;
+                // 之后的 n + 1 条指令都是 jmp
+                case opCode::tableSwitch:
+                    if (ins.getY() < 0 || i + 1 + ins.getY() >= (int)code.size())
+                        return where + ": tableswitch at " + std::to_string(i) + " runs past the end";
+                    for (int k = i + 1; k <= i + 1 + ins.getY(); k++) {
+                        if (code[k].getOpr() != opCode::jmp)
+                            return where + ": tableswitch entry " + std::to_string(k) + " is not a jmp";
+                    }
+                    break;
+                case opCode::nop: case opCode::biPush: case opCode::iPush: case opCode::pop1:
+                case opCode::iLoad: case opCode::iStore:
+                case opCode::iAdd: case opCode::iSub: case opCode::iMul: case opCode::iDiv:
+                case opCode::iNeg: case opCode::iCmp: case opCode::i2c:
+                case opCode::ret: case opCode::iRet:
+                case opCode::iPrint: case opCode::cPrint: case opCode::sPrint: case opCode::printL:
+                case opCode::iScan: case opCode::cScan:
+                    break;
+                default:
+                    return where + ": unknown opcode " + std::to_string((int)ins.getOpr()) + " at " + std::to_string(i);
+            }
+        }
+        return {};
+    }
+
+    std::optional<std::string> VM::decode(const std::vector<Instruction>& code, std::vector<VMInstruction>& out,
+                                          int funcId) {
+        if (auto err = checkCode(code, funcId, _functions.size(), _constants.size()))
+            return err;
+        out.reserve(code.size() + 1);
+        for (const auto& ins : code)
+            out.emplace_back(ins.getOpr(), ins.getX(), ins.getY());
+        return {};
+    }
+
+    std::optional<std::string> VM::Run() {
+        if (_loadError)
+            return _loadError;
+        FlushGuard flush(_output);
+
+        _sp = 0;
+        _frames.clear();
+        _dispatches = 0;
+        if (_exactFrames && (std::size_t)_startFrameSize > _stack.size())
+            return std::string("stack overflow");
+        if (_profiler)
+            _profiler->enter(-1);
+        if (auto err = execute(_start.data(), 0, -1))
+            return err;
+        if (_profiler)
+            _profiler->leave();
+
+        int mainId = -1;
+        for (int i = 0; i < (int)_functions.size(); i++) {
+            if (_functions[i].name == "main")
+                mainId = i;
+        }
+        if (mainId < 0)
+            return std::string("no main function");
+
+        _frames.push_back({ _halt.data(), 0, -1 });
+        std::int32_t fp = _sp - _functions[mainId].paramSize;
+        if (_exactFrames && (std::size_t)fp + _functions[mainId].frameSize > _stack.size())
+            return std::string("stack overflow");
+        if (_profiler)
+            _profiler->enter(mainId);
+        return execute(_functions[mainId].code.data(), fp, mainId);
+    }
+
+    std::optional<std::string> VM::execute(const VMInstruction* ip, std::int32_t fp, int funcId) {
+        if (!_profiler)
+            return _exactFrames ? interpret<false, true>(ip, fp, funcId) : interpret<false, false>(ip, fp, funcId);
+        auto err = interpret<true, false>(ip, fp, funcId);
+        if (err)
+            _profiler->finish();
+        return err;
+    }
+
+#if C0VM_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+    template<bool Profile, bool ExactFrames>
+    std::optional<std::string> VM::interpret(const VMInstruction* ip, std::int32_t fp, int funcId) {
+        std::int32_t* stack = _stack.data();
+        std::int32_t* sp = stack + _sp;
+        std::int32_t* limit = stack + _stack.size();
+        const bool jit = _jit != nullptr;
+        // 剖析时从当前函数的指令地址到它的计数器的偏移，调用和返回时更新，见 Profiler
+        [[maybe_unused]] std::uintptr_t countsOffset = 0;
+        [[maybe_unused]] std::uint64_t haltCount[sizeof(VMInstruction) / sizeof(std::uint64_t)] = {};
+// 不用 lambda，避免 countsOffset 被取地址后不能留在寄存器中
+#define PROFILE_FUNCTION(id) do { \
+            const VMInstruction* code_ = (id) < 0 ? _start.data() : _functions[id].code.data(); \
+            countsOffset = (std::uintptr_t)_profiler->counts(id) - (std::uintptr_t)code_; \
+        } while (0)
+        if (Profile)
+            PROFILE_FUNCTION(funcId);
+
+#define STACK_ERROR(msg) do { _sp = (std::int32_t)(sp - stack); return std::string(msg); } while (0)
+#define PUSH(value) do { if (!ExactFrames && sp >= limit) STACK_ERROR("stack overflow"); *sp++ = (value); } while (0)
+#ifdef C0VM_COUNT_DISPATCH
+#define COUNT_DISPATCH() (++_dispatches)
+#else
+#define COUNT_DISPATCH() ((void)0)
+#endif
+// 剖析时记录条件跳转跳转的次数，不跳转的次数由执行次数得到
+#define BRANCH(cond) do { \
+            if (cond) { \
+                if (Profile) \
+                    ++*(std::uint64_t*)((std::uintptr_t)ip + countsOffset + sizeof(std::uint64_t)); \
+                goto jump; \
+            } \
+        } while (0)
+#define PROFILE_OP() do { if (Profile) ++*(std::uint64_t*)((std::uintptr_t)ip + countsOffset); } while (0)
+#define CHECK_ADDR(addr) do { if ((std::uint32_t)(addr) >= (std::uint32_t)(sp - stack)) STACK_ERROR("invalid address"); } while (0)
+
+#if C0VM_THREADED
+        std::array<const void*, 256> labels;
+        labels.fill(&&op_bad);
+        labels[opCode::nop] = &&op_nop;
+        labels[opCode::biPush] = &&op_push;
+        labels[opCode::iPush] = &&op_push;
+        labels[opCode::pop1] = &&op_pop1;
+        labels[opCode::popN] = &&op_popN;
+        labels[opCode::loadC] = &&op_push;
+        labels[opCode::loadA] = &&op_loadA;
+        labels[opCode::iLoad] = &&op_iLoad;
+        labels[opCode::iStore] = &&op_iStore;
+        labels[opCode::iAdd] = &&op_iAdd;
+        labels[opCode::iSub] = &&op_iSub;
+        labels[opCode::iMul] = &&op_iMul;
+        labels[opCode::iDiv] = &&op_iDiv;
+        labels[opCode::iNeg] = &&op_iNeg;
+        labels[opCode::iCmp] = &&op_iCmp;
+        labels[opCode::i2c] = &&op_i2c;
+        labels[opCode::jmp] = &&op_jmp;
+        labels[opCode::je] = &&op_je;
+        labels[opCode::jne] = &&op_jne;
+        labels[opCode::jl] = &&op_jl;
+        labels[opCode::jge] = &&op_jge;
+        labels[opCode::jg] = &&op_jg;
+        labels[opCode::jle] = &&op_jle;
+        labels[opCode::tableSwitch] = &&op_tableSwitch;
+        labels[opCode::call] = &&op_call;
+        labels[opCode::ret] = &&op_ret;
+        labels[opCode::iRet] = &&op_iRet;
+        labels[opCode::iPrint] = &&op_iPrint;
+        labels[opCode::cPrint] = &&op_cPrint;
+        labels[opCode::sPrint] = &&op_sPrint;
+        labels[opCode::fPrint] = &&op_fPrint;
+        labels[opCode::printL] = &&op_printL;
+        labels[opCode::iScan] = &&op_iScan;
+        labels[opCode::cScan] = &&op_cScan;
+        labels[loadLocal] = &&op_loadLocal;
+        labels[loadGlobal] = &&op_loadGlobal;
+        labels[storeLocal] = &&op_storeLocal;
+        labels[storeGlobal] = &&op_storeGlobal;
+        labels[addImm] = &&op_addImm;
+        labels[mulImm] = &&op_mulImm;
+        labels[cmpBranch] = &&op_cmpBranch;
+        labels[cmpImmBranch] = &&op_cmpImmBranch;
+        labels[incLocal] = &&op_incLocal;
+        labels[localCmpImmBranch] = &&op_localCmpImmBranch;
+        labels[loadLocal2] = &&op_loadLocal2;
+        labels[haltOp] = &&op_halt;
+        labels[fallOffOp] = &&op_fallOff;
+
+        // 第一次执行时填入每条指令的处理代码地址
+        if (!_threaded) {
+            for (auto& ins : _start)
+                ins.handler = labels[ins.op];
+            for (auto& fun : _functions) {
+                for (auto& ins : fun.code)
+                    ins.handler = labels[ins.op];
+            }
+            for (auto& ins : _halt)
+                ins.handler = labels[ins.op];
+            _threaded = true;
+        }
+
+#define TARGET(name) op_##name:
+#define DISPATCH() do { COUNT_DISPATCH(); PROFILE_OP(); goto *ip->handler; } while (0)
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+        DISPATCH();
+#else
+#define TARGET(name) case name:
+#define DISPATCH() continue
+// 不能用 do-while 包装，否则 continue 只会结束 do-while
+#define NEXT() { ++ip; continue; }
+        for (;;) {
+            COUNT_DISPATCH();
+            PROFILE_OP();
+            switch ((int)ip->op) {
+#endif
+
+        TARGET(nop)
+            NEXT();
+#if C0VM_THREADED
+        op_push:
+#else
+        case opCode::loadC:
+        case opCode::biPush:
+        case opCode::iPush:
+#endif
+            PUSH(ip->x);
+            NEXT();
+        TARGET(pop1)
+            --sp;
+            NEXT();
+        TARGET(popN)
+            sp -= ip->x;
+            NEXT();
+        TARGET(loadA)
+            PUSH((ip->x == 0 ? fp : 0) + ip->y);
+            NEXT();
+        TARGET(iLoad)
+            CHECK_ADDR(sp[-1]);
+            sp[-1] = stack[sp[-1]];
+            NEXT();
+        TARGET(iStore)
+            CHECK_ADDR(sp[-2]);
+            stack[sp[-2]] = sp[-1];
+            sp -= 2;
+            NEXT();
+        TARGET(iAdd)
+            sp[-2] = wrap((std::uint32_t)sp[-2] + (std::uint32_t)sp[-1]);
+            --sp;
+            NEXT();
+        TARGET(iSub)
+            sp[-2] = wrap((std::uint32_t)sp[-2] - (std::uint32_t)sp[-1]);
+            --sp;
+            NEXT();
+        TARGET(iMul)
+            sp[-2] = wrap((std::uint32_t)sp[-2] * (std::uint32_t)sp[-1]);
+            --sp;
+            NEXT();
+        TARGET(iDiv)
+            if (sp[-1] == 0)
+                STACK_ERROR("division by zero");
+            // INT_MIN / -1 溢出
+            sp[-2] = sp[-1] == -1 ? wrap(0u - (std::uint32_t)sp[-2]) : sp[-2] / sp[-1];
+            --sp;
+            NEXT();
+        TARGET(iNeg)
+            sp[-1] = wrap(0u - (std::uint32_t)sp[-1]);
+            NEXT();
+        TARGET(iCmp)
+            sp[-2] = (sp[-2] > sp[-1]) - (sp[-2] < sp[-1]);
+            --sp;
+            NEXT();
+        TARGET(i2c)
+            sp[-1] &= 0xff;
+            NEXT();
+
+        TARGET(jmp)
+            goto jump;
+        TARGET(je)
+            BRANCH(*--sp == 0);
+            NEXT();
+        TARGET(jne)
+            BRANCH(*--sp != 0);
+            NEXT();
+        TARGET(jl)
+            BRANCH(*--sp < 0);
+            NEXT();
+        TARGET(jge)
+            BRANCH(*--sp >= 0);
+            NEXT();
+        TARGET(jg)
+            BRANCH(*--sp > 0);
+            NEXT();
+        TARGET(jle)
+            BRANCH(*--sp <= 0);
+            NEXT();
+        // 执行表中的第 k 条 jmp，超出范围时执行最后一条
+        TARGET(tableSwitch) {
+            std::uint32_t k = (std::uint32_t)*--sp - (std::uint32_t)ip->x;
+            ip += 1 + (k < (std::uint32_t)ip->y ? k : (std::uint32_t)ip->y);
+            DISPATCH();
+        }
+
+        TARGET(call) {
+            const auto& fun = _functions[ip->x];
+            if (jit && tierUp(ip->x)) {
+                // 本地代码直接使用栈上的参数，返回后和解释器执行 ret/iret 的结果相同
+                std::int32_t* callee = sp - fun.paramSize;
+                ++_nativeEntries;
+                ++_nesting;
+                auto err = _jit->run(ip->x, callee);
+                --_nesting;
+                if (err)
+                    STACK_ERROR(*err);
+                sp = callee + (fun.returnsValue ? 1 : 0);
+                NEXT();
+            }
+            if (_frames.size() >= _stack.size())
+                STACK_ERROR("call stack overflow");
+            // 参数已经在栈上，栈帧的其余部分一次检查
+            if (ExactFrames && limit - sp < fun.frameSize - fun.paramSize)
+                STACK_ERROR("stack overflow");
+            _frames.push_back({ ip + 1, fp, funcId });
+            if (Profile) {
+                _profiler->enter(ip->x);
+                PROFILE_FUNCTION(ip->x);
+            }
+            funcId = ip->x;
+            fp = (std::int32_t)(sp - stack) - fun.paramSize;
+            ip = fun.code.data();
+            DISPATCH();
+        }
+        TARGET(ret)
+            sp = stack + fp;
+            goto frame_return;
+        TARGET(iRet) {
+            std::int32_t value = sp[-1];
+            sp = stack + fp;
+            *sp++ = value;
+            goto frame_return;
+        }
+
+        TARGET(loadLocal)
+            CHECK_ADDR(fp + ip->x);
+            PUSH(stack[fp + ip->x]);
+            NEXT();
+        TARGET(loadGlobal)
+            CHECK_ADDR(ip->x);
+            PUSH(stack[ip->x]);
+            NEXT();
+        TARGET(storeLocal)
+            CHECK_ADDR(fp + ip->x);
+            stack[fp + ip->x] = *--sp;
+            NEXT();
+        TARGET(storeGlobal)
+            CHECK_ADDR(ip->x);
+            stack[ip->x] = *--sp;
+            NEXT();
+        TARGET(addImm)
+            sp[-1] = wrap((std::uint32_t)sp[-1] + (std::uint32_t)ip->x);
+            NEXT();
+        TARGET(mulImm)
+            sp[-1] = wrap((std::uint32_t)sp[-1] * (std::uint32_t)ip->x);
+            NEXT();
+        TARGET(cmpBranch) {
+            int result = (sp[-2] > sp[-1]) - (sp[-2] < sp[-1]);
+            sp -= 2;
+            BRANCH(ip->cond >> (result + 1) & 1);
+            NEXT();
+        }
+        TARGET(cmpImmBranch) {
+            int result = (sp[-1] > ip->y) - (sp[-1] < ip->y);
+            --sp;
+            BRANCH(ip->cond >> (result + 1) & 1);
+            NEXT();
+        }
+        TARGET(incLocal)
+            CHECK_ADDR(fp + ip->x);
+            stack[fp + ip->x] = wrap((std::uint32_t)stack[fp + ip->x] + (std::uint32_t)ip->y);
+            NEXT();
+        TARGET(localCmpImmBranch) {
+            CHECK_ADDR(fp + ip->z);
+            std::int32_t value = stack[fp + ip->z];
+            int result = (value > ip->y) - (value < ip->y);
+            BRANCH(ip->cond >> (result + 1) & 1);
+            NEXT();
+        }
+        TARGET(loadLocal2)
+            // 第二个槽可以是第一条 loadLocal 刚压入的槽
+            CHECK_ADDR(fp + ip->x);
+            if (!ExactFrames && limit - sp < 2)
+                STACK_ERROR("stack overflow");
+            sp[0] = stack[fp + ip->x];
+            if ((std::uint32_t)(fp + ip->y) > (std::uint32_t)(sp - stack))
+                STACK_ERROR("invalid address");
+            sp[1] = stack[fp + ip->y];
+            sp += 2;
+            NEXT();
+
+        TARGET(iPrint)
+            _output.putInt(*--sp);
+            NEXT();
+        TARGET(cPrint)
+            _output.putChar((char)*--sp);
+            NEXT();
+        TARGET(sPrint) {
+            std::int32_t index = *--sp;
+            if (index < 0 || index >= (std::int32_t)_constants.size())
+                STACK_ERROR("invalid constant index");
+            _output.write(_constants[index]);
+            NEXT();
+        }
+        TARGET(fPrint)
+            sp -= ip->y;
+            if (!_output.putFormat(_constants[ip->x], sp, ip->y))
+                STACK_ERROR("too few fprint arguments");
+            NEXT();
+        TARGET(printL)
+            _output.putChar('\n');
+            NEXT();
+        TARGET(iScan) {
+            auto value = _input.getInt();
+            if (!value)
+                STACK_ERROR("invalid input");
+            PUSH(value.value());
+            NEXT();
+        }
+        TARGET(cScan) {
+            auto c = _input.getChar();
+            if (!c)
+                STACK_ERROR("invalid input");
+            PUSH((unsigned char)c.value());
+            NEXT();
+        }
+
+#if C0VM_THREADED
+        op_halt:
+#else
+        case haltOp:
+#endif
+            _sp = (std::int32_t)(sp - stack);
+            return {};
+#if C0VM_THREADED
+        op_fallOff:
+#else
+        case fallOffOp:
+#endif
+            STACK_ERROR("function " + _functions[ip->x].name + " ends without return");
+
+#if C0VM_THREADED
+        op_bad:
+#else
+            default:
+#endif
+            STACK_ERROR("unknown opcode " + std::to_string((int)ip->op));
+
+        jump:
+            // 回跳时计数，函数已经编译时从跳转目标进入本地代码执行到函数返回
+            if (jit && ip->x < 0 && funcId >= 0 && tierUp(funcId)) {
+                const auto& fun = _functions[funcId];
+                std::int32_t target = fun.origin[ip + ip->x - fun.code.data()];
+                const void* resume = target < 0 ? nullptr : _jit->resumePoint(funcId, target);
+                if (resume) {
+                    ++_nativeEntries;
+                    ++_nesting;
+                    auto err = _jit->run(funcId, stack + fp, resume);
+                    --_nesting;
+                    if (err)
+                        STACK_ERROR(*err);
+                    sp = stack + fp + (fun.returnsValue ? 1 : 0);
+                    goto frame_return;
+                }
+            }
+            ip += ip->x;
+            DISPATCH();
+        frame_return: {
+            if (_frames.empty())
+                STACK_ERROR("return outside of function");
+            if (Profile)
+                _profiler->leave();
+            auto frame = _frames.back();
+            _frames.pop_back();
+            ip = frame.returnIp;
+            fp = frame.fp;
+            funcId = frame.funcId;
+            // _halt 不属于任何函数，单独计数
+            if (Profile) {
+                if (ip == _halt.data())
+                    countsOffset = (std::uintptr_t)haltCount - (std::uintptr_t)_halt.data();
+                else
+                    PROFILE_FUNCTION(funcId);
+            }
+            DISPATCH();
+        }
+#if !C0VM_THREADED
+            }
+        }
+#endif
+    }
+#undef STACK_ERROR
+#undef PUSH
+#undef CHECK_ADDR
+#undef BRANCH
+#undef PROFILE_OP
+#undef PROFILE_FUNCTION
+#undef COUNT_DISPATCH
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+
+#if C0VM_THREADED
+#pragma GCC diagnostic pop
+#endif
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "generater/generator.h"
+#include "io.h"
+#include "jit.h"
+#include "profiler.h"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace c0 {
+
+    // 预先解码的指令
+    // 跳转指令的 x 是相对本条指令的偏移
+    // cond 和 z 只有超级指令使用，见 superinstructions.h
+    // handler 是 direct-threaded 分派时该指令处理代码的地址，switch 分派时不使用
+    class VMInstruction {
+    public:
+        opCode op;
+        u1 cond;
+        std::int32_t x;
+        std::int32_t y;
+        std::int32_t z;
+        const void* handler;
+
+        VMInstruction(opCode op, std::int32_t x, std::int32_t y) : op(op), cond(0), x(x), y(y), z(0), handler(nullptr) {}
+    };
+
+    // 检查操作码、跳转目标、函数和常量编号，解释器执行时不再检查
+    std::optional<std::string> checkCode(const std::vector<Instruction>& code, int funcId,
+                                         std::size_t functions, std::size_t constants);
+
+    class VMFunction {
+    public:
+        std::string name;
+        int paramSize;
+        // 函数中有 iret
+        bool returnsValue;
+        // 从 fp 开始使用的栈槽数，只在 VM 使用精确栈帧时有效，见 frameSizes
+        int frameSize;
+        // 末尾附加一条内部指令，函数没有 ret 就执行到末尾时报错
+        std::vector<VMInstruction> code;
+        // 每条指令在原字节码中的下标，从解释器进入本地代码时使用，见 fuseSuperinstructions
+        std::vector<std::int32_t> origin;
+    };
+
+    // C0 字节码解释器
+    // 构造时把 byteCode 解码成 VMInstruction 数组并检查操作数，之后直接执行，不需要写出目标文件
+    // 所有状态都在对象中，可以同时存在多个 VM
+    class VM final {
+    public:
+        // stackSize: 操作栈的槽数
+        // superinstructions: 解码时融合常见指令序列
+        // jitThreshold: 函数的调用次数加上回跳次数达到它时编译成本地代码，0 表示不使用 JIT
+        // profile: 执行时收集剖析数据，见 profiler()；操作码和跳转位置对应原字节码，因此不融合超级指令也不使用 JIT
+        VM(const byteCode& code, std::istream& in, std::ostream& out, std::size_t stackSize = 1 << 20,
+           bool superinstructions = true, std::uint32_t jitThreshold = 0, bool profile = false);
+        VM(VM&&) = delete;
+        VM(const VM&) = delete;
+        VM& operator=(VM) = delete;
+
+        // 执行 .start 后调用 main，出错时返回错误信息
+        std::optional<std::string> Run();
+
+        // 使用 computed goto 分派时为 true
+        static bool threadedDispatch();
+
+        // 解码前后的指令条数，不含内部附加的指令
+        std::size_t loadedInstructions() const { return _loaded; }
+        std::size_t decodedInstructions() const { return _decoded; }
+        // 执行的分派次数，只在定义 C0VM_COUNT_DISPATCH 时统计
+        std::uint64_t dispatches() const { return _dispatches; }
+        static bool countsDispatches();
+
+        // 编译成本地代码的函数个数和进入本地代码的次数
+        std::size_t compiledFunctions() const { return _jit ? _jit->compiledFunctions() : 0; }
+        std::uint64_t nativeEntries() const { return _nativeEntries; }
+
+        // 剖析数据，构造时没有要求剖析则为空
+        const Profiler* profiler() const { return _profiler.get(); }
+
+    private:
+        class Frame {
+        public:
+            const VMInstruction* returnIp;
+            std::int32_t fp;
+            // 调用者，.start 为 -1
+            int funcId;
+        };
+
+        // 本地代码调用解释器、解释器又进入本地代码的嵌套层数上限，避免耗尽机器栈
+        static constexpr int maxNesting = 256;
+
+        std::vector<std::string> _constants;
+        std::vector<VMInstruction> _start;
+        std::vector<VMFunction> _functions;
+        // main 返回到这里
+        std::vector<VMInstruction> _halt;
+        std::optional<std::string> _loadError;
+        bool _superinstructions;
+        std::size_t _loaded;
+        std::size_t _decoded;
+        std::uint64_t _dispatches;
+
+        OutputBuffer _output;
+        InputBuffer _input;
+        std::vector<std::int32_t> _stack;
+        std::vector<Frame> _frames;
+        std::int32_t _sp;
+        bool _threaded;
+        // 不剖析时为 true：调用时按 frameSizes 求出的大小检查一次整个栈帧，压栈时不再检查越界
+        bool _exactFrames;
+        int _startFrameSize;
+
+        // 以下只在使用 JIT 时有效
+        std::unique_ptr<Jit> _jit;
+        std::uint32_t _jitThreshold;
+        // 编译时使用原字节码
+        std::vector<std::vector<Instruction>> _bytecode;
+        // 每个函数的调用次数加回跳次数，编译失败后不再增加
+        std::vector<std::uint32_t> _hotness;
+        std::vector<bool> _jitFailed;
+        std::uint64_t _nativeEntries;
+        int _nesting;
+
+        std::unique_ptr<Profiler> _profiler;
+
+        std::optional<std::string> decode(const std::vector<Instruction>& code, std::vector<VMInstruction>& out,
+                                          int funcId);
+        void finish(std::vector<VMInstruction>& code, std::vector<std::int32_t>& origin, const VMInstruction& sentinel);
+        // 计数并在达到阈值时编译，返回函数是否可以进入本地代码
+        bool tierUp(int funcId);
+        bool canEnterNative(int funcId) const;
+        // 本地代码调用没有编译的函数
+        std::optional<std::string> callFromNative(int funcId, std::int32_t* fp);
+        // 按是否剖析和是否使用精确栈帧选择 interpret 的实例
+        std::optional<std::string> execute(const VMInstruction* ip, std::int32_t fp, int funcId);
+        // Profile 为 false 的实例中没有任何剖析代码，ExactFrames 为 true 的实例中压栈不检查越界
+        // direct-threaded 分派时指令记录的是第一次执行的实例中的地址，一个 VM 只会使用其中一个实例
+        template<bool Profile, bool ExactFrames>
+        std::optional<std::string> interpret(const VMInstruction* ip, std::int32_t fp, int funcId);
+    };
+}